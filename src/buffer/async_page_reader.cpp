@@ -0,0 +1,66 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// async_page_reader.cpp
+//
+// Identification: src/buffer/async_page_reader.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/async_page_reader.h"
+
+#include <utility>
+
+namespace bustub {
+
+void AsyncPageReader::Prefetch(page_id_t page_id) {
+  if (page_id == INVALID_PAGE_ID || bpm_->IsPageResident(page_id)) {
+    return;
+  }
+  {
+    std::scoped_lock lock(latch_);
+    if (!pending_.emplace(page_id, std::vector<std::function<void()>>{}).second) {
+      return;
+    }
+  }
+  io_pool_->Submit([this, page_id] { Read(page_id); });
+}
+
+bool AsyncPageReader::IsReady(page_id_t page_id) {
+  std::scoped_lock lock(latch_);
+  return pending_.count(page_id) == 0;
+}
+
+void AsyncPageReader::WhenReady(page_id_t page_id, std::function<void()> &&callback) {
+  {
+    std::scoped_lock lock(latch_);
+    auto waiters = pending_.find(page_id);
+    if (waiters != pending_.end()) {
+      waiters->second.emplace_back(std::move(callback));
+      return;
+    }
+  }
+  callback();
+}
+
+void AsyncPageReader::Read(page_id_t page_id) {
+  Page *page = bpm_->FetchPage(page_id);
+  if (page != nullptr) {
+    bpm_->UnpinPage(page_id, false);
+  }
+
+  std::vector<std::function<void()>> waiters;
+  {
+    std::scoped_lock lock(latch_);
+    waiters = std::move(pending_[page_id]);
+    pending_.erase(page_id);
+  }
+  for (auto &waiter : waiters) {
+    waiter();
+  }
+}
+
+}  // namespace bustub
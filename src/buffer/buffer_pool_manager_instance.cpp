@@ -47,6 +47,21 @@ BufferPoolManagerInstance::~BufferPoolManagerInstance() {
   delete replacer_;
 }
 
+void BufferPoolManagerInstance::WritePageToDisk(Page *page) {
+  // 先写日志：页上最新修改的日志记录必须先落盘；没有记过日志的页，LSN的位置存的是别的数据
+  if (enable_logging && log_manager_ != nullptr && page->has_lsn_) {
+    log_manager_->Flush(page->GetLSN());
+  }
+  disk_manager_->WritePage(page->GetPageId(), page->GetData());
+}
+
+void BufferPoolManagerInstance::ResetRecLSN(Page *page) {
+  // 被pin住的页可能有人已经记了日志、还没改到页上，写盘时又没拿页的latch，那条修改未必在盘上
+  if (page->pin_count_ == 0) {
+    page->rec_lsn_ = CleanRecLSN();
+  }
+}
+
 bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   // Make sure you call DiskManager::WritePage!
   std::scoped_lock lock{latch_};
@@ -57,8 +72,9 @@ bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   // 在页表中找到frameid，然后根据他获取Page对象
   auto frame_id = page_table_[page_id];
   Page *page = &pages_[frame_id];
-  disk_manager_->WritePage(page->GetPageId(), page->GetData());
+  WritePageToDisk(page);
   page->is_dirty_ = false;
+  ResetRecLSN(page);
   return true;
 }
 
@@ -68,11 +84,11 @@ void BufferPoolManagerInstance::FlushAllPgsImp() {
 
   auto iter = page_table_.begin();
   while (iter != page_table_.end()) {
-    auto page_id = iter->first;
     auto frame_id = iter->second;
     Page *page = &pages_[frame_id];
-    disk_manager_->WritePage(page_id, page->GetData());
+    WritePageToDisk(page);
     page->is_dirty_ = false;
+    ResetRecLSN(page);
     ++iter;
   }
 }
@@ -105,7 +121,7 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   } else if (replacer_->Victim(&frame_id)) {
     page = &pages_[frame_id];
     if (page->IsDirty()) {
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
+      WritePageToDisk(page);
     }
     page_table_.erase(page->GetPageId());
   } else {
@@ -115,6 +131,8 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   auto new_page_id = AllocatePage();
   page->page_id_ = new_page_id;
   page->is_dirty_ = false;
+  page->rec_lsn_ = CleanRecLSN();
+  page->has_lsn_ = false;
   page->pin_count_ = 1;
   page->ResetMemory();
   // 4
@@ -124,6 +142,21 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   return page;
 }
 
+bool BufferPoolManagerInstance::IsPageResident(page_id_t page_id) {
+  std::scoped_lock lock{latch_};
+  return page_table_.find(page_id) != page_table_.end();
+}
+
+void BufferPoolManagerInstance::GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages) {
+  std::scoped_lock lock{latch_};
+  for (const auto &[page_id, frame_id] : page_table_) {
+    Page *page = &pages_[frame_id];
+    if (page->is_dirty_ || page->pin_count_ > 0) {
+      dirty_pages->emplace_back(page_id, page->rec_lsn_);
+    }
+  }
+}
+
 Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   // 1.     Search the page table for the requested page (P).
   // 1.1    If P exists, pin it and return it immediately.
@@ -137,7 +170,10 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   if (page_table_.find(page_id) != page_table_.end()) {
     auto frame_id = page_table_[page_id];
     Page *page = &pages_[frame_id];
-    page->pin_count_++;
+    // A clean page may only be changed by the users pinning it from now on.
+    if (page->pin_count_++ == 0 && !page->is_dirty_) {
+      page->rec_lsn_ = CleanRecLSN();
+    }
     replacer_->Pin(frame_id);
     return page;
   }
@@ -151,7 +187,7 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   } else if (replacer_->Victim(&frame_id)) {
     page = &pages_[frame_id];
     if (page->IsDirty()) {
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
+      WritePageToDisk(page);
     }
     // 3
     page_table_.erase(page->GetPageId());
@@ -163,6 +199,8 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   page->page_id_ = page_id;
   page->pin_count_ = 1;
   page->is_dirty_ = false;
+  page->rec_lsn_ = CleanRecLSN();
+  page->has_lsn_ = false;
   // 填充数据
   disk_manager_->ReadPage(page->GetPageId(), page->GetData());
   page_table_[page_id] = frame_id;
@@ -191,7 +229,7 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
   }
   // 3
   if (page->IsDirty()) {
-    disk_manager_->WritePage(page->GetPageId(), page->GetData());
+    WritePageToDisk(page);
   }
   page_table_.erase(page->GetPageId());
   replacer_->Pin(frame_id);
@@ -38,6 +38,16 @@ size_t ParallelBufferPoolManager::GetPoolSize() {
   return num_instances_ * pool_size_;
 }
 
+bool ParallelBufferPoolManager::IsPageResident(page_id_t page_id) {
+  return GetBufferPoolManager(page_id)->IsPageResident(page_id);
+}
+
+void ParallelBufferPoolManager::GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages) {
+  for (auto *manager : managers_) {
+    manager->GetDirtyPageTable(dirty_pages);
+  }
+}
+
 BufferPoolManager *ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   return managers_[page_id % num_instances_];
@@ -13,91 +13,111 @@
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <string_view>
 #include <utility>
 #include <vector>
 
 namespace bustub {
 
+LockManager::QueueHandle::QueueHandle(LockManager *lock_mgr, const RID &rid)
+    : shard_(lock_mgr->ShardOf(rid)), rid_(rid) {
+  {
+    std::scoped_lock shard_lock(shard_.latch_);
+    // unordered_map never moves its nodes, and a queue with a user is never reclaimed, so the queue stays
+    // valid once the shard latch is released.
+    queue_ = &shard_.lock_table_[rid];
+    queue_->users_++;
+  }
+  // A busy queue must not hold up the lookups of the other queues in the shard.
+  lock_ = std::unique_lock<std::mutex>(queue_->latch_);
+}
+
+LockManager::QueueHandle::~QueueHandle() {
+  // Leave while holding the queue latch, so that the last user to leave sees the final state of the queue.
+  bool reclaim = --queue_->users_ == 0 && queue_->request_queue_.empty();
+  lock_.unlock();
+  if (!reclaim) {
+    return;
+  }
+  // Users only register under the shard latch, so the queue is unused for good if it still has none.
+  std::scoped_lock shard_lock(shard_.latch_);
+  auto it = shard_.lock_table_.find(rid_);
+  if (it != shard_.lock_table_.end() && it->second.users_ == 0 && it->second.request_queue_.empty()) {
+    shard_.lock_table_.erase(it);
+  }
+}
+
+LockManager::LockManager(DeadlockPolicy policy, size_t escalation_threshold)
+    : policy_(policy), escalation_threshold_(escalation_threshold) {
+  if (policy_ == DeadlockPolicy::DETECTION) {
+    enable_cycle_detection_ = true;
+    cycle_detection_thread_ = std::thread(&LockManager::RunCycleDetection, this);
+  }
+}
+
+LockManager::~LockManager() {
+  enable_cycle_detection_ = false;
+  if (cycle_detection_thread_.joinable()) {
+    cycle_detection_thread_.join();
+  }
+}
+
+size_t LockManager::GetQueueCount() {
+  size_t count = 0;
+  for (auto &shard : shards_) {
+    std::scoped_lock shard_lock(shard.latch_);
+    count += shard.lock_table_.size();
+  }
+  return count;
+}
+
 bool LockManager::LockShared(Transaction *txn, const RID &rid) {
-  std::unique_lock<std::mutex> lk(latch_);
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
   }
   // 事务状态为SHRINKING时不能加锁
   if (txn->GetState() == TransactionState::SHRINKING) {
-    txn->SetState(TransactionState::ABORTED);
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
     return false;
   }
   // 事务类型为READ_UNCOMMITTED没有S锁
   if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED) {
-    txn->SetState(TransactionState::ABORTED);
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
+    AbortTransaction(txn, AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
     return false;
   }
+  // 只读事务读快照，不需要S锁
+  if (txn->IsReadOnly()) {
+    return true;
+  }
   // 该tuple已经拥有锁
   if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid)) {
     return true;
   }
   
   LOG_DEBUG("%d want to get share %d",(int)txn->GetTransactionId(), (int)rid.GetSlotNum());
-  txn->SetState(TransactionState::GROWING);
-  auto &request_queue = lock_table_[rid].request_queue_;
-  auto &cv = lock_table_[rid].cv_;
-  auto txn_id = txn->GetTransactionId();
-  request_queue.emplace_back(txn_id, LockMode::SHARED);
-
-  auto check_func = [&]() {
-    bool is_continue = true;
-    auto it = request_queue.begin();
-    while (it != request_queue.end()) {
-      if (it->txn_id_ == txn_id) {
-        it->granted_ = is_continue;
-        return is_continue;
-      }
-      if (it->lock_mode_ == LockMode::EXCLUSIVE) {
-        // 杀死低优先级的所有锁
-        if (it->txn_id_ > txn_id) {
-          Transaction *tst = TransactionManager::GetTransaction(it->txn_id_);
-          tst->SetState(TransactionState::ABORTED);
-          tst->GetExclusiveLockSet()->erase(rid);
-          tst->GetSharedLockSet()->erase(rid);
-          it = lock_table_[rid].request_queue_.erase(it);
-          LOG_DEBUG("SHARED: %d kill %d",(int)txn->GetTransactionId(), (int)it->txn_id_);
-          cv.notify_all();
-        } else {
-          is_continue = false;
-          ++it;
-        }
-      }
-      else ++it;
-    }
-    return true;
-  };
-
-  while (!check_func() && txn->GetState() != TransactionState::ABORTED) {
-    cv.wait(lk);
-  }
-  // 在check过程中可能被aborted
-  if (txn->GetState() == TransactionState::ABORTED) {
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
-    return false;
-  }
+  QueueHandle queue(this, rid);
+  queue->request_queue_.emplace_back(txn->GetTransactionId(), LockMode::SHARED);
 
+  WaitForGrant(txn, &queue, LockStatsMode::ROW_SHARED);
   txn->GetSharedLockSet()->emplace(rid);
+  stats_.RecordAcquire(LockStatsMode::ROW_SHARED);
   return true;
 }
 
 bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
-  std::unique_lock<std::mutex> lk(latch_);
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
   }
   if (txn->GetState() == TransactionState::SHRINKING) {
-    txn->SetState(TransactionState::ABORTED);
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
     return false;
   }
+  // 只读事务不能写
+  if (txn->IsReadOnly()) {
+    AbortTransaction(txn, AbortReason::WRITE_ON_READ_ONLY);
+  }
   // 该tuple已经有共享锁，升级锁
   if (txn->IsSharedLocked(rid)) {
     LockUpgrade(txn, rid);
@@ -107,74 +127,41 @@ bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
   }
   
   LOG_DEBUG("%d want to get exclusive %d",(int)txn->GetTransactionId(), (int)rid.GetSlotNum());
-  txn->SetState(TransactionState::GROWING);
-  auto &request_queue = lock_table_[rid].request_queue_;
-  auto &cv = lock_table_[rid].cv_;
-  auto txn_id = txn->GetTransactionId();
-  request_queue.emplace_back(txn_id, LockMode::EXCLUSIVE);
+  QueueHandle queue(this, rid);
+  queue->request_queue_.emplace_back(txn->GetTransactionId(), LockMode::EXCLUSIVE);
 
-  auto check_func = [&]() {
-    auto it = request_queue.begin();
-    while (it != request_queue.end()) {
-      if (it->txn_id_ == txn_id) {
-        it->granted_ = true;
-        return true;
-      }
-      // 杀死低优先级的所有锁
-      if (it->txn_id_ > txn_id) {
-        Transaction *tst = TransactionManager::GetTransaction(it->txn_id_);
-        tst->SetState(TransactionState::ABORTED);
-        tst->GetExclusiveLockSet()->erase(rid);
-        tst->GetSharedLockSet()->erase(rid);
-        it = lock_table_[rid].request_queue_.erase(it);
-        LOG_DEBUG("SHARED: %d kill %d",(int)txn->GetTransactionId(), (int)it->txn_id_);
-        cv.notify_all();
-      } else {
-        // 继续wait
-        return false;
-      }
-    }
-    return true;
-  };
-
-  while (!check_func() && txn->GetState() != TransactionState::ABORTED) {
-    cv.wait(lk);
-  }
-  // 在check过程中可能被aborted
-  if (txn->GetState() == TransactionState::ABORTED) {
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
-    return false;
-  }
+  WaitForGrant(txn, &queue, LockStatsMode::ROW_EXCLUSIVE);
   txn->GetExclusiveLockSet()->emplace(rid);
+  stats_.RecordAcquire(LockStatsMode::ROW_EXCLUSIVE);
   return true;
 }
 
 bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
-  std::unique_lock<std::mutex> lk(latch_);
   // 检查事务当前没有被终止
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
   }
   // 事务状态为SHRINKING时不能升级锁
   if (txn->GetState() == TransactionState::SHRINKING) {
-    txn->SetState(TransactionState::ABORTED);
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
     return false;
   }
   // 已经有互斥锁了
   if (txn->IsExclusiveLocked(rid)) {
     return true;
   }
+  QueueHandle queue(this, rid);
   // 该事务已经提交过更新锁了
-  if (lock_table_[rid].upgrading_ != INVALID_TXN_ID) {
+  if (queue->upgrading_ != INVALID_TXN_ID) {
     txn->SetState(TransactionState::ABORTED);
+    stats_.RecordAbort(AbortReason::UPGRADE_CONFLICT);
     return false;
   }
-  lock_table_[rid].upgrading_ = txn->GetTransactionId();
+  queue->upgrading_ = txn->GetTransactionId();
 
   // 把锁请求清除
-  auto &request_queue = lock_table_[rid].request_queue_;
-  auto &cv = lock_table_[rid].cv_;
+  auto &request_queue = queue->request_queue_;
+  auto &cv = queue->cv_;
   auto txn_id = txn->GetTransactionId();
   auto it = request_queue.begin();
   while (it != request_queue.end()) {
@@ -192,54 +179,116 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
   LOG_DEBUG("%d want to get exclusive %d",(int)txn->GetTransactionId(), (int)rid.GetSlotNum());
   request_queue.emplace_back(txn_id, LockMode::EXCLUSIVE);
 
-  auto check_func = [&]() {
-    auto it = request_queue.begin();
-    while (it != request_queue.end()) {
-      if (it->txn_id_ == txn_id) {
-        it->granted_ = true;
-        return true;
-      }
-      // 杀死低优先级的所有锁
-      if (it->txn_id_ > txn_id) {
-        Transaction *tst = TransactionManager::GetTransaction(it->txn_id_);
-        tst->SetState(TransactionState::ABORTED);
-        tst->GetExclusiveLockSet()->erase(rid);
-        tst->GetSharedLockSet()->erase(rid);
-        it = lock_table_[rid].request_queue_.erase(it);
-        LOG_DEBUG("SHARED: %d kill %d",(int)txn->GetTransactionId(), (int)it->txn_id_);
-        cv.notify_all();
-      } else {
-        // 继续wait
-        return false;
+  WaitForGrant(txn, &queue, LockStatsMode::ROW_EXCLUSIVE);
+
+  queue->upgrading_ = INVALID_TXN_ID;
+
+  txn->GetExclusiveLockSet()->emplace(rid);
+  stats_.RecordAcquire(LockStatsMode::ROW_EXCLUSIVE);
+  return true;
+}
+
+bool LockManager::CheckGrant(Transaction *txn, const RID &rid, LockRequestQueue *queue) {
+  auto &request_queue = queue->request_queue_;
+  auto txn_id = txn->GetTransactionId();
+  auto request = std::find_if(request_queue.begin(), request_queue.end(),
+                              [txn_id](const LockRequest &r) { return r.txn_id_ == txn_id; });
+  // 只需要和排在前面的请求兼容
+  bool grantable = true;
+  auto it = request_queue.begin();
+  while (it != request) {
+    if (it->lock_mode_ == LockMode::SHARED && request->lock_mode_ == LockMode::SHARED) {
+      ++it;
+      continue;
+    }
+    // 杀死低优先级的冲突锁，只标记终止并移出请求，它的锁集合由它自己的线程清理；已经结束的事务不用杀死
+    Transaction *victim = policy_ == DeadlockPolicy::WOUND_WAIT && it->txn_id_ > txn_id
+                              ? TransactionManager::GetTransaction(it->txn_id_)
+                              : nullptr;
+    if (victim != nullptr) {
+      // 同一个事务可能被多次杀死，只统计第一次
+      if (victim->ExchangeState(TransactionState::ABORTED) != TransactionState::ABORTED) {
+        stats_.RecordWound();
       }
+      LOG_DEBUG("%d kill %d", static_cast<int>(txn_id), static_cast<int>(it->txn_id_));
+      it = request_queue.erase(it);
+      queue->cv_.notify_all();
+      continue;
     }
-    return true;
-  };
+    if (policy_ == DeadlockPolicy::WAIT_DIE && it->txn_id_ < txn_id) {
+      // 不等待比自己老的事务，自己终止
+      txn->SetState(TransactionState::ABORTED);
+      stats_.RecordAbort(AbortReason::DEADLOCK);
+      return false;
+    }
+    grantable = false;
+    ++it;
+  }
+  request->granted_ = grantable;
+  return grantable;
+}
 
-  while (!check_func() && txn->GetState() != TransactionState::ABORTED) {
-    cv.wait(lk);
+void LockManager::WaitForGrant(Transaction *txn, QueueHandle *queue, LockStatsMode mode) {
+  auto &lk = queue->Lock();
+  // 只有真正等待时才计时
+  bool waited = false;
+  std::chrono::steady_clock::time_point wait_start;
+  // 被杀死时请求可能已经被移出队列，先检查状态
+  while (txn->GetState() != TransactionState::ABORTED && !CheckGrant(txn, queue->GetRid(), queue->operator->())) {
+    // wait-die在检查中可能终止了自己
+    if (txn->GetState() == TransactionState::ABORTED) {
+      break;
+    }
+    if (!waited) {
+      waited = true;
+      wait_start = std::chrono::steady_clock::now();
+    }
+    (*queue)->cv_.wait(lk);
   }
-  // 在check过程中可能被aborted
-  if (txn->GetState() == TransactionState::ABORTED) {
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
-    return false;
+  if (waited) {
+    stats_.RecordRowWait(mode, queue->GetRid(), std::chrono::steady_clock::now() - wait_start);
   }
+  if (txn->GetState() != TransactionState::ABORTED) {
+    return;
+  }
+  auto txn_id = txn->GetTransactionId();
+  (*queue)->request_queue_.remove_if([txn_id](const LockRequest &r) { return r.txn_id_ == txn_id; });
+  if ((*queue)->upgrading_ == txn_id) {
+    (*queue)->upgrading_ = INVALID_TXN_ID;
+  }
+  // 终止它的事务已经统计过了
+  (*queue)->cv_.notify_all();
+  throw TransactionAbortException(txn_id, AbortReason::DEADLOCK);
+}
 
-  lock_table_[rid].upgrading_ = INVALID_TXN_ID;
-
-  txn->GetExclusiveLockSet()->emplace(rid);
-  return true;
+void LockManager::AbortTransaction(Transaction *txn, AbortReason reason) {
+  txn->SetState(TransactionState::ABORTED);
+  stats_.RecordAbort(reason);
+  throw TransactionAbortException(txn->GetTransactionId(), reason);
 }
 
 bool LockManager::Unlock(Transaction *txn, const RID &rid) {
-  std::unique_lock<std::mutex> lk(latch_);
-  // 只有REPEATABLE_READ遵守2PL，应该改状态
-  if (txn->GetState() == TransactionState::GROWING && txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ) {
+  // 只读事务没有锁，也没有锁集合
+  if (txn->IsReadOnly()) {
+    return true;
+  }
+  // 只有REPEATABLE_READ和SERIALIZABLE遵守2PL，应该改状态
+  if (txn->GetState() == TransactionState::GROWING && (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+                                                       txn->GetIsolationLevel() == IsolationLevel::SERIALIZABLE)) {
     txn->SetState(TransactionState::SHRINKING);
   }
+  ReleaseRowLock(txn, rid);
+  for (auto &[oid, row_locks] : *txn->GetTableRowLockSet()) {
+    row_locks.erase(rid);
+  }
+  return true;
+}
+
+void LockManager::ReleaseRowLock(Transaction *txn, const RID &rid) {
   // 把锁请求清除
-  auto &request_queue = lock_table_[rid].request_queue_;
-  auto &cv = lock_table_[rid].cv_;
+  QueueHandle queue(this, rid);
+  auto &request_queue = queue->request_queue_;
+  auto &cv = queue->cv_;
   auto txn_id = txn->GetTransactionId();
   auto it = request_queue.begin();
   while (it != request_queue.end()) {
@@ -248,11 +297,442 @@ bool LockManager::Unlock(Transaction *txn, const RID &rid) {
     }
     ++it;
   }
-  request_queue.erase(it);
+  if (it != request_queue.end()) {
+    request_queue.erase(it);
+  }
   cv.notify_all();
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->erase(rid);
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock lock(waits_for_latch_);
+  waits_for_[t1].insert(t2);
+}
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock lock(waits_for_latch_);
+  auto edges = waits_for_.find(t1);
+  if (edges != waits_for_.end()) {
+    edges->second.erase(t2);
+  }
+}
+
+bool LockManager::HasCycle(txn_id_t *txn_id) {
+  std::scoped_lock lock(waits_for_latch_);
+  std::unordered_set<txn_id_t> visited;
+  // 从最小的事务开始，按顺序深度优先搜索
+  for (const auto &[start, edges] : waits_for_) {
+    std::vector<txn_id_t> path;
+    if (FindCycle(start, &path, &visited, txn_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LockManager::FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::unordered_set<txn_id_t> *visited,
+                            txn_id_t *newest) {
+  auto on_path = std::find(path->begin(), path->end(), txn_id);
+  if (on_path != path->end()) {
+    *newest = *std::max_element(on_path, path->end());
+    return true;
+  }
+  // 已经搜索过的事务不在环上
+  if (!visited->insert(txn_id).second) {
+    return false;
+  }
+  path->push_back(txn_id);
+  auto edges = waits_for_.find(txn_id);
+  if (edges != waits_for_.end()) {
+    for (auto next : edges->second) {
+      if (FindCycle(next, path, visited, newest)) {
+        return true;
+      }
+    }
+  }
+  path->pop_back();
+  return false;
+}
+
+std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
+  std::scoped_lock lock(waits_for_latch_);
+  std::vector<std::pair<txn_id_t, txn_id_t>> edge_list;
+  for (const auto &[t1, edges] : waits_for_) {
+    for (auto t2 : edges) {
+      edge_list.emplace_back(t1, t2);
+    }
+  }
+  return edge_list;
+}
+
+void LockManager::BuildWaitsForGraph(std::unordered_map<txn_id_t, RID> *row_waits,
+                                     std::unordered_map<txn_id_t, table_oid_t> *table_waits) {
+  {
+    std::scoped_lock lock(waits_for_latch_);
+    waits_for_.clear();
+  }
+  // 未授予的行锁请求等待排在它前面的冲突请求
+  for (auto &shard : shards_) {
+    std::scoped_lock shard_lock(shard.latch_);
+    for (auto &[rid, queue] : shard.lock_table_) {
+      std::scoped_lock queue_lock(queue.latch_);
+      for (auto waiter = queue.request_queue_.begin(); waiter != queue.request_queue_.end(); ++waiter) {
+        if (waiter->granted_) {
+          continue;
+        }
+        for (auto holder = queue.request_queue_.begin(); holder != waiter; ++holder) {
+          if (holder->txn_id_ != waiter->txn_id_ &&
+              (holder->lock_mode_ == LockMode::EXCLUSIVE || waiter->lock_mode_ == LockMode::EXCLUSIVE)) {
+            AddEdge(waiter->txn_id_, holder->txn_id_);
+            row_waits->emplace(waiter->txn_id_, rid);
+          }
+        }
+      }
+    }
+  }
+  // 未授予的表锁请求等待已授予的和排在它前面的冲突请求，升级的请求只等待已授予的请求
+  std::scoped_lock table_lock(table_latch_);
+  for (auto &[oid, queue] : table_lock_table_) {
+    for (auto waiter = queue.request_queue_.begin(); waiter != queue.request_queue_.end(); ++waiter) {
+      if (waiter->granted_ && !waiter->upgrading_) {
+        continue;
+      }
+      TableLockMode wanted = waiter->upgrading_ ? waiter->upgrade_mode_ : waiter->lock_mode_;
+      bool ahead = true;
+      for (auto holder = queue.request_queue_.begin(); holder != queue.request_queue_.end(); ++holder) {
+        if (holder == waiter) {
+          ahead = false;
+        } else if (((holder->granted_ || (ahead && !waiter->upgrading_)) &&
+                    !AreTableLocksCompatible(holder->lock_mode_, wanted)) ||
+                   (ahead && !waiter->upgrading_ && holder->upgrading_ &&
+                    !AreTableLocksCompatible(holder->upgrade_mode_, wanted))) {
+          AddEdge(waiter->txn_id_, holder->txn_id_);
+          table_waits->emplace(waiter->txn_id_, oid);
+        }
+      }
+    }
+  }
+}
+
+void LockManager::RunCycleDetection() {
+  while (enable_cycle_detection_) {
+    std::this_thread::sleep_for(cycle_detection_interval);
+    std::unordered_map<txn_id_t, RID> row_waits;
+    std::unordered_map<txn_id_t, table_oid_t> table_waits;
+    BuildWaitsForGraph(&row_waits, &table_waits);
+
+    txn_id_t victim;
+    while (HasCycle(&victim)) {
+      LOG_DEBUG("deadlock detected, aborting %d", static_cast<int>(victim));
+      {
+        std::scoped_lock lock(waits_for_latch_);
+        waits_for_.erase(victim);
+        for (auto &[txn_id, edges] : waits_for_) {
+          edges.erase(victim);
+        }
+      }
+      // 图可能已经过时：只有受害者还在它等待的队列里排着，才能确定它还活着。终止它、唤醒它都在持有
+      // 队列latch时完成，它会自己把请求移出队列
+      if (auto rid = row_waits.find(victim); rid != row_waits.end()) {
+        QueueHandle queue(this, rid->second);
+        auto &requests = queue->request_queue_;
+        if (std::any_of(requests.begin(), requests.end(),
+                        [victim](const auto &request) { return request.txn_id_ == victim && !request.granted_; })) {
+          AbortVictim(victim);
+          queue->cv_.notify_all();
+        }
+      } else if (auto oid = table_waits.find(victim); oid != table_waits.end()) {
+        std::scoped_lock table_lock(table_latch_);
+        auto queue = table_lock_table_.find(oid->second);
+        if (queue != table_lock_table_.end()) {
+          auto &requests = queue->second.request_queue_;
+          if (std::any_of(requests.begin(), requests.end(), [victim](const auto &request) {
+                return request.txn_id_ == victim && (!request.granted_ || request.upgrading_);
+              })) {
+            AbortVictim(victim);
+            queue->second.cv_.notify_all();
+          }
+        }
+      }
+    }
+
+    std::scoped_lock lock(waits_for_latch_);
+    waits_for_.clear();
+  }
+}
+
+void LockManager::AbortVictim(txn_id_t victim) {
+  Transaction *victim_txn = TransactionManager::GetTransaction(victim);
+  if (victim_txn == nullptr) {
+    return;
+  }
+  // 正在等锁的事务不会提交，但可能已经被别人终止了，只统计这一次终止
+  TransactionState state = victim_txn->GetState();
+  if ((state == TransactionState::GROWING || state == TransactionState::SHRINKING) &&
+      victim_txn->ExchangeState(TransactionState::ABORTED) != TransactionState::ABORTED) {
+    stats_.RecordAbort(AbortReason::DEADLOCK);
+  }
+}
+
+bool LockManager::AreTableLocksCompatible(TableLockMode held, TableLockMode wanted) {
+  // Rows and columns are ordered like TableLockMode: IS, IX, S, SIX, X.
+  static constexpr bool COMPATIBLE[5][5] = {{true, true, true, true, false},
+                                            {true, true, false, false, false},
+                                            {true, false, true, false, false},
+                                            {true, false, false, false, false},
+                                            {false, false, false, false, false}};
+  return COMPATIBLE[static_cast<int>(held)][static_cast<int>(wanted)];
+}
+
+TableLockMode LockManager::CombineTableLocks(TableLockMode held, TableLockMode wanted) {
+  using M = TableLockMode;
+  static constexpr M COMBINED[5][5] = {{M::INTENTION_SHARED, M::INTENTION_EXCLUSIVE, M::SHARED,
+                                        M::SHARED_INTENTION_EXCLUSIVE, M::EXCLUSIVE},
+                                       {M::INTENTION_EXCLUSIVE, M::INTENTION_EXCLUSIVE, M::SHARED_INTENTION_EXCLUSIVE,
+                                        M::SHARED_INTENTION_EXCLUSIVE, M::EXCLUSIVE},
+                                       {M::SHARED, M::SHARED_INTENTION_EXCLUSIVE, M::SHARED,
+                                        M::SHARED_INTENTION_EXCLUSIVE, M::EXCLUSIVE},
+                                       {M::SHARED_INTENTION_EXCLUSIVE, M::SHARED_INTENTION_EXCLUSIVE,
+                                        M::SHARED_INTENTION_EXCLUSIVE, M::SHARED_INTENTION_EXCLUSIVE, M::EXCLUSIVE},
+                                       {M::EXCLUSIVE, M::EXCLUSIVE, M::EXCLUSIVE, M::EXCLUSIVE, M::EXCLUSIVE}};
+  return COMBINED[static_cast<int>(held)][static_cast<int>(wanted)];
+}
+
+void LockManager::ReclaimTableQueue(table_oid_t oid) {
+  auto it = table_lock_table_.find(oid);
+  if (it != table_lock_table_.end() && it->second.request_queue_.empty() && it->second.waiting_ == 0) {
+    table_lock_table_.erase(it);
+  }
+}
+
+bool LockManager::LockTable(Transaction *txn, table_oid_t oid, TableLockMode mode) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+  // READ_UNCOMMITTED只有写锁
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && mode != TableLockMode::INTENTION_EXCLUSIVE &&
+      mode != TableLockMode::EXCLUSIVE) {
+    AbortTransaction(txn, AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
+  }
+  // 只读事务读快照不加锁，也不能写
+  if (txn->IsReadOnly()) {
+    if (mode == TableLockMode::INTENTION_SHARED || mode == TableLockMode::SHARED) {
+      return true;
+    }
+    AbortTransaction(txn, AbortReason::WRITE_ON_READ_ONLY);
+  }
+  auto table_locks = txn->GetTableLockSet();
+  auto held = table_locks->find(oid);
+  TableLockMode wanted = held == table_locks->end() ? mode : CombineTableLocks(held->second, mode);
+  // 已经拥有足够强的锁
+  if (held != table_locks->end() && held->second == wanted) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lk(table_latch_);
+  auto &queue = table_lock_table_[oid];
+  auto &request_queue = queue.request_queue_;
+  auto txn_id = txn->GetTransactionId();
+  // 升级的请求保留原来的位置和已经授予的锁
+  auto request = std::find_if(request_queue.begin(), request_queue.end(),
+                              [txn_id](const TableLockRequest &r) { return r.txn_id_ == txn_id; });
+  bool upgrading = request != request_queue.end();
+  if (upgrading) {
+    request->upgrading_ = true;
+    request->upgrade_mode_ = wanted;
+  } else {
+    request = request_queue.emplace(request_queue.end(), txn_id, wanted);
+  }
+
+  // A new request has to be compatible with every granted request, and with every request queued before it,
+  // including the mode a pending upgrade ahead of it asks for. An upgrade only waits for the granted requests.
+  auto check_func = [&]() {
+    bool grantable = true;
+    bool ahead = true;
+    auto it = request_queue.begin();
+    while (it != request_queue.end()) {
+      if (it == request) {
+        ahead = false;
+      } else if (((it->granted_ || (ahead && !upgrading)) && !AreTableLocksCompatible(it->lock_mode_, wanted)) ||
+                 (ahead && !upgrading && it->upgrading_ && !AreTableLocksCompatible(it->upgrade_mode_, wanted))) {
+        // 杀死低优先级的冲突锁，同行锁一样只标记终止并移出请求
+        Transaction *victim = policy_ == DeadlockPolicy::WOUND_WAIT && it->txn_id_ > txn_id
+                                  ? TransactionManager::GetTransaction(it->txn_id_)
+                                  : nullptr;
+        if (victim != nullptr) {
+          if (victim->ExchangeState(TransactionState::ABORTED) != TransactionState::ABORTED) {
+            stats_.RecordWound();
+          }
+          LOG_DEBUG("TABLE: %d kill %d", static_cast<int>(txn_id), static_cast<int>(it->txn_id_));
+          it = request_queue.erase(it);
+          queue.cv_.notify_all();
+          continue;
+        }
+        if (policy_ == DeadlockPolicy::WAIT_DIE && it->txn_id_ < txn_id) {
+          txn->SetState(TransactionState::ABORTED);
+          stats_.RecordAbort(AbortReason::DEADLOCK);
+          return false;
+        }
+        grantable = false;
+      }
+      ++it;
+    }
+    if (grantable) {
+      request->lock_mode_ = wanted;
+      request->granted_ = true;
+      request->upgrading_ = false;
+    }
+    return grantable;
+  };
+
+  bool waited = false;
+  std::chrono::steady_clock::time_point wait_start;
+  // 被杀死时请求已经被移出队列，先检查状态
+  while (txn->GetState() != TransactionState::ABORTED && !check_func()) {
+    if (txn->GetState() == TransactionState::ABORTED) {
+      break;
+    }
+    if (!waited) {
+      waited = true;
+      wait_start = std::chrono::steady_clock::now();
+    }
+    queue.waiting_++;
+    queue.cv_.wait(lk);
+    queue.waiting_--;
+  }
+  if (waited) {
+    stats_.RecordTableWait(LockStats::ForTable(wanted), oid, std::chrono::steady_clock::now() - wait_start);
+  }
+  if (txn->GetState() == TransactionState::ABORTED) {
+    request = std::find_if(request_queue.begin(), request_queue.end(),
+                           [txn_id](const TableLockRequest &r) { return r.txn_id_ == txn_id; });
+    if (request == request_queue.end()) {
+      // 被杀死时请求连同已经授予的锁一起被移出了队列
+      table_locks->erase(oid);
+    } else if (upgrading) {
+      // 升级失败，原来的锁仍然授予
+      request->upgrading_ = false;
+    } else {
+      request_queue.erase(request);
+    }
+    queue.cv_.notify_all();
+    ReclaimTableQueue(oid);
+    throw TransactionAbortException(txn_id, AbortReason::DEADLOCK);
+  }
+
+  (*table_locks)[oid] = wanted;
+  stats_.RecordAcquire(LockStats::ForTable(wanted));
+  return true;
+}
+
+bool LockManager::UnlockTable(Transaction *txn, table_oid_t oid) {
+  if (txn->IsReadOnly()) {
+    return true;
+  }
+  if (txn->GetState() == TransactionState::GROWING && (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+                                                       txn->GetIsolationLevel() == IsolationLevel::SERIALIZABLE)) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  std::scoped_lock lk(table_latch_);
+  auto queue = table_lock_table_.find(oid);
+  if (queue != table_lock_table_.end()) {
+    auto &request_queue = queue->second.request_queue_;
+    auto txn_id = txn->GetTransactionId();
+    auto request = std::find_if(request_queue.begin(), request_queue.end(),
+                                [txn_id](const TableLockRequest &r) { return r.txn_id_ == txn_id; });
+    if (request != request_queue.end()) {
+      request_queue.erase(request);
+    }
+    queue->second.cv_.notify_all();
+    ReclaimTableQueue(oid);
+  }
+  txn->GetTableLockSet()->erase(oid);
+  txn->GetTableRowLockSet()->erase(oid);
+  return true;
+}
+
+bool LockManager::EscalateTableLock(Transaction *txn, table_oid_t oid, TableLockMode mode) {
+  if (!LockTable(txn, oid, mode)) {
+    return false;
+  }
+  LOG_DEBUG("%d escalates to a table lock on %d", static_cast<int>(txn->GetTransactionId()), static_cast<int>(oid));
+  // 表锁已经覆盖的行锁可以放掉，不改变2PL状态
+  bool exclusive = txn->GetTableLockSet()->at(oid) == TableLockMode::EXCLUSIVE;
+  auto &row_locks = (*txn->GetTableRowLockSet())[oid];
+  for (auto it = row_locks.begin(); it != row_locks.end();) {
+    if (exclusive || !txn->IsExclusiveLocked(*it)) {
+      ReleaseRowLock(txn, *it);
+      it = row_locks.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return true;
+}
+
+bool LockManager::LockShared(Transaction *txn, table_oid_t oid, const RID &rid) {
+  if (!LockTable(txn, oid, TableLockMode::INTENTION_SHARED)) {
+    return false;
+  }
+  // 只读事务读快照，没有锁集合
+  if (txn->IsReadOnly()) {
+    return true;
+  }
+  // S、SIX、X表锁已经覆盖了整张表的读
+  TableLockMode table_mode = txn->GetTableLockSet()->at(oid);
+  if (CombineTableLocks(table_mode, TableLockMode::SHARED) == table_mode) {
+    return true;
+  }
+  if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid)) {
+    return true;
+  }
+  auto &row_locks = (*txn->GetTableRowLockSet())[oid];
+  if (row_locks.size() >= escalation_threshold_) {
+    return EscalateTableLock(txn, oid, TableLockMode::SHARED);
+  }
+  if (!LockShared(txn, rid)) {
+    return false;
+  }
+  row_locks.emplace(rid);
   return true;
 }
 
+bool LockManager::LockExclusive(Transaction *txn, table_oid_t oid, const RID &rid) {
+  // 只读事务在LockTable中已经终止
+  if (!LockTable(txn, oid, TableLockMode::INTENTION_EXCLUSIVE)) {
+    return false;
+  }
+  if (txn->GetTableLockSet()->at(oid) == TableLockMode::EXCLUSIVE || txn->IsExclusiveLocked(rid)) {
+    return true;
+  }
+  // 升级已有的行锁不增加行锁数量
+  auto &row_locks = (*txn->GetTableRowLockSet())[oid];
+  if (!txn->IsSharedLocked(rid) && row_locks.size() >= escalation_threshold_) {
+    return EscalateTableLock(txn, oid, TableLockMode::EXCLUSIVE);
+  }
+  if (!LockExclusive(txn, rid)) {
+    return false;
+  }
+  row_locks.emplace(rid);
+  return true;
+}
+
+bool LockManager::LockKeyShared(Transaction *txn, index_oid_t index_oid, const Tuple &key) {
+  return LockShared(txn, GetKeyLockName(index_oid, key));
+}
+
+bool LockManager::LockKeyExclusive(Transaction *txn, index_oid_t index_oid, const Tuple &key) {
+  return LockExclusive(txn, GetKeyLockName(index_oid, key));
+}
+
+RID LockManager::GetKeyLockName(index_oid_t index_oid, const Tuple &key) {
+  // 页号取负数，避开INVALID_PAGE_ID和所有真实的页
+  auto key_hash = std::hash<std::string_view>{}(std::string_view(key.GetData(), key.GetLength()));
+  return RID(-2 - static_cast<page_id_t>(index_oid), static_cast<uint32_t>(key_hash));
+}
+
 }  // namespace bustub
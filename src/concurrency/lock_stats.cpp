@@ -0,0 +1,88 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_stats.cpp
+//
+// Identification: src/concurrency/lock_stats.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/lock_stats.h"
+
+#include <functional>
+#include <thread>  // NOLINT
+
+namespace bustub {
+
+void LockStats::RecordAcquire(LockStatsMode mode) {
+  // 每个线程固定用一个条带，只在第一次调用时计算
+  static thread_local size_t stripe = std::hash<std::thread::id>{}(std::this_thread::get_id()) % STRIPE_COUNT;
+  stripes_[stripe].acquisitions_[static_cast<size_t>(mode)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStats::RecordRowWait(LockStatsMode mode, const RID &rid, std::chrono::steady_clock::duration wait_time) {
+  RecordWait(mode, wait_time);
+  hot_rids_.Add(rid);
+}
+
+void LockStats::RecordTableWait(LockStatsMode mode, table_oid_t oid, std::chrono::steady_clock::duration wait_time) {
+  RecordWait(mode, wait_time);
+  hot_tables_.Add(oid);
+}
+
+void LockStats::RecordWait(LockStatsMode mode, std::chrono::steady_clock::duration wait_time) {
+  auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(wait_time).count());
+  waits_[static_cast<size_t>(mode)].fetch_add(1, std::memory_order_relaxed);
+  wait_us_[static_cast<size_t>(mode)].fetch_add(us, std::memory_order_relaxed);
+  // 桶号是等待微秒数的二进制位数
+  size_t bucket = 0;
+  while (us != 0 && bucket + 1 < WAIT_BUCKETS) {
+    us >>= 1;
+    bucket++;
+  }
+  wait_histograms_[static_cast<size_t>(mode)][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LockStats::GetAcquisitions(LockStatsMode mode) {
+  uint64_t total = 0;
+  for (auto &stripe : stripes_) {
+    total += stripe.acquisitions_[static_cast<size_t>(mode)].load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+std::array<uint64_t, LockStats::WAIT_BUCKETS> LockStats::GetWaitHistogram(LockStatsMode mode) {
+  std::array<uint64_t, WAIT_BUCKETS> histogram;
+  for (size_t i = 0; i < WAIT_BUCKETS; i++) {
+    histogram[i] = wait_histograms_[static_cast<size_t>(mode)][i].load(std::memory_order_relaxed);
+  }
+  return histogram;
+}
+
+void LockStats::Reset() {
+  for (auto &stripe : stripes_) {
+    for (auto &count : stripe.acquisitions_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+  for (size_t mode = 0; mode < MODE_COUNT; mode++) {
+    waits_[mode].store(0, std::memory_order_relaxed);
+    wait_us_[mode].store(0, std::memory_order_relaxed);
+  }
+  for (auto &histogram : wait_histograms_) {
+    for (auto &count : histogram) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+  wounds_.store(0, std::memory_order_relaxed);
+  for (auto &count : aborts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  hot_rids_.Clear();
+  hot_tables_.Clear();
+}
+
+}  // namespace bustub
@@ -12,104 +12,296 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "catalog/catalog.h"
+#include "execution/index_write_batch.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
-std::shared_mutex TransactionManager::txn_map_mutex = {};
-
-Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) {
-  // Acquire the global transaction latch in shared mode.
-  global_txn_latch_.RLock();
+TransactionRegistry TransactionManager::txn_registry;
 
+Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level, bool read_only) {
   if (txn == nullptr) {
-    txn = new Transaction(next_txn_id_++, isolation_level);
+    txn = new Transaction(next_txn_id_++, isolation_level, read_only);
+  }
+  // Read-only transactions never wait for a lock nor write a log record, nobody needs to look them up.
+  if (!txn->IsReadOnly()) {
+    txn_registry.Insert(txn);
+    LogTransactionRecord(txn, LogRecordType::BEGIN);
+  }
+
+  // Take the snapshot. A writer records the versions its writes replace only while some snapshot may need them.
+  txn->SetVersionStore(&version_store_);
+  {
+    std::scoped_lock lock(ts_latch_);
+    txn->SetReadTs(last_commit_ts_);
+    if (HasSnapshot(txn)) {
+      // The writers that began with no snapshot taken record the images they replaced before this one reads them.
+      for (auto *writer : unversioned_writers_) {
+        std::scoped_lock write_lock(*writer->GetWriteLatch());
+        writer->SetVersioned(true);
+        version_store_.RecordWriteSet(writer);
+      }
+      unversioned_writers_.clear();
+      txn->SetVersioned(true);
+      active_snapshots_.insert(last_commit_ts_);
+    } else {
+      txn->SetVersioned(!active_snapshots_.empty());
+      if (!txn->IsVersioned()) {
+        unversioned_writers_.insert(txn);
+      }
+    }
   }
-  txn_map_mutex.lock();
-  txn_map[txn->GetTransactionId()] = txn;
-  txn_map_mutex.unlock();
   return txn;
 }
 
 void TransactionManager::Commit(Transaction *txn) {
+  // A read-only transaction has nothing to install, apply or unlock.
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::COMMITTED);
+    EndSnapshot(txn);
+    return;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    InstallBufferedWrites(txn);
+  }
   txn->SetState(TransactionState::COMMITTED);
 
-  // Perform all deletes before we commit.
-  auto write_set = txn->GetWriteSet();
-  while (!write_set->empty()) {
-    auto &item = write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
-    }
-    write_set->pop_back();
+  // The commit is durable before anyone can see it. Transactions committing together share one log write.
+  lsn_t commit_lsn = LogEndRecord(txn, LogRecordType::COMMIT);
+  if (commit_lsn != INVALID_LSN) {
+    log_manager_->Flush(commit_lsn);
+  }
+
+  // Stamp the versions before any lock goes, the next writer of a row must see this commit.
+  // Deleted tuples are still marked in the heap, so they already read as deleted.
+  {
+    std::scoped_lock lock(ts_latch_);
+    version_store_.Commit(txn, ++last_commit_ts_);
+    // The snapshots taken from now on see the commit, none of them needs the images it replaced.
+    unversioned_writers_.erase(txn);
   }
-  write_set->clear();
+
+  // Perform all deletes now that we commit. They come after the COMMIT record on purpose: a freed slot may be
+  // reused at once, so the deletes must be stamped first, and the stamp must follow the durable COMMIT record.
+  // Recovery takes an APPLYDELETE that is not a CLR as proof of the commit, even if the COMMIT record precedes
+  // the checkpoint it starts from.
+  FinishTableWrites(txn, true);
+  EndSnapshot(txn);
 
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
-  // Rollback before releasing the lock.
-  auto table_write_set = txn->GetWriteSet();
-  while (!table_write_set->empty()) {
-    auto &item = table_write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      table->RollbackDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::INSERT) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::UPDATE) {
-      table->UpdateTuple(item.tuple_, item.rid_, txn);
+  if (txn->IsReadOnly()) {
+    EndSnapshot(txn);
+    return;
+  }
+  // The buffered writes of an optimistic transaction never reached the heap.
+  txn->GetBufferedWriteSet()->clear();
+  txn->GetReadVersionSet()->clear();
+  // Rollback before releasing the lock. A snapshot that begins meanwhile waits to record the images first.
+  {
+    std::scoped_lock write_lock(*txn->GetWriteLatch());
+    FinishTableWrites(txn, false);
+    // The heap is rolled back, its images are current again.
+    version_store_.Abort(txn);
+  }
+  RollbackIndexWrites(txn);
+  EndSnapshot(txn);
+  LogEndRecord(txn, LogRecordType::ABORT);
+
+  // Release all the locks.
+  ReleaseLocks(txn);
+}
+
+void TransactionManager::InstallBufferedWrites(Transaction *txn) {
+  auto buffered_write_set = txn->GetBufferedWriteSet();
+  std::vector<RID> rids;
+  rids.reserve(buffered_write_set->size());
+  for (const auto &[rid, write] : *buffered_write_set) {
+    rids.push_back(rid);
+  }
+  // Lock the rows in RID order, so that concurrent commits queue up on the first row they share.
+  std::sort(rids.begin(), rids.end(), [](const RID &lhs, const RID &rhs) { return lhs.Get() < rhs.Get(); });
+  try {
+    for (const auto &rid : rids) {
+      if (lock_manager_ != nullptr) {
+        lock_manager_->LockExclusive(txn, buffered_write_set->at(rid).table_oid_, rid);
+      }
+    }
+  } catch (TransactionAbortException &e) {
+    Abort(txn);
+    throw;
+  }
+
+  // Row locks alone allow write skew: two transactions that each read the row the other one writes lock
+  // different rows, and both validate before either installs. Validating and installing one commit at a time
+  // lets the later one see the rows the earlier one wrote, they read as changed until that commit is stamped.
+  bool valid;
+  bool installed = true;
+  {
+    std::scoped_lock lock(validation_latch_);
+    valid = version_store_.Validate(txn);
+    for (size_t i = 0; valid && installed && i < rids.size(); i++) {
+      const BufferedWriteRecord &write = buffered_write_set->at(rids[i]);
+      installed = write.wtype_ == WType::DELETE ? write.table_->MarkDelete(rids[i], txn)
+                                                : write.table_->UpdateTuple(write.tuple_, rids[i], txn);
+    }
+  }
+  if (!valid || !installed) {
+    Abort(txn);
+    throw TransactionAbortException(txn->GetTransactionId(),
+                                    valid ? AbortReason::INSTALL_FAILED : AbortReason::VALIDATION_FAILED);
+  }
+
+  // The heap holds the new images, bring the indexes along, one batch per table.
+  std::vector<std::pair<table_oid_t, IndexWriteBatch>> batches;
+  for (const auto &rid : rids) {
+    const BufferedWriteRecord &write = buffered_write_set->at(rid);
+    auto batch = std::find_if(batches.begin(), batches.end(),
+                              [&write](const auto &batch) { return batch.first == write.table_oid_; });
+    if (batch == batches.end()) {
+      batch = batches.emplace(batches.end(), write.table_oid_,
+                              IndexWriteBatch(write.catalog_, write.catalog_->GetTable(write.table_oid_)));
+    }
+    if (write.wtype_ == WType::DELETE) {
+      batch->second.Delete(write.old_tuple_, rid);
+    } else {
+      batch->second.Update(write.old_tuple_, write.tuple_, rid);
     }
-    table_write_set->pop_back();
   }
-  table_write_set->clear();
-  // Rollback index updates
+  try {
+    for (auto &[oid, batch] : batches) {
+      batch.Apply(txn, lock_manager_);
+    }
+  } catch (TransactionAbortException &e) {
+    Abort(txn);
+    throw;
+  }
+  buffered_write_set->clear();
+  txn->GetReadVersionSet()->clear();
+}
+
+void TransactionManager::FinishTableWrites(Transaction *txn, bool commit) {
+  auto write_set = txn->GetWriteSet();
+  // A transaction writes few tables, a linear search finds the batch of a table quickly.
+  std::vector<std::pair<TableHeap *, std::vector<const TableWriteRecord *>>> batches;
+  for (auto item = write_set->rbegin(); item != write_set->rend(); ++item) {
+    auto batch = std::find_if(batches.begin(), batches.end(),
+                              [&item](const auto &batch) { return batch.first == item->table_; });
+    if (batch == batches.end()) {
+      batch = batches.emplace(batches.end(), item->table_, std::vector<const TableWriteRecord *>{});
+    }
+    batch->second.push_back(&*item);
+  }
+  for (const auto &[table, writes] : batches) {
+    table->FinishWrites(writes, commit, txn);
+  }
+  write_set->clear();
+}
+
+void TransactionManager::RollbackIndexWrites(Transaction *txn) {
   auto index_write_set = txn->GetIndexWriteSet();
-  while (!index_write_set->empty()) {
-    auto &item = index_write_set->back();
-    auto catalog = item.catalog_;
-    // Metadata identifying the table that should be deleted from.
-    TableInfo *table_info = catalog->GetTable(item.table_oid_);
-    IndexInfo *index_info = catalog->GetIndex(item.index_oid_);
-    auto new_key = item.tuple_.KeyFromTuple(table_info->schema_, *(index_info->index_->GetKeySchema()),
-                                            index_info->index_->GetKeyAttrs());
-    if (item.wtype_ == WType::DELETE) {
-      index_info->index_->InsertEntry(new_key, item.rid_, txn);
-    } else if (item.wtype_ == WType::INSERT) {
-      index_info->index_->DeleteEntry(new_key, item.rid_, txn);
-    } else if (item.wtype_ == WType::UPDATE) {
-      // Delete the new key and insert the old key
-      index_info->index_->DeleteEntry(new_key, item.rid_, txn);
-      auto old_key = item.old_tuple_.KeyFromTuple(table_info->schema_, *(index_info->index_->GetKeySchema()),
-                                                  index_info->index_->GetKeyAttrs());
-      index_info->index_->InsertEntry(old_key, item.rid_, txn);
+  std::vector<std::vector<IndexWriteRecord *>> batches;
+  for (auto item = index_write_set->rbegin(); item != index_write_set->rend(); ++item) {
+    auto batch = std::find_if(batches.begin(), batches.end(), [&item](const auto &batch) {
+      return batch.front()->catalog_ == item->catalog_ && batch.front()->index_oid_ == item->index_oid_;
+    });
+    if (batch == batches.end()) {
+      batch = batches.emplace(batches.end());
+    }
+    batch->push_back(&*item);
+  }
+  for (const auto &writes : batches) {
+    // Metadata identifying the index, looked up once for all of its changes.
+    Catalog *catalog = writes.front()->catalog_;
+    const Schema &schema = catalog->GetTable(writes.front()->table_oid_)->schema_;
+    Index *index = catalog->GetIndex(writes.front()->index_oid_)->index_.get();
+    const Schema &key_schema = *index->GetKeySchema();
+    const std::vector<uint32_t> &key_attrs = index->GetKeyAttrs();
+    for (auto *item : writes) {
+      auto new_key = item->tuple_.KeyFromTuple(schema, key_schema, key_attrs);
+      if (item->wtype_ == WType::DELETE) {
+        index->InsertEntry(new_key, item->rid_, txn);
+      } else if (item->wtype_ == WType::INSERT) {
+        index->DeleteEntry(new_key, item->rid_, txn);
+      } else if (item->wtype_ == WType::UPDATE) {
+        // Delete the new key and insert the old key
+        index->DeleteEntry(new_key, item->rid_, txn);
+        index->InsertEntry(item->old_tuple_.KeyFromTuple(schema, key_schema, key_attrs), item->rid_, txn);
+      }
     }
-    index_write_set->pop_back();
   }
-  table_write_set->clear();
   index_write_set->clear();
+}
 
-  // Release all the locks.
-  ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+lsn_t TransactionManager::LogTransactionRecord(Transaction *txn, LogRecordType type) {
+  if (!enable_logging || log_manager_ == nullptr) {
+    return INVALID_LSN;
+  }
+  LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), type);
+  lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+  if (type == LogRecordType::BEGIN) {
+    txn->SetBeginLSN(lsn);
+  }
+  txn->SetPrevLSN(lsn);
+  return lsn;
+}
+
+lsn_t TransactionManager::LogEndRecord(Transaction *txn, LogRecordType type) {
+  std::shared_lock lock(end_latch_);
+  lsn_t lsn = LogTransactionRecord(txn, type);
+  txn_registry.Remove(txn);
+  return lsn;
+}
+
+void TransactionManager::EndSnapshot(Transaction *txn) {
+  bool collect;
+  {
+    std::scoped_lock lock(ts_latch_);
+    if (HasSnapshot(txn)) {
+      active_snapshots_.erase(active_snapshots_.find(txn->GetReadTs()));
+    }
+    unversioned_writers_.erase(txn);
+    collect = ++finished_since_gc_ >= VERSION_GC_INTERVAL;
+  }
+  if (collect) {
+    GarbageCollect();
+  }
 }
 
-void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
+void TransactionManager::GarbageCollect() {
+  timestamp_t watermark;
+  {
+    std::scoped_lock lock(ts_latch_);
+    watermark = active_snapshots_.empty() ? last_commit_ts_ : *active_snapshots_.begin();
+    finished_since_gc_ = 0;
+  }
+  version_store_.GarbageCollect(watermark);
+}
 
-void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
+lsn_t TransactionManager::GetActiveTransactions(std::vector<std::pair<txn_id_t, lsn_t>> *active_txns) {
+  lsn_t oldest_begin_lsn = INVALID_LSN;
+  // A committed or aborted transaction is still active until its last record is appended, the registry holds
+  // exactly those.
+  std::unique_lock lock(end_latch_);
+  txn_registry.ForEach([active_txns, &oldest_begin_lsn](Transaction *txn) {
+    active_txns->emplace_back(txn->GetTransactionId(), txn->GetPrevLSN());
+    lsn_t begin_lsn = txn->GetBeginLSN();
+    if (begin_lsn != INVALID_LSN && (oldest_begin_lsn == INVALID_LSN || begin_lsn < oldest_begin_lsn)) {
+      oldest_begin_lsn = begin_lsn;
+    }
+  });
+  return oldest_begin_lsn;
+}
 
 }  // namespace bustub
@@ -0,0 +1,134 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+TransactionRegistry::~TransactionRegistry() {
+  for (auto &bucket : buckets_) {
+    Node *node = bucket.load();
+    while (node != nullptr) {
+      Node *next = node->next_.load();
+      delete node;
+      node = next;
+    }
+  }
+  for (auto &nodes : retired_) {
+    for (Node *node : nodes) {
+      delete node;
+    }
+  }
+}
+
+void TransactionRegistry::Insert(Transaction *txn) {
+  auto *node = new Node{txn->GetTransactionId(), txn};
+  size_t bucket = BucketOf(node->txn_id_);
+  std::scoped_lock lock(latches_[bucket % LATCH_COUNT]);
+  node->next_.store(buckets_[bucket].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  // Publish the node only once it is complete.
+  buckets_[bucket].store(node, std::memory_order_release);
+}
+
+void TransactionRegistry::Remove(Transaction *txn) {
+  size_t bucket = BucketOf(txn->GetTransactionId());
+  Node *node;
+  {
+    std::scoped_lock lock(latches_[bucket % LATCH_COUNT]);
+    std::atomic<Node *> *link = &buckets_[bucket];
+    node = link->load(std::memory_order_relaxed);
+    while (node != nullptr && node->txn_ != txn) {
+      link = &node->next_;
+      node = link->load(std::memory_order_relaxed);
+    }
+    if (node == nullptr) {
+      return;
+    }
+    // A lookup already past the link keeps following the node's next pointer, which stays valid.
+    link->store(node->next_.load(std::memory_order_relaxed), std::memory_order_release);
+  }
+  Retire(node);
+}
+
+Transaction *TransactionRegistry::Find(txn_id_t txn_id) {
+  uint64_t epoch = EnterEpoch();
+  Transaction *txn = nullptr;
+  for (Node *node = buckets_[BucketOf(txn_id)].load(std::memory_order_acquire); node != nullptr;
+       node = node->next_.load(std::memory_order_acquire)) {
+    if (node->txn_id_ == txn_id) {
+      txn = node->txn_;
+      break;
+    }
+  }
+  ExitEpoch(epoch);
+  return txn;
+}
+
+size_t TransactionRegistry::Size() {
+  uint64_t epoch = EnterEpoch();
+  size_t size = 0;
+  for (auto &bucket : buckets_) {
+    for (Node *node = bucket.load(std::memory_order_acquire); node != nullptr;
+         node = node->next_.load(std::memory_order_acquire)) {
+      size++;
+    }
+  }
+  ExitEpoch(epoch);
+  return size;
+}
+
+void TransactionRegistry::ForEach(const std::function<void(Transaction *)> &callback) {
+  for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+    std::scoped_lock lock(latches_[bucket % LATCH_COUNT]);
+    for (Node *node = buckets_[bucket].load(std::memory_order_relaxed); node != nullptr;
+         node = node->next_.load(std::memory_order_relaxed)) {
+      callback(node->txn_);
+    }
+  }
+}
+
+uint64_t TransactionRegistry::EnterEpoch() {
+  while (true) {
+    uint64_t epoch = epoch_.load();
+    readers_[epoch % EPOCH_COUNT].count_.fetch_add(1);
+    // Counted in an epoch that already ended, the nodes retired in it may be freed under us.
+    if (epoch_.load() == epoch) {
+      return epoch;
+    }
+    readers_[epoch % EPOCH_COUNT].count_.fetch_sub(1);
+  }
+}
+
+void TransactionRegistry::Retire(Node *node) {
+  std::scoped_lock lock(retire_latch_);
+  retired_[epoch_.load() % EPOCH_COUNT].push_back(node);
+  TryAdvanceEpoch();
+}
+
+void TransactionRegistry::TryAdvanceEpoch() {
+  uint64_t epoch = epoch_.load();
+  // (epoch + 2) % EPOCH_COUNT is the previous epoch.
+  size_t previous = (epoch + 2) % EPOCH_COUNT;
+  if (readers_[previous].count_.load() != 0) {
+    return;
+  }
+  epoch_.store(epoch + 1);
+  // Lookups now run in epoch or epoch + 1, both started after the previous epoch's nodes were unlinked.
+  for (Node *node : retired_[previous]) {
+    delete node;
+  }
+  retired_[previous].clear();
+}
+
+}  // namespace bustub
@@ -0,0 +1,204 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/concurrency/version_store.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/version_store.h"
+
+#include <mutex>  // NOLINT
+
+namespace bustub {
+
+void VersionStore::CheckWrite(Transaction *txn, const RID &rid) {
+  if (txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+    return;
+  }
+  VersionShard &shard = ShardOf(rid);
+  std::shared_lock lock(shard.latch_);
+  auto chain = shard.chains_.find(rid);
+  if (chain == shard.chains_.end() || chain->second.writer_ == txn->GetTransactionId()) {
+    return;
+  }
+  // The exclusive row lock keeps other writers out, an image newer than the snapshot has been committed.
+  if (chain->second.ts_ > txn->GetReadTs()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::WRITE_CONFLICT);
+  }
+}
+
+void VersionStore::RecordWrite(Transaction *txn, const RID &rid, const Tuple *old_tuple) {
+  if (!txn->IsVersioned()) {
+    return;
+  }
+  VersionShard &shard = ShardOf(rid);
+  std::unique_lock lock(shard.latch_);
+  auto &chain = shard.chains_[rid];
+  if (chain.writer_ == txn->GetTransactionId()) {
+    return;
+  }
+  // Another writer only remains while it rolls back an insert, the slot is free again and its undo image current.
+  if (chain.writer_ == INVALID_TXN_ID) {
+    chain.undo_.push_back({old_tuple != nullptr ? *old_tuple : Tuple{}, old_tuple != nullptr, chain.ts_});
+  }
+  chain.writer_ = txn->GetTransactionId();
+  txn->GetVersionWriteSet()->push_back(rid);
+}
+
+void VersionStore::RecordWriteSet(Transaction *txn) {
+  // The write set is oldest first, so the first write to each row records the image the transaction replaced.
+  for (auto &write : *txn->GetWriteSet()) {
+    if (write.wtype_ == WType::INSERT) {
+      RecordWrite(txn, write.rid_, nullptr);
+    } else if (write.tuple_.IsAllocated()) {
+      // A delete that found nothing to mark keeps no image, it did not change the row either.
+      RecordWrite(txn, write.rid_, &write.tuple_);
+    }
+  }
+}
+
+void VersionStore::GetVisibleVersions(Transaction *txn, const std::vector<RID> &rids, std::vector<Tuple> *tuples,
+                                      std::vector<bool> *exists) {
+  for (size_t i = 0; i < rids.size(); i++) {
+    VersionShard &shard = ShardOf(rids[i]);
+    std::shared_lock lock(shard.latch_);
+    auto chain = shard.chains_.find(rids[i]);
+    if (chain == shard.chains_.end()) {
+      continue;
+    }
+    const VersionChain &versions = chain->second;
+    if (versions.writer_ == txn->GetTransactionId() ||
+        (versions.writer_ == INVALID_TXN_ID && versions.ts_ <= txn->GetReadTs())) {
+      continue;
+    }
+    // Walk back to the newest image committed in the snapshot, rows created after it are not visible.
+    (*exists)[i] = false;
+    for (auto version = versions.undo_.rbegin(); version != versions.undo_.rend(); ++version) {
+      if (version->ts_ <= txn->GetReadTs()) {
+        (*exists)[i] = version->exists_;
+        (*tuples)[i] = version->tuple_;
+        (*tuples)[i].SetRid(rids[i]);
+        break;
+      }
+    }
+  }
+}
+
+bool VersionStore::ReadOptimistic(Transaction *txn, const RID &rid, Tuple *tuple) {
+  txn->GetReadVersionSet()->emplace(rid, GetVersion(txn, rid));
+  auto write = txn->GetBufferedWriteSet()->find(rid);
+  if (write == txn->GetBufferedWriteSet()->end()) {
+    return true;
+  }
+  if (write->second.wtype_ == WType::DELETE) {
+    return false;
+  }
+  // The rid may be the tuple's own, copy it before the tuple is replaced.
+  RID tuple_rid = rid;
+  *tuple = write->second.tuple_;
+  tuple->SetRid(tuple_rid);
+  return true;
+}
+
+bool VersionStore::Validate(Transaction *txn) {
+  for (const auto &[rid, version] : *txn->GetReadVersionSet()) {
+    // A row read while another transaction was writing it is never valid, the image may have been rolled back.
+    if (version == INVALID_TS || GetVersion(txn, rid) != version) {
+      return false;
+    }
+  }
+  return true;
+}
+
+timestamp_t VersionStore::GetVersion(Transaction *txn, const RID &rid) {
+  VersionShard &shard = ShardOf(rid);
+  std::shared_lock lock(shard.latch_);
+  auto chain = shard.chains_.find(rid);
+  if (chain == shard.chains_.end()) {
+    return 0;
+  }
+  if (chain->second.writer_ != INVALID_TXN_ID && chain->second.writer_ != txn->GetTransactionId()) {
+    return INVALID_TS;
+  }
+  // Images older than the transaction all look the same, so that collecting their chains does not change them.
+  return chain->second.ts_ > txn->GetReadTs() ? chain->second.ts_ : 0;
+}
+
+void VersionStore::Commit(Transaction *txn, timestamp_t commit_ts) {
+  auto writes = txn->GetVersionWriteSet();
+  for (const auto &rid : *writes) {
+    VersionShard &shard = ShardOf(rid);
+    std::unique_lock lock(shard.latch_);
+    auto &chain = shard.chains_[rid];
+    chain.writer_ = INVALID_TXN_ID;
+    chain.ts_ = commit_ts;
+  }
+  writes->clear();
+}
+
+void VersionStore::Abort(Transaction *txn) {
+  auto writes = txn->GetVersionWriteSet();
+  // The heap has been rolled back to the image recorded on the first write, so that image is current again.
+  for (const auto &rid : *writes) {
+    VersionShard &shard = ShardOf(rid);
+    std::unique_lock lock(shard.latch_);
+    auto chain = shard.chains_.find(rid);
+    if (chain == shard.chains_.end() || chain->second.writer_ != txn->GetTransactionId()) {
+      continue;
+    }
+    chain->second.writer_ = INVALID_TXN_ID;
+    chain->second.undo_.pop_back();
+    if (chain->second.undo_.empty()) {
+      shard.chains_.erase(chain);
+    }
+  }
+  writes->clear();
+}
+
+void VersionStore::GarbageCollect(timestamp_t watermark) {
+  // One shard at a time, writers to the other shards go on meanwhile.
+  for (auto &shard : shards_) {
+    std::unique_lock lock(shard.latch_);
+    for (auto chain = shard.chains_.begin(); chain != shard.chains_.end();) {
+      auto &undo = chain->second.undo_;
+      // An image is still needed while the image that replaced it is not visible to every snapshot.
+      size_t dropped = 0;
+      while (dropped < undo.size()) {
+        bool last = dropped + 1 == undo.size();
+        if (last && chain->second.writer_ != INVALID_TXN_ID) {
+          break;
+        }
+        timestamp_t replaced_at = last ? chain->second.ts_ : undo[dropped + 1].ts_;
+        if (replaced_at > watermark) {
+          break;
+        }
+        dropped++;
+      }
+      undo.erase(undo.begin(), undo.begin() + dropped);
+      if (undo.empty()) {
+        chain = shard.chains_.erase(chain);
+      } else {
+        ++chain;
+      }
+    }
+  }
+}
+
+size_t VersionStore::GetVersionCount() {
+  size_t count = 0;
+  for (auto &shard : shards_) {
+    std::shared_lock lock(shard.latch_);
+    for (const auto &[rid, chain] : shard.chains_) {
+      count += chain.undo_.size();
+    }
+  }
+  return count;
+}
+
+}  // namespace bustub
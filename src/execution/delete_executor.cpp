@@ -18,51 +18,57 @@ namespace bustub {
 
 DeleteExecutor::DeleteExecutor(ExecutorContext *exec_ctx, const DeletePlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)) {}
+    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)), table_info_(nullptr) {}
 
 void DeleteExecutor::Init() {
   if (child_executor_ != nullptr) {
     child_executor_->Init();
   }
+  table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->TableOid());
+  index_batch_ = std::make_unique<IndexWriteBatch>(exec_ctx_->GetCatalog(), table_info_);
 }
 
 bool DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
-  auto table_info = exec_ctx_->GetCatalog()->GetTable(plan_->TableOid());
-  auto table_heap = table_info->table_.get();
+  auto table_heap = table_info_->table_.get();
   Transaction *transaction = GetExecutorContext()->GetTransaction();
   LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
   Tuple del_tuple;
   RID del_rid;
+  std::vector<RID> unlock_rids;
 
   /* 如何找到需要删除的tuple：根据 DeletePlanNode->SeqScanPlanNode */
   // child_executor_会指向一个查询器（SeqScanExecutor）
   // del_tuple和del_rid的值会从查询器的Next()函数返回
   while (child_executor_->Next(&del_tuple, &del_rid)) {
+    if (transaction->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+      // 乐观事务不加锁，删除连同索引变更缓存到提交时再标记；先更新过的行，索引里还是更新前的旧值
+      auto buffered_write_set = transaction->GetBufferedWriteSet();
+      auto write = buffered_write_set->find(del_rid);
+      Tuple index_tuple = write == buffered_write_set->end() ? del_tuple : write->second.old_tuple_;
+      buffered_write_set->insert_or_assign(
+          del_rid, BufferedWriteRecord(table_info_->oid_, WType::DELETE, index_tuple, Tuple{}, table_heap,
+                                       exec_ctx_->GetCatalog()));
+      continue;
+    }
     // 加锁
     if (lock_mgr != nullptr) {
-      if (transaction->IsSharedLocked(del_rid)) {
-        lock_mgr->LockUpgrade(transaction, del_rid);
-      } else if (!transaction->IsExclusiveLocked(del_rid)) {
-        lock_mgr->LockExclusive(transaction, del_rid);
-      }
+      lock_mgr->LockExclusive(transaction, table_info_->oid_, del_rid);
     }
     // 调用TableHeap标记删除状态
     table_heap->MarkDelete(del_rid, exec_ctx_->GetTransaction());
-    // 更新索引
-    auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info->name_);
-    for (const auto &index : indexes) {
-      auto key_tuple =
-          del_tuple.KeyFromTuple(table_info->schema_, *index->index_->GetKeySchema(), index->index_->GetKeyAttrs());
-      index->index_->DeleteEntry(key_tuple, del_rid, exec_ctx_->GetTransaction());
-      // 在事务中记录下变更
-      transaction->GetIndexWriteSet()->emplace_back(IndexWriteRecord(
-          del_rid, table_info->oid_, WType::DELETE, del_tuple, index->index_oid_, exec_ctx_->GetCatalog()));
-    }
-    // 解锁
-    if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr) {
-      lock_mgr->Unlock(transaction, del_rid);
+    // 记录索引变更，语句结束时统一写入
+    index_batch_->Delete(del_tuple, del_rid);
+    // 解锁（推迟到索引更新之后）
+    if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr &&
+        transaction->IsExclusiveLocked(del_rid)) {
+      unlock_rids.emplace_back(del_rid);
     }
   }
+  // 批量更新索引，之后再解锁
+  index_batch_->Apply(transaction, lock_mgr);
+  for (const auto &unlock_rid : unlock_rids) {
+    lock_mgr->Unlock(transaction, unlock_rid);
+  }
   return false;
 }
 
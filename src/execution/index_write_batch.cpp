@@ -0,0 +1,139 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// index_write_batch.cpp
+//
+// Identification: src/execution/index_write_batch.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/index_write_batch.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace bustub {
+
+IndexWriteBatch::IndexWriteBatch(Catalog *catalog, const TableInfo *table_info)
+    : catalog_(catalog), table_info_(table_info) {
+  for (auto *index_info : catalog_->GetTableIndexes(table_info_->name_)) {
+    indexes_.emplace_back(index_info);
+  }
+}
+
+void IndexWriteBatch::Insert(const Tuple &tuple, RID rid) {
+  for (auto &pending : indexes_) {
+    pending.records_.emplace_back(rid, table_info_->oid_, WType::INSERT, tuple, pending.index_info_->index_oid_,
+                                  catalog_);
+  }
+}
+
+void IndexWriteBatch::Delete(const Tuple &tuple, RID rid) {
+  for (auto &pending : indexes_) {
+    pending.records_.emplace_back(rid, table_info_->oid_, WType::DELETE, tuple, pending.index_info_->index_oid_,
+                                  catalog_);
+  }
+}
+
+void IndexWriteBatch::Update(const Tuple &old_tuple, const Tuple &new_tuple, RID rid) {
+  for (auto &pending : indexes_) {
+    if (!KeyChanged(old_tuple, new_tuple, pending.index_info_)) {
+      continue;
+    }
+    auto &record = pending.records_.emplace_back(rid, table_info_->oid_, WType::UPDATE, new_tuple,
+                                                 pending.index_info_->index_oid_, catalog_);
+    record.old_tuple_ = old_tuple;
+  }
+}
+
+void IndexWriteBatch::Apply(Transaction *txn, LockManager *lock_mgr) {
+  for (auto &pending : indexes_) {
+    if (pending.records_.empty()) {
+      continue;
+    }
+    auto *index_info = pending.index_info_;
+
+    // Split the records into the keys to remove and the keys to add.
+    std::vector<IndexEntry> deletes;
+    std::vector<IndexEntry> inserts;
+    for (auto &record : pending.records_) {
+      switch (record.wtype_) {
+        case WType::INSERT:
+          inserts.emplace_back(KeyOf(&record.tuple_, index_info), record.rid_);
+          break;
+        case WType::DELETE:
+          deletes.emplace_back(KeyOf(&record.tuple_, index_info), record.rid_);
+          break;
+        case WType::UPDATE:
+          deletes.emplace_back(KeyOf(&record.old_tuple_, index_info), record.rid_);
+          inserts.emplace_back(KeyOf(&record.tuple_, index_info), record.rid_);
+          break;
+      }
+    }
+
+    // Apply the changes in key order, so that neighbouring keys are handled back to back.
+    const Schema *key_schema = index_info->index_->GetKeySchema();
+    auto delete_order = SortedOrder(deletes, key_schema);
+    auto insert_order = SortedOrder(inserts, key_schema);
+    // Lock every key first: an abort while locking leaves the index untouched by this batch.
+    if (lock_mgr != nullptr) {
+      for (auto idx : delete_order) {
+        lock_mgr->LockKeyExclusive(txn, index_info->index_oid_, deletes[idx].first);
+      }
+      for (auto idx : insert_order) {
+        lock_mgr->LockKeyExclusive(txn, index_info->index_oid_, inserts[idx].first);
+      }
+    }
+    for (auto idx : delete_order) {
+      index_info->index_->DeleteEntry(deletes[idx].first, deletes[idx].second, txn);
+    }
+    for (auto idx : insert_order) {
+      index_info->index_->InsertEntry(inserts[idx].first, inserts[idx].second, txn);
+    }
+
+    auto index_write_set = txn->GetIndexWriteSet();
+    index_write_set->insert(index_write_set->end(), pending.records_.begin(), pending.records_.end());
+    pending.records_.clear();
+  }
+}
+
+bool IndexWriteBatch::KeyChanged(const Tuple &old_tuple, const Tuple &new_tuple, const IndexInfo *index_info) const {
+  const Schema *schema = &table_info_->schema_;
+  for (auto attr : index_info->index_->GetKeyAttrs()) {
+    if (old_tuple.GetValue(schema, attr).CompareNotEquals(new_tuple.GetValue(schema, attr)) == CmpBool::CmpTrue) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Tuple IndexWriteBatch::KeyOf(Tuple *tuple, const IndexInfo *index_info) const {
+  return tuple->KeyFromTuple(table_info_->schema_, *index_info->index_->GetKeySchema(),
+                             index_info->index_->GetKeyAttrs());
+}
+
+std::vector<size_t> IndexWriteBatch::SortedOrder(const std::vector<IndexEntry> &entries, const Schema *key_schema) {
+  // Sort positions rather than the entries themselves, tuples are expensive to copy.
+  std::vector<size_t> order(entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  const uint32_t column_count = key_schema->GetColumnCount();
+  std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    for (uint32_t i = 0; i < column_count; i++) {
+      Value lhs_value = entries[lhs].first.GetValue(key_schema, i);
+      Value rhs_value = entries[rhs].first.GetValue(key_schema, i);
+      if (lhs_value.CompareLessThan(rhs_value) == CmpBool::CmpTrue) {
+        return true;
+      }
+      if (lhs_value.CompareGreaterThan(rhs_value) == CmpBool::CmpTrue) {
+        return false;
+      }
+    }
+    return false;
+  });
+  return order;
+}
+
+}  // namespace bustub
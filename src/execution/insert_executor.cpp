@@ -27,6 +27,9 @@ void InsertExecutor::Init() {
   if (child_executor_ != nullptr) {
     child_executor_->Init();
   }
+  // 索引只在Init中解析一次
+  index_batch_ = std::make_unique<IndexWriteBatch>(exec_ctx_->GetCatalog(), table_info_);
+  unlock_rids_.clear();
 }
 
 bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
@@ -45,6 +48,13 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
       InsertIntoTableWithIndex(&insert_tuple);
     }
   }
+  // 批量更新索引，之后再解锁
+  LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
+  index_batch_->Apply(exec_ctx_->GetTransaction(), lock_mgr);
+  for (const auto &unlock_rid : unlock_rids_) {
+    lock_mgr->Unlock(exec_ctx_->GetTransaction(), unlock_rid);
+  }
+  unlock_rids_.clear();
   return false;
 }
 
@@ -56,25 +66,14 @@ void InsertExecutor::InsertIntoTableWithIndex(Tuple *tuple) {
   Transaction *transaction = GetExecutorContext()->GetTransaction();
   LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
   if (lock_mgr != nullptr) {
-    if (transaction->IsSharedLocked(cur_rid)) {
-      lock_mgr->LockUpgrade(transaction, cur_rid);
-    } else if (!transaction->IsExclusiveLocked(cur_rid)) {
-      lock_mgr->LockExclusive(transaction, cur_rid);
-    }
-  }
-  // 更新索引
-  auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
-  for (const auto &index : indexes) {
-    auto key_tuple =
-        tuple->KeyFromTuple(table_info_->schema_, *index->index_->GetKeySchema(), index->index_->GetKeyAttrs());
-    index->index_->InsertEntry(key_tuple, cur_rid, exec_ctx_->GetTransaction());
-    // 在事务中记录下变更
-    transaction->GetIndexWriteSet()->emplace_back(IndexWriteRecord(
-        cur_rid, table_info_->oid_, WType::INSERT, *tuple, index->index_oid_, exec_ctx_->GetCatalog()));
+    lock_mgr->LockExclusive(transaction, table_info_->oid_, cur_rid);
   }
-  // 解锁
-  if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr) {
-    lock_mgr->Unlock(transaction, cur_rid);
+  // 记录索引变更，语句结束时统一写入
+  index_batch_->Insert(*tuple, cur_rid);
+  // 解锁（推迟到索引更新之后）
+  if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr &&
+      transaction->IsExclusiveLocked(cur_rid)) {
+    unlock_rids_.emplace_back(cur_rid);
   }
 }
 
@@ -16,10 +16,88 @@ namespace bustub {
 
 NestIndexJoinExecutor::NestIndexJoinExecutor(ExecutorContext *exec_ctx, const NestedIndexJoinPlanNode *plan,
                                              std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(std::move(child_executor)),
+      inner_table_info_(nullptr),
+      index_info_(nullptr) {}
 
-void NestIndexJoinExecutor::Init() {}
+void NestIndexJoinExecutor::Init() {
+  buffer_.clear();
+  Catalog *catalog = exec_ctx_->GetCatalog();
+  inner_table_info_ = catalog->GetTable(plan_->GetInnerTableOid());
+  index_info_ = catalog->GetIndex(plan_->GetIndexName(), inner_table_info_->name_);
+  child_executor_->Init();
+}
 
-bool NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) { return false; }
+bool NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) {
+  // 当前外表行的连接结果取完了，再取下一个外表行去探索引
+  Tuple outer_tuple;
+  RID outer_rid;
+  while (buffer_.empty()) {
+    if (!child_executor_->Next(&outer_tuple, &outer_rid)) {
+      return false;
+    }
+    ProbeInner(outer_tuple);
+  }
+  *tuple = buffer_.back();
+  buffer_.pop_back();
+  *rid = tuple->GetRid();
+  return true;
+}
+
+void NestIndexJoinExecutor::ProbeInner(const Tuple &outer_tuple) {
+  const Schema *out_schema = this->GetOutputSchema();
+  const Schema *outer_schema = child_executor_->GetOutputSchema();
+  const Schema *inner_schema = &inner_table_info_->schema_;
+  LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  IsolationLevel isolation = txn->GetIsolationLevel();
+
+  // 连接条件左侧是外表的列，用它的值构造要探的键
+  Value key_value = plan_->Predicate()->GetChildAt(0)->Evaluate(&outer_tuple, outer_schema);
+  Tuple key({key_value}, index_info_->index_->GetKeySchema());
+
+  // SERIALIZABLE先锁住键再探，即使没有匹配的行，别的事务也插不进这个键，避免幻读
+  if (lock_mgr != nullptr && isolation == IsolationLevel::SERIALIZABLE) {
+    lock_mgr->LockKeyShared(txn, index_info_->index_oid_, key);
+  }
+  std::vector<RID> inner_rids;
+  index_info_->index_->ScanKey(key, &inner_rids, txn);
+
+  for (const auto &inner_rid : inner_rids) {
+    // 乐观事务自己删掉的行跳过
+    if (isolation == IsolationLevel::OPTIMISTIC) {
+      auto write = txn->GetBufferedWriteSet()->find(inner_rid);
+      if (write != txn->GetBufferedWriteSet()->end() && write->second.wtype_ == WType::DELETE) {
+        continue;
+      }
+    }
+
+    // 加锁，和顺序扫描一样，READ_COMMITTED读完即放
+    if (lock_mgr != nullptr && isolation != IsolationLevel::READ_UNCOMMITTED &&
+        isolation != IsolationLevel::OPTIMISTIC && isolation != IsolationLevel::SNAPSHOT_ISOLATION) {
+      lock_mgr->LockShared(txn, inner_table_info_->oid_, inner_rid);
+    }
+    Tuple inner_tuple;
+    bool found = inner_table_info_->table_->GetTuple(inner_rid, &inner_tuple, txn);
+    if (isolation == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr && txn->IsSharedLocked(inner_rid)) {
+      lock_mgr->Unlock(txn, inner_rid);
+    }
+    if (!found) {
+      continue;
+    }
+
+    // 连接条件不一定只比较索引键，再完整地求一遍
+    if (!plan_->Predicate()->EvaluateJoin(&outer_tuple, outer_schema, &inner_tuple, inner_schema).GetAs<bool>()) {
+      continue;
+    }
+    std::vector<Value> res;
+    for (const auto &col : out_schema->GetColumns()) {
+      res.emplace_back(col.GetExpr()->EvaluateJoin(&outer_tuple, outer_schema, &inner_tuple, inner_schema));
+    }
+    buffer_.emplace_back(Tuple(res, out_schema));
+  }
+}
 
 }  // namespace bustub
@@ -0,0 +1,66 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// pipeline.cpp
+//
+// Identification: src/execution/pipeline/pipeline.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/pipeline/pipeline.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+bool Pipeline::IsReady() const {
+  return std::all_of(dependencies_.begin(), dependencies_.end(),
+                     [](const Pipeline *dependency) { return dependency->IsFinished(); });
+}
+
+bool Pipeline::Run(const std::function<void()> &resume) {
+  BUSTUB_ASSERT(sink_ != nullptr, "A pipeline needs a sink before it can run.");
+  if (!started_) {
+    source_->Init();
+    for (auto &op : operators_) {
+      op->Init();
+    }
+    sink_->Init();
+    started_ = true;
+  }
+
+  // Two batches are enough: each operator reads one and writes the other.
+  TupleBatch batch;
+  TupleBatch scratch;
+  while (!stopped_) {
+    if (!source_->Next(&batch)) {
+      // Suspending must be the last thing Run() does, resume may already run Run() again on another thread.
+      if (source_->Suspend(std::function<void()>(resume))) {
+        return false;
+      }
+      break;
+    }
+    TupleBatch *current = &batch;
+    TupleBatch *next = &scratch;
+    for (auto &op : operators_) {
+      next->Clear();
+      stopped_ = !op->Execute(*current, next) || stopped_;
+      std::swap(current, next);
+      if (current->IsEmpty()) {
+        break;
+      }
+    }
+    if (!current->IsEmpty()) {
+      stopped_ = !sink_->Sink(*current) || stopped_;
+    }
+  }
+
+  sink_->Finalize();
+  finished_ = true;
+  return true;
+}
+
+}  // namespace bustub
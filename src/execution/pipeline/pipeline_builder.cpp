@@ -0,0 +1,118 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// pipeline_builder.cpp
+//
+// Identification: src/execution/pipeline/pipeline_builder.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/pipeline/pipeline_builder.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "execution/expressions/column_value_expression.h"
+
+namespace bustub {
+
+std::vector<std::unique_ptr<Pipeline>> PipelineBuilder::Build(const AbstractPlanNode *plan,
+                                                               std::vector<Tuple> *result_set) {
+  pipelines_.clear();
+  Pipeline *root = BuildPipeline(plan);
+  root->SetSink(std::make_unique<ResultSink>(result_set));
+  return std::move(pipelines_);
+}
+
+Pipeline *PipelineBuilder::BuildPipeline(const AbstractPlanNode *plan) {
+  switch (plan->GetType()) {
+    case PlanType::SeqScan: {
+      auto scan_plan = dynamic_cast<const SeqScanPlanNode *>(plan);
+      return NewPipeline(std::make_unique<SeqScanSource>(exec_ctx_, scan_plan, page_reader_));
+    }
+
+    case PlanType::HashJoin: {
+      auto join_plan = dynamic_cast<const HashJoinPlanNode *>(plan);
+      auto state = std::make_shared<HashJoinState>();
+      Pipeline *build = BuildPipeline(join_plan->GetLeftPlan());
+      build->SetSink(std::make_unique<HashJoinBuildSink>(join_plan, state));
+      Pipeline *probe = late_materialization_ ? BuildLateMaterializedProbe(join_plan, state) : nullptr;
+      if (probe == nullptr) {
+        probe = BuildPipeline(join_plan->GetRightPlan());
+      }
+      probe->AddOperator(std::make_unique<HashJoinProbeOperator>(join_plan, state));
+      probe->AddDependency(build);
+      return probe;
+    }
+
+    case PlanType::Aggregation: {
+      auto agg_plan = dynamic_cast<const AggregationPlanNode *>(plan);
+      auto state = std::make_shared<AggregationState>(agg_plan);
+      Pipeline *input = BuildPipeline(agg_plan->GetChildPlan());
+      input->SetSink(std::make_unique<AggregationSink>(agg_plan, state));
+      Pipeline *output = NewPipeline(std::make_unique<AggregationSource>(agg_plan, state));
+      output->AddDependency(input);
+      return output;
+    }
+
+    case PlanType::Distinct: {
+      auto distinct_plan = dynamic_cast<const DistinctPlanNode *>(plan);
+      Pipeline *pipeline = BuildPipeline(distinct_plan->GetChildPlan());
+      pipeline->AddOperator(std::make_unique<DistinctOperator>(distinct_plan));
+      return pipeline;
+    }
+
+    case PlanType::Limit: {
+      auto limit_plan = dynamic_cast<const LimitPlanNode *>(plan);
+      Pipeline *pipeline = BuildPipeline(limit_plan->GetChildPlan());
+      pipeline->AddOperator(std::make_unique<LimitOperator>(limit_plan));
+      return pipeline;
+    }
+
+    default:
+      return NewPipeline(std::make_unique<ExecutorSource>(exec_ctx_, plan));
+  }
+}
+
+Pipeline *PipelineBuilder::BuildLateMaterializedProbe(const HashJoinPlanNode *join_plan,
+                                                      const std::shared_ptr<HashJoinState> &state) {
+  if (join_plan->GetRightPlan()->GetType() != PlanType::SeqScan) {
+    return nullptr;
+  }
+  auto scan_plan = dynamic_cast<const SeqScanPlanNode *>(join_plan->GetRightPlan());
+  std::vector<bool> required(scan_plan->OutputSchema()->GetColumnCount(), false);
+  CollectColumns(scan_plan->GetPredicate(), &required);
+  CollectColumns(join_plan->RightJoinKeyExpression(), &required);
+  if (std::all_of(required.begin(), required.end(), [](bool column) { return column; })) {
+    return nullptr;
+  }
+
+  auto source = std::make_unique<SeqScanSource>(exec_ctx_, scan_plan, page_reader_);
+  source->SetRequiredColumns(std::move(required));
+  Pipeline *probe = NewPipeline(std::move(source));
+  probe->AddOperator(std::make_unique<HashJoinFilterOperator>(join_plan, state));
+  probe->AddOperator(std::make_unique<MaterializeOperator>(exec_ctx_, scan_plan));
+  return probe;
+}
+
+void PipelineBuilder::CollectColumns(const AbstractExpression *expr, std::vector<bool> *required) {
+  if (expr == nullptr) {
+    return;
+  }
+  if (auto column = dynamic_cast<const ColumnValueExpression *>(expr); column != nullptr) {
+    (*required)[column->GetColIdx()] = true;
+  }
+  for (const auto *child : expr->GetChildren()) {
+    CollectColumns(child, required);
+  }
+}
+
+Pipeline *PipelineBuilder::NewPipeline(std::unique_ptr<PipelineSource> &&source) {
+  pipelines_.emplace_back(std::make_unique<Pipeline>(std::move(source)));
+  return pipelines_.back().get();
+}
+
+}  // namespace bustub
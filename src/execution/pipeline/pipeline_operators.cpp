@@ -0,0 +1,361 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// pipeline_operators.cpp
+//
+// Identification: src/execution/pipeline/pipeline_operators.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/pipeline/pipeline_operators.h"
+
+#include <utility>
+
+#include "concurrency/lock_manager.h"
+#include "concurrency/version_store.h"
+#include "execution/executor_factory.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+SeqScanSource::SeqScanSource(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan, AsyncPageReader *page_reader)
+    : exec_ctx_(exec_ctx), plan_(plan), page_reader_(page_reader) {}
+
+void SeqScanSource::Init() {
+  table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->GetTableOid());
+  page_tuples_.clear();
+  page_pos_ = 0;
+  next_page_id_ = table_info_->table_->GetFirstPageId();
+  waiting_ = false;
+  if (page_reader_ != nullptr) {
+    page_reader_->Prefetch(next_page_id_);
+  }
+  // Like SeqScanExecutor: one table lock instead of row locks under REPEATABLE_READ and SERIALIZABLE, none under
+  // SNAPSHOT_ISOLATION.
+  LockManager *lock_mgr = exec_ctx_->GetLockManager();
+  Transaction *txn = exec_ctx_->GetTransaction();
+  if (lock_mgr != nullptr && (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+                              txn->GetIsolationLevel() == IsolationLevel::SERIALIZABLE)) {
+    lock_mgr->LockTable(txn, table_info_->oid_, TableLockMode::SHARED);
+  } else if (lock_mgr != nullptr && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+    lock_mgr->LockTable(txn, table_info_->oid_, TableLockMode::INTENTION_SHARED);
+  }
+}
+
+bool SeqScanSource::Next(TupleBatch *batch) {
+  batch->Clear();
+  const Schema *out_schema = plan_->OutputSchema();
+  const AbstractExpression *predicate = plan_->GetPredicate();
+  LockManager *lock_mgr = exec_ctx_->GetLockManager();
+  Transaction *txn = exec_ctx_->GetTransaction();
+
+  while (!batch->IsFull()) {
+    if (page_pos_ == page_tuples_.size()) {
+      if (next_page_id_ == INVALID_PAGE_ID || !LoadNextPage()) {
+        break;
+      }
+      continue;
+    }
+    const Tuple &row = page_tuples_[page_pos_++];
+    RID rid = row.GetRid();
+    if (lock_mgr != nullptr && txn->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED &&
+        txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION &&
+        txn->GetIsolationLevel() != IsolationLevel::OPTIMISTIC) {
+      lock_mgr->LockShared(txn, table_info_->oid_, rid);
+    }
+
+    std::vector<Value> values;
+    values.reserve(out_schema->GetColumnCount());
+    for (uint32_t i = 0; i < out_schema->GetColumnCount(); i++) {
+      const Column &col = out_schema->GetColumn(i);
+      if (required_.empty() || required_[i]) {
+        values.emplace_back(col.GetExpr()->Evaluate(&row, &table_info_->schema_));
+      } else {
+        values.emplace_back(ValueFactory::GetNullValueByType(col.GetType()));
+      }
+    }
+
+    if (lock_mgr != nullptr && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && txn->IsSharedLocked(rid)) {
+      lock_mgr->Unlock(txn, rid);
+    }
+
+    Tuple tuple(values, out_schema);
+    if (predicate == nullptr || predicate->Evaluate(&tuple, out_schema).GetAs<bool>()) {
+      batch->Append(tuple, rid);
+    }
+  }
+  return !batch->IsEmpty();
+}
+
+bool SeqScanSource::Suspend(std::function<void()> &&resume) {
+  if (!waiting_) {
+    return false;
+  }
+  waiting_ = false;
+  page_reader_->WhenReady(next_page_id_, std::move(resume));
+  return true;
+}
+
+bool SeqScanSource::LoadNextPage() {
+  if (page_reader_ != nullptr && !page_reader_->IsReady(next_page_id_)) {
+    waiting_ = true;
+    return false;
+  }
+  // The page may have become ready before the pipeline got to suspend on it.
+  waiting_ = false;
+
+  Transaction *txn = exec_ctx_->GetTransaction();
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    page_pos_ = 0;
+    next_page_id_ = table_info_->table_->GetSnapshotPage(next_page_id_, &page_tuples_, txn);
+    if (page_reader_ != nullptr) {
+      page_reader_->Prefetch(next_page_id_);
+    }
+    return true;
+  }
+
+  BufferPoolManager *bpm = exec_ctx_->GetBufferPoolManager();
+  auto page = static_cast<TablePage *>(bpm->FetchPage(next_page_id_));
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "SeqScanSource: no free frame for the next table page.");
+  }
+  page_tuples_.clear();
+  page_pos_ = 0;
+  page->RLatch();
+  RID rid;
+  for (bool found = page->GetFirstTupleRid(&rid); found;) {
+    Tuple tuple;
+    bool visible = page->GetTuple(rid, &tuple, txn, exec_ctx_->GetLockManager());
+    if (visible && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+      visible = txn->GetVersionStore()->ReadOptimistic(txn, rid, &tuple);
+    }
+    if (visible) {
+      page_tuples_.push_back(tuple);
+    }
+    RID next_rid;
+    found = page->GetNextTupleRid(rid, &next_rid);
+    rid = next_rid;
+  }
+  page_id_t page_id = next_page_id_;
+  next_page_id_ = page->GetNextPageId();
+  page->RUnlatch();
+  bpm->UnpinPage(page_id, false);
+
+  // Overlap the read of the following page with the processing of this one.
+  if (page_reader_ != nullptr) {
+    page_reader_->Prefetch(next_page_id_);
+  }
+  return true;
+}
+
+MaterializeOperator::MaterializeOperator(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan)
+    : exec_ctx_(exec_ctx), plan_(plan) {}
+
+void MaterializeOperator::Init() { table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->GetTableOid()); }
+
+bool MaterializeOperator::Execute(const TupleBatch &input, TupleBatch *output) {
+  const Schema *out_schema = plan_->OutputSchema();
+  LockManager *lock_mgr = exec_ctx_->GetLockManager();
+  Transaction *txn = exec_ctx_->GetTransaction();
+  // Under READ_COMMITTED the scan has already released its locks, take them again for the re-read.
+  bool relock = lock_mgr != nullptr && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED;
+
+  std::vector<RID> rids;
+  rids.reserve(input.Size());
+  for (size_t i = 0; i < input.Size(); i++) {
+    rids.push_back(input.GetRid(i));
+    if (relock) {
+      lock_mgr->LockShared(txn, table_info_->oid_, rids.back());
+    }
+  }
+
+  std::vector<Tuple> rows;
+  std::vector<bool> found;
+  table_info_->table_->GetTuples(rids, &rows, &found, txn);
+  // The chains explain any image written since the scan, so the re-read sees the same snapshot.
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    txn->GetVersionStore()->GetVisibleVersions(txn, rids, &rows, &found);
+  }
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (relock && txn->IsSharedLocked(rids[i])) {
+      lock_mgr->Unlock(txn, rids[i]);
+    }
+    // A row deleted since it was scanned is dropped.
+    if (!found[i]) {
+      continue;
+    }
+    std::vector<Value> values;
+    values.reserve(out_schema->GetColumnCount());
+    for (const auto &col : out_schema->GetColumns()) {
+      values.emplace_back(col.GetExpr()->Evaluate(&rows[i], &table_info_->schema_));
+    }
+    output->Append(Tuple(values, out_schema), rids[i]);
+  }
+  return true;
+}
+
+ExecutorSource::ExecutorSource(ExecutorContext *exec_ctx, const AbstractPlanNode *plan)
+    : exec_ctx_(exec_ctx), plan_(plan) {}
+
+void ExecutorSource::Init() {
+  executor_ = ExecutorFactory::CreateExecutor(exec_ctx_, plan_);
+  executor_->Init();
+  exhausted_ = false;
+}
+
+bool ExecutorSource::Next(TupleBatch *batch) {
+  batch->Clear();
+  Tuple tuple;
+  RID rid;
+  while (!exhausted_ && !batch->IsFull()) {
+    if (!executor_->Next(&tuple, &rid)) {
+      exhausted_ = true;
+      break;
+    }
+    batch->Append(tuple, rid);
+  }
+  return !batch->IsEmpty();
+}
+
+HashJoinBuildSink::HashJoinBuildSink(const HashJoinPlanNode *plan, std::shared_ptr<HashJoinState> state)
+    : plan_(plan), state_(std::move(state)) {}
+
+bool HashJoinBuildSink::Sink(const TupleBatch &batch) {
+  const Schema *left_schema = plan_->GetLeftPlan()->OutputSchema();
+  for (size_t i = 0; i < batch.Size(); i++) {
+    HashJoinKey key;
+    key.column_value_ = plan_->LeftJoinKeyExpression()->Evaluate(&batch.GetTuple(i), left_schema);
+    state_->ht_[key].push_back(batch.GetTuple(i));
+  }
+  return true;
+}
+
+HashJoinFilterOperator::HashJoinFilterOperator(const HashJoinPlanNode *plan, std::shared_ptr<HashJoinState> state)
+    : plan_(plan), state_(std::move(state)) {}
+
+bool HashJoinFilterOperator::Execute(const TupleBatch &input, TupleBatch *output) {
+  const Schema *right_schema = plan_->GetRightPlan()->OutputSchema();
+  for (size_t i = 0; i < input.Size(); i++) {
+    HashJoinKey key;
+    key.column_value_ = plan_->RightJoinKeyExpression()->Evaluate(&input.GetTuple(i), right_schema);
+    if (state_->ht_.count(key) != 0) {
+      output->Append(input.GetTuple(i), input.GetRid(i));
+    }
+  }
+  return true;
+}
+
+HashJoinProbeOperator::HashJoinProbeOperator(const HashJoinPlanNode *plan, std::shared_ptr<HashJoinState> state)
+    : plan_(plan), state_(std::move(state)) {}
+
+bool HashJoinProbeOperator::Execute(const TupleBatch &input, TupleBatch *output) {
+  const Schema *left_schema = plan_->GetLeftPlan()->OutputSchema();
+  const Schema *right_schema = plan_->GetRightPlan()->OutputSchema();
+  const Schema *out_schema = plan_->OutputSchema();
+  for (size_t i = 0; i < input.Size(); i++) {
+    const Tuple &right_tuple = input.GetTuple(i);
+    HashJoinKey key;
+    key.column_value_ = plan_->RightJoinKeyExpression()->Evaluate(&right_tuple, right_schema);
+    auto bucket = state_->ht_.find(key);
+    if (bucket == state_->ht_.end()) {
+      continue;
+    }
+    for (const auto &left_tuple : bucket->second) {
+      std::vector<Value> values;
+      values.reserve(out_schema->GetColumnCount());
+      for (const auto &col : out_schema->GetColumns()) {
+        values.emplace_back(col.GetExpr()->EvaluateJoin(&left_tuple, left_schema, &right_tuple, right_schema));
+      }
+      output->Append(Tuple(values, out_schema), RID());
+    }
+  }
+  return true;
+}
+
+AggregationSink::AggregationSink(const AggregationPlanNode *plan, std::shared_ptr<AggregationState> state)
+    : plan_(plan), state_(std::move(state)) {}
+
+bool AggregationSink::Sink(const TupleBatch &batch) {
+  const Schema *child_schema = plan_->GetChildPlan()->OutputSchema();
+  for (size_t i = 0; i < batch.Size(); i++) {
+    const Tuple &tuple = batch.GetTuple(i);
+    AggregateKey key;
+    for (const auto &expr : plan_->GetGroupBys()) {
+      key.group_bys_.emplace_back(expr->Evaluate(&tuple, child_schema));
+    }
+    AggregateValue val;
+    for (const auto &expr : plan_->GetAggregates()) {
+      val.aggregates_.emplace_back(expr->Evaluate(&tuple, child_schema));
+    }
+    state_->ht_.InsertCombine(key, val);
+  }
+  return true;
+}
+
+AggregationSource::AggregationSource(const AggregationPlanNode *plan, std::shared_ptr<AggregationState> state)
+    : plan_(plan), state_(std::move(state)) {}
+
+void AggregationSource::Init() { iter_.emplace(state_->ht_.Begin()); }
+
+bool AggregationSource::Next(TupleBatch *batch) {
+  batch->Clear();
+  const Schema *out_schema = plan_->OutputSchema();
+  const AbstractExpression *having = plan_->GetHaving();
+  while (!batch->IsFull() && *iter_ != state_->ht_.End()) {
+    const auto &key = iter_->Key();
+    const auto &val = iter_->Val();
+    if (having == nullptr || having->EvaluateAggregate(key.group_bys_, val.aggregates_).GetAs<bool>()) {
+      std::vector<Value> values;
+      values.reserve(out_schema->GetColumnCount());
+      for (const auto &col : out_schema->GetColumns()) {
+        values.emplace_back(col.GetExpr()->EvaluateAggregate(key.group_bys_, val.aggregates_));
+      }
+      batch->Append(Tuple(values, out_schema), RID());
+    }
+    ++*iter_;
+  }
+  return !batch->IsEmpty();
+}
+
+DistinctOperator::DistinctOperator(const DistinctPlanNode *plan) : plan_(plan) {}
+
+void DistinctOperator::Init() { seen_.clear(); }
+
+bool DistinctOperator::Execute(const TupleBatch &input, TupleBatch *output) {
+  const Schema *out_schema = plan_->OutputSchema();
+  for (size_t i = 0; i < input.Size(); i++) {
+    DistinctKey key;
+    for (uint32_t col = 0; col < out_schema->GetColumnCount(); col++) {
+      key.dist_value_.emplace_back(input.GetTuple(i).GetValue(out_schema, col));
+    }
+    if (seen_.insert(std::move(key)).second) {
+      output->Append(input.GetTuple(i), input.GetRid(i));
+    }
+  }
+  return true;
+}
+
+LimitOperator::LimitOperator(const LimitPlanNode *plan) : plan_(plan) {}
+
+void LimitOperator::Init() { remaining_ = plan_->GetLimit(); }
+
+bool LimitOperator::Execute(const TupleBatch &input, TupleBatch *output) {
+  for (size_t i = 0; i < input.Size() && remaining_ > 0; i++, remaining_--) {
+    output->Append(input.GetTuple(i), input.GetRid(i));
+  }
+  return remaining_ > 0;
+}
+
+bool ResultSink::Sink(const TupleBatch &batch) {
+  if (result_set_ != nullptr) {
+    for (size_t i = 0; i < batch.Size(); i++) {
+      result_set_->push_back(batch.GetTuple(i));
+    }
+  }
+  return true;
+}
+
+}  // namespace bustub
@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// push_execution_engine.cpp
+//
+// Identification: src/execution/push_execution_engine.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/push_execution_engine.h"
+
+#include <utility>
+
+#include "execution/pipeline/pipeline_builder.h"
+
+namespace bustub {
+
+bool PushExecutionEngine::Execute(const AbstractPlanNode *plan, std::vector<Tuple> *result_set,
+                                  [[maybe_unused]] Transaction *txn, ExecutorContext *exec_ctx) {
+  QueryRun run;
+  run.pipelines_ = PipelineBuilder(exec_ctx, late_materialization_, page_reader_).Build(plan, result_set);
+  ScheduleNext(&run);
+
+  std::unique_lock lock(run.latch_);
+  run.cv_.wait(lock, [&] { return run.done_; });
+  if (run.error_ != nullptr) {
+    std::rethrow_exception(run.error_);
+  }
+  return true;
+}
+
+void PushExecutionEngine::ScheduleNext(QueryRun *run) {
+  Pipeline *next = nullptr;
+  for (auto &pipeline : run->pipelines_) {
+    if (!pipeline->IsFinished()) {
+      next = pipeline.get();
+      break;
+    }
+  }
+  if (next == nullptr) {
+    Finish(run, nullptr);
+    return;
+  }
+
+  // The builder orders the pipelines after their dependencies.
+  BUSTUB_ASSERT(next->IsReady(), "Pipeline scheduled before its dependencies.");
+  Submit(run, next);
+}
+
+void PushExecutionEngine::Submit(QueryRun *run, Pipeline *pipeline) {
+  thread_pool_->Submit([this, run, pipeline] {
+    try {
+      if (!pipeline->Run([this, run, pipeline] { Submit(run, pipeline); })) {
+        // Suspended, the pipeline is submitted again once its source can continue.
+        return;
+      }
+    } catch (...) {
+      Finish(run, std::current_exception());
+      return;
+    }
+    ScheduleNext(run);
+  });
+}
+
+void PushExecutionEngine::Finish(QueryRun *run, std::exception_ptr error) {
+  // Notify while holding the latch, the caller destroys the run as soon as it wakes up.
+  std::scoped_lock lock(run->latch_);
+  run->error_ = std::move(error);
+  run->done_ = true;
+  run->cv_.notify_all();
+}
+
+}  // namespace bustub
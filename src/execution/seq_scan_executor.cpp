@@ -25,25 +25,52 @@ void SeqScanExecutor::Init() {
   table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->GetTableOid());
   table_heap_ = table_info_->table_.get();
   iter_ = table_heap_->Begin(exec_ctx_->GetTransaction());
+  snapshot_page_id_ = table_heap_->GetFirstPageId();
+  snapshot_tuples_.clear();
+  snapshot_pos_ = 0;
+  // SNAPSHOT_ISOLATION从版本链读快照，不加任何锁
+  // REPEATABLE_READ读整张表，一个表级S锁代替逐行加锁，SERIALIZABLE的扫描范围就是整张表，同样也挡住了幻读；
+  // READ_COMMITTED逐行加锁、读完即放，只需要意向锁
+  LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  if (lock_mgr != nullptr) {
+    if (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+        txn->GetIsolationLevel() == IsolationLevel::SERIALIZABLE) {
+      lock_mgr->LockTable(txn, table_info_->oid_, TableLockMode::SHARED);
+    } else if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+      lock_mgr->LockTable(txn, table_info_->oid_, TableLockMode::INTENTION_SHARED);
+    }
+  }
 }
 
 bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
   // 表的所有列和想要输出的列
   Schema table_schema = table_info_->schema_;
   const Schema *out_schema = this->GetOutputSchema();
+  LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  bool snapshot = txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
 
-  while (iter_ != table_heap_->End()) {
-    auto table_tuple = *iter_;
-    RID origin_rid = iter_->GetRid();
+  Tuple table_tuple;
+  while (snapshot ? NextSnapshotTuple(&table_tuple) : iter_ != table_heap_->End()) {
+    if (!snapshot) {
+      table_tuple = *iter_;
+    }
+    RID origin_rid = table_tuple.GetRid();
+    // 乐观事务读到的是自己缓存的写入，自己删掉的行跳过
+    if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && !snapshot) {
+      auto write = txn->GetBufferedWriteSet()->find(origin_rid);
+      if (write != txn->GetBufferedWriteSet()->end() && write->second.wtype_ == WType::DELETE) {
+        ++iter_;
+        continue;
+      }
+    }
 
     // 加锁
-    LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
-    Transaction *txn = GetExecutorContext()->GetTransaction();
-    if (lock_mgr != nullptr) {
-      if (txn->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED) {
-        if (!txn->IsSharedLocked(origin_rid) && !txn->IsExclusiveLocked(origin_rid)) {
-          lock_mgr->LockShared(txn, origin_rid);
-        }
+    if (lock_mgr != nullptr && !snapshot) {
+      if (txn->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED &&
+          txn->GetIsolationLevel() != IsolationLevel::OPTIMISTIC) {
+        lock_mgr->LockShared(txn, table_info_->oid_, origin_rid);
       }
     }
 
@@ -56,12 +83,15 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
     }
 
     // 解锁
-    if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr) {
+    if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr &&
+        txn->IsSharedLocked(origin_rid)) {
       lock_mgr->Unlock(txn, origin_rid);
     }
 
     // 迭代器+1
-    ++iter_;
+    if (!snapshot) {
+      ++iter_;
+    }
 
     // 构建新行，看看该行符不符合条件，符合则返回，不符合就继续找下一行
     Tuple temp_tuple(res, out_schema);
@@ -77,4 +107,18 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
   return false;
 }
 
+bool SeqScanExecutor::NextSnapshotTuple(Tuple *tuple) {
+  // 当前页的可见版本读完了就读下一页，空页直接跳过
+  while (snapshot_pos_ == snapshot_tuples_.size()) {
+    if (snapshot_page_id_ == INVALID_PAGE_ID) {
+      return false;
+    }
+    snapshot_page_id_ =
+        table_heap_->GetSnapshotPage(snapshot_page_id_, &snapshot_tuples_, GetExecutorContext()->GetTransaction());
+    snapshot_pos_ = 0;
+  }
+  *tuple = snapshot_tuples_[snapshot_pos_++];
+  return true;
+}
+
 }  // namespace bustub
@@ -26,6 +26,14 @@ void UpdateExecutor::Init() {
   if (child_executor_ != nullptr) {
     child_executor_->Init();
   }
+  index_batch_ = std::make_unique<IndexWriteBatch>(exec_ctx_->GetCatalog(), table_info_);
+  // 只更新定长列时，元组大小不变，可以直接在原元组上修改
+  in_place_ = true;
+  for (const auto &[col_idx, info] : plan_->GetUpdateAttr()) {
+    if (!table_info_->schema_.GetColumn(col_idx).IsInlined()) {
+      in_place_ = false;
+    }
+  }
 }
 
 bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
@@ -34,63 +42,87 @@ bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   RID tuple_rid;
   Transaction *transaction = GetExecutorContext()->GetTransaction();
   LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
+  std::vector<RID> unlock_rids;
   // 执行子查询
   while (child_executor_->Next(&old_tuple, &tuple_rid)) {
+    new_tuple = GenerateUpdatedTuple(old_tuple);
+    // 乐观事务不加锁，写入连同索引变更缓存到提交时再加锁、校验、写回
+    if (transaction->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+      // 同一行写过多次时，索引里还是第一次写之前的旧值
+      auto buffered_write_set = transaction->GetBufferedWriteSet();
+      auto write = buffered_write_set->find(tuple_rid);
+      Tuple index_tuple = write == buffered_write_set->end() ? old_tuple : write->second.old_tuple_;
+      buffered_write_set->insert_or_assign(tuple_rid,
+                                           BufferedWriteRecord(table_info_->oid_, WType::UPDATE, index_tuple, new_tuple,
+                                                               table_info_->table_.get(), exec_ctx_->GetCatalog()));
+      continue;
+    }
     // 加锁
     if (lock_mgr != nullptr) {
-      if (transaction->IsSharedLocked(tuple_rid)) {
-        lock_mgr->LockUpgrade(transaction, tuple_rid);
-      } else if (!transaction->IsExclusiveLocked(tuple_rid)) {
-        lock_mgr->LockExclusive(transaction, tuple_rid);
-      }
+      lock_mgr->LockExclusive(transaction, table_info_->oid_, tuple_rid);
     }
-    new_tuple = GenerateUpdatedTuple(old_tuple);
     table_info_->table_->UpdateTuple(new_tuple, tuple_rid, exec_ctx_->GetTransaction());
 
-    auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
-    for (const auto &index : indexes) {
-      auto key_tuple =
-          old_tuple.KeyFromTuple(table_info_->schema_, *index->index_->GetKeySchema(), index->index_->GetKeyAttrs());
-      index->index_->DeleteEntry(key_tuple, tuple_rid, exec_ctx_->GetTransaction());
-      auto new_key_tuple =
-          new_tuple.KeyFromTuple(table_info_->schema_, *index->index_->GetKeySchema(), index->index_->GetKeyAttrs());
-      index->index_->InsertEntry(new_key_tuple, tuple_rid, exec_ctx_->GetTransaction());
-      // 在事务中记录下变更
-      IndexWriteRecord write_record(tuple_rid, table_info_->oid_, WType::DELETE, new_tuple, index->index_oid_,
-                                    exec_ctx_->GetCatalog());
-      write_record.old_tuple_ = old_tuple;
-      transaction->GetIndexWriteSet()->emplace_back(write_record);
-    }
-    // 解锁
-    if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr) {
-      lock_mgr->Unlock(transaction, tuple_rid);
+    // 记录索引变更，语句结束时统一写入
+    index_batch_->Update(old_tuple, new_tuple, tuple_rid);
+    // 解锁（推迟到索引更新之后）
+    if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && lock_mgr != nullptr &&
+        transaction->IsExclusiveLocked(tuple_rid)) {
+      unlock_rids.emplace_back(tuple_rid);
     }
   }
+  // 批量更新索引，之后再解锁
+  index_batch_->Apply(transaction, lock_mgr);
+  for (const auto &unlock_rid : unlock_rids) {
+    lock_mgr->Unlock(transaction, unlock_rid);
+  }
   return false;
 }
 
 Tuple UpdateExecutor::GenerateUpdatedTuple(const Tuple &src_tuple) {
   const auto &update_attrs = plan_->GetUpdateAttr();
-  Schema schema = table_info_->schema_;
+  const Schema &schema = table_info_->schema_;
+  // 定长列：拷贝原元组，只覆盖被更新的列
+  if (in_place_) {
+    Tuple updated_tuple(src_tuple);
+    for (const auto &[col_idx, info] : update_attrs) {
+      updated_tuple.SetValue(&schema, col_idx, UpdatedValue(src_tuple, col_idx, info));
+    }
+    return updated_tuple;
+  }
   uint32_t col_count = schema.GetColumnCount();
   std::vector<Value> values;
   for (uint32_t idx = 0; idx < col_count; idx++) {
-    if (update_attrs.find(idx) == update_attrs.cend()) {
+    auto update_attr = update_attrs.find(idx);
+    if (update_attr == update_attrs.cend()) {
       values.emplace_back(src_tuple.GetValue(&schema, idx));
     } else {
-      const UpdateInfo info = update_attrs.at(idx);
-      Value val = src_tuple.GetValue(&schema, idx);
-      switch (info.type_) {
-        case UpdateType::Add:
-          values.emplace_back(val.Add(ValueFactory::GetIntegerValue(info.update_val_)));
-          break;
-        case UpdateType::Set:
-          values.emplace_back(ValueFactory::GetIntegerValue(info.update_val_));
-          break;
-      }
+      values.emplace_back(UpdatedValue(src_tuple, idx, update_attr->second));
     }
   }
   return Tuple{values, &schema};
 }
 
+Value UpdateExecutor::UpdatedValue(const Tuple &src_tuple, uint32_t col_idx, const UpdateInfo &info) {
+  const Schema &schema = table_info_->schema_;
+  Value val;
+  switch (info.type_) {
+    case UpdateType::Add:
+      val = src_tuple.GetValue(&schema, col_idx).Add(ValueFactory::GetIntegerValue(info.update_val_));
+      break;
+    case UpdateType::Set:
+      val = ValueFactory::GetIntegerValue(info.update_val_);
+      break;
+    case UpdateType::Expression:
+      val = info.expr_->Evaluate(&src_tuple, &schema);
+      break;
+  }
+  // 新值必须和列的类型一致，否则序列化的长度不对
+  TypeId col_type = schema.GetColumn(col_idx).GetType();
+  if (val.GetTypeId() != col_type) {
+    val = val.CastAs(col_type);
+  }
+  return val;
+}
+
 }  // namespace bustub
@@ -0,0 +1,71 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// async_page_reader.h
+//
+// Identification: src/include/buffer/async_page_reader.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <functional>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/thread_pool.h"
+
+namespace bustub {
+
+/**
+ * AsyncPageReader reads pages into the buffer pool on a dedicated I/O thread pool.
+ *
+ * A reader that will need a page soon calls Prefetch() and keeps working. If it reaches the page
+ * while the read is still in flight, it hands a callback to WhenReady() and gives up its thread
+ * instead of blocking on the disk. A few I/O threads can then keep the reads of many readers in flight.
+ */
+class AsyncPageReader {
+ public:
+  /**
+   * Construct a new AsyncPageReader.
+   * @param bpm The buffer pool manager the pages are read into
+   * @param io_pool The thread pool the reads block on
+   */
+  AsyncPageReader(BufferPoolManager *bpm, ThreadPool *io_pool) : bpm_(bpm), io_pool_(io_pool) {}
+
+  DISALLOW_COPY_AND_MOVE(AsyncPageReader);
+
+  /**
+   * Start reading a page into the buffer pool, unless it is already there or being read.
+   * The page is not pinned, it can be evicted again before it is used.
+   * @param page_id id of the page to read
+   */
+  void Prefetch(page_id_t page_id);
+
+  /** @return `false` if a read of the page is in flight, `true` otherwise */
+  bool IsReady(page_id_t page_id);
+
+  /**
+   * Run a callback once the page is no longer being read.
+   * @param page_id id of the page to wait for
+   * @param callback Called on the I/O thread once the read completes, or right away if no read is in flight
+   */
+  void WhenReady(page_id_t page_id, std::function<void()> &&callback);
+
+ private:
+  /** Read a page into the buffer pool and run the callbacks that waited for it. */
+  void Read(page_id_t page_id);
+
+  BufferPoolManager *bpm_;
+  ThreadPool *io_pool_;
+  std::mutex latch_;
+  /** The pages being read, and the callbacks waiting for each of them */
+  std::unordered_map<page_id_t, std::vector<std::function<void()>>> pending_;
+};
+
+}  // namespace bustub
@@ -15,6 +15,8 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -87,6 +89,22 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual size_t GetPoolSize() = 0;
 
+  /**
+   * Check whether a page is currently held in the buffer pool, without fetching it.
+   * Buffer pool managers that cannot tell always return false.
+   * @param page_id id of the page to look up
+   * @return true if fetching the page would not read it from disk
+   */
+  virtual bool IsPageResident(page_id_t page_id) { return false; }
+
+  /**
+   * Collect the dirty page table for a fuzzy checkpoint: the pages that may differ from disk, each with its
+   * recovery LSN, the oldest log record whose change may be missing on disk. Pinned pages are included, since
+   * their users may be changing them. Buffer pool managers that do not track it collect nothing.
+   * @param[out] dirty_pages the id and recovery LSN of each page that may be dirty
+   */
+  virtual void GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages) {}
+
  protected:
   /**
    * Grading function. Do not modify!
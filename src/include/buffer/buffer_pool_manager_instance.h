@@ -55,6 +55,10 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override { return pool_size_; }
 
+  bool IsPageResident(page_id_t page_id) override;
+
+  void GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages) override;
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
@@ -121,6 +125,18 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   void ValidatePageId(page_id_t page_id) const;
 
+  /** @return the recovery LSN of a page that holds no unlogged change from now on */
+  lsn_t CleanRecLSN() { return log_manager_ != nullptr ? log_manager_->GetNextLSN() : INVALID_LSN; }
+
+  /** Write a page to disk, once the log records of its changes are durable. */
+  void WritePageToDisk(Page *page);
+
+  /**
+   * Move the recovery LSN of a page that was just written out. A pinned page keeps its recovery LSN: a
+   * change logged before the write may not have been applied to it yet.
+   */
+  void ResetRecLSN(Page *page);
+
   /** Number of pages in the buffer pool. */
   const size_t pool_size_;
   /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
@@ -135,7 +151,7 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
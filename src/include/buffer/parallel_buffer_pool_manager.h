@@ -41,6 +41,10 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override;
 
+  bool IsPageResident(page_id_t page_id) override;
+
+  void GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages) override;
+
  protected:
   /**
    * @param page_id id of page
@@ -30,16 +30,24 @@ extern std::chrono::duration<int64_t> log_timeout;
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
+static constexpr int64_t INVALID_TS = -1;                                     // invalid commit timestamp
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int LOG_SEGMENT_SIZE = 4 * LOG_BUFFER_SIZE;                  // size of a log segment file in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int PIPELINE_BATCH_SIZE = 1024;                              // tuples per push-based pipeline batch
+static constexpr int LOCK_TABLE_SHARDS = 16;                                  // number of partitions of the lock table
+static constexpr size_t LOCK_ESCALATION_THRESHOLD = 5000;  // row locks on one table before a txn locks the table
+static constexpr int VERSION_GC_INTERVAL = 64;             // finished transactions between version store GCs
+static constexpr int VERSION_STORE_SHARDS = 16;            // number of partitions of the version store
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
+using timestamp_t = int64_t;   // commit timestamp type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 
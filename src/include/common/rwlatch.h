@@ -12,25 +12,42 @@
 
 #pragma once
 
-#include <climits>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
 
 #include "common/macros.h"
 
 namespace bustub {
 
 /**
- * Reader-Writer latch backed by std::mutex.
+ * Reader-Writer latch packed into a single atomic word, with writer preference.
+ *
+ * The word holds the number of readers, the number of waiting writers, a bit for the writer holding the
+ * latch and a bit telling that some thread is parked on it. An uncontended RLock or RUnlock is a single
+ * atomic read-modify-write. A waiting writer keeps new readers out, so writers are never starved by a
+ * stream of readers.
+ *
+ * A blocked thread spins for a while, then parks. Latches do not own a mutex or condition variable:
+ * parked threads wait on a slot of a process-wide parking lot picked by the latch address, and a thread
+ * that releases the latch only visits that slot when the parked bit is set.
  */
 class ReaderWriterLatch {
-  using mutex_t = std::mutex;
-  using cond_t = std::condition_variable;
-  static const uint32_t MAX_READERS = UINT_MAX;
+  static constexpr uint64_t READER = 1;
+  static constexpr uint64_t READER_MASK = 0xFFFFFFFFULL;
+  static constexpr uint64_t WAITING_WRITER = 1ULL << 32;
+  static constexpr uint64_t WAITING_WRITER_MASK = 0x3FFFFFFFULL << 32;
+  static constexpr uint64_t PARKED = 1ULL << 62;
+  static constexpr uint64_t WRITER = 1ULL << 63;
+  /** How many times a blocked thread checks the latch before it parks. */
+  static constexpr int SPIN_COUNT = 64;
+  static constexpr size_t PARKING_SLOTS = 64;
 
  public:
   ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
+  ~ReaderWriterLatch() = default;
 
   DISALLOW_COPY(ReaderWriterLatch);
 
@@ -38,13 +55,22 @@ class ReaderWriterLatch {
    * Acquire a write latch.
    */
   void WLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_) {
-      reader_.wait(latch);
+    uint64_t state = 0;
+    if (state_.compare_exchange_strong(state, WRITER, std::memory_order_acquire)) {
+      return;
     }
-    writer_entered_ = true;
-    while (reader_count_ > 0) {
-      writer_.wait(latch);
+    // Announce the writer first, new readers hold back from now on.
+    state_.fetch_add(WAITING_WRITER, std::memory_order_relaxed);
+    while (true) {
+      for (int spin = 0; spin < SPIN_COUNT; spin++) {
+        state = state_.load(std::memory_order_relaxed);
+        if ((state & (WRITER | READER_MASK)) == 0 &&
+            state_.compare_exchange_weak(state, state - WAITING_WRITER + WRITER, std::memory_order_acquire)) {
+          return;
+        }
+        CpuRelax();
+      }
+      Park([](uint64_t value) { return (value & (WRITER | READER_MASK)) != 0; });
     }
   }
 
@@ -52,45 +78,94 @@ class ReaderWriterLatch {
    * Release a write latch.
    */
   void WUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    writer_entered_ = false;
-    reader_.notify_all();
+    uint64_t state = state_.fetch_and(~WRITER, std::memory_order_release);
+    if ((state & PARKED) != 0) {
+      Unpark();
+    }
   }
 
   /**
    * Acquire a read latch.
    */
   void RLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_ || reader_count_ == MAX_READERS) {
-      reader_.wait(latch);
+    uint64_t state = state_.fetch_add(READER, std::memory_order_acquire);
+    if ((state & (WRITER | WAITING_WRITER_MASK)) == 0) {
+      return;
+    }
+    // A writer holds or waits for the latch, take the read back and wait for it.
+    RUnlock();
+    while (true) {
+      for (int spin = 0; spin < SPIN_COUNT; spin++) {
+        state = state_.load(std::memory_order_relaxed);
+        if ((state & (WRITER | WAITING_WRITER_MASK)) == 0 &&
+            state_.compare_exchange_weak(state, state + READER, std::memory_order_acquire)) {
+          return;
+        }
+        CpuRelax();
+      }
+      Park([](uint64_t value) { return (value & (WRITER | WAITING_WRITER_MASK)) != 0; });
     }
-    reader_count_++;
   }
 
   /**
    * Release a read latch.
    */
   void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    reader_count_--;
-    if (writer_entered_) {
-      if (reader_count_ == 0) {
-        writer_.notify_one();
-      }
-    } else {
-      if (reader_count_ == MAX_READERS - 1) {
-        reader_.notify_one();
-      }
+    uint64_t state = state_.fetch_sub(READER, std::memory_order_release);
+    // Only writers wait for readers, so only the last reader wakes anyone.
+    if ((state & READER_MASK) == READER && (state & PARKED) != 0) {
+      Unpark();
     }
   }
 
+  /** @return true if a writer holds or waits for the latch, new readers wait for it then */
+  bool IsWriterPending() const {
+    return (state_.load(std::memory_order_relaxed) & (WRITER | WAITING_WRITER_MASK)) != 0;
+  }
+
  private:
-  mutex_t mutex_;
-  cond_t writer_;
-  cond_t reader_;
-  uint32_t reader_count_{0};
-  bool writer_entered_{false};
+  struct ParkingSlot {
+    std::mutex mutex_;
+    std::condition_variable cv_;
+  };
+
+  static inline std::array<ParkingSlot, PARKING_SLOTS> parking_lot;
+
+  ParkingSlot &GetParkingSlot() {
+    auto address = reinterpret_cast<uintptr_t>(this);
+    return parking_lot[(address ^ (address >> 12)) % PARKING_SLOTS];
+  }
+
+  static void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  /**
+   * Wait until the latch changes, unless it no longer blocks the caller. May return spuriously.
+   * @param blocked whether a state of the latch blocks the caller
+   */
+  template <typename Blocked>
+  void Park(Blocked blocked) {
+    ParkingSlot &slot = GetParkingSlot();
+    std::unique_lock lock(slot.mutex_);
+    // Set under the slot mutex: a release that sees the bit can not notify before we wait.
+    if (!blocked(state_.fetch_or(PARKED, std::memory_order_relaxed))) {
+      return;
+    }
+    slot.cv_.wait(lock);
+  }
+
+  /** Wake the threads parked on the latch, and the others that share its slot. */
+  void Unpark() {
+    ParkingSlot &slot = GetParkingSlot();
+    std::scoped_lock lock(slot.mutex_);
+    state_.fetch_and(~PARKED, std::memory_order_relaxed);
+    slot.cv_.notify_all();
+  }
+
+  std::atomic<uint64_t> state_{0};
 };
 
 }  // namespace bustub
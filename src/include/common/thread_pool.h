@@ -0,0 +1,63 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// thread_pool.h
+//
+// Identification: src/include/common/thread_pool.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * ThreadPool runs submitted tasks on a fixed set of worker threads, in submission order.
+ * A pool is meant to be shared, e.g. by every query running through a PushExecutionEngine.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Start a new thread pool.
+   * @param num_threads The number of worker threads, at least one
+   */
+  explicit ThreadPool(size_t num_threads);
+
+  /** Run every task that is still queued, then stop the workers. */
+  ~ThreadPool();
+
+  DISALLOW_COPY_AND_MOVE(ThreadPool);
+
+  /**
+   * Queue a task for execution on one of the workers.
+   * @param task The task to run, it must not throw
+   */
+  void Submit(std::function<void()> task);
+
+  /** @return the number of worker threads */
+  size_t GetThreadCount() const { return workers_.size(); }
+
+ private:
+  /** The loop every worker runs until the pool shuts down. */
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex latch_;
+  std::condition_variable cv_;
+  bool shutdown_{false};
+};
+
+}  // namespace bustub
@@ -13,22 +13,39 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <set>
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "common/config.h"
+#include "common/macros.h"
 #include "common/rid.h"
+#include "concurrency/lock_stats.h"
 #include "concurrency/transaction.h"
 
 namespace bustub {
 
 class TransactionManager;
 
+/**
+ * How the lock manager keeps transactions out of deadlocks:
+ * WOUND_WAIT: an older transaction aborts the younger ones it conflicts with, a younger one waits;
+ * WAIT_DIE: an older transaction waits, a younger one that conflicts with an older one aborts itself;
+ * DETECTION: every transaction waits, a background thread aborts the youngest transaction of each
+ * cycle in the waits-for graph every cycle_detection_interval.
+ */
+enum class DeadlockPolicy { WOUND_WAIT, WAIT_DIE, DETECTION };
+
 /**
  * LockManager handles transactions asking for locks on records.
  */
@@ -46,20 +63,59 @@ class LockManager {
 
   class LockRequestQueue {
    public:
+    // protects the queue, blocked transactions wait on it
+    std::mutex latch_;
     std::list<LockRequest> request_queue_;
     // for notifying blocked transactions on this rid
     std::condition_variable cv_;
     // txn_id of an upgrading transaction (if any)
     txn_id_t upgrading_ = INVALID_TXN_ID;
+    // number of lock calls using the queue, it is only reclaimed when there are none
+    std::atomic<size_t> users_{0};
+  };
+
+  class TableLockRequest {
+   public:
+    TableLockRequest(txn_id_t txn_id, TableLockMode lock_mode)
+        : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false), upgrading_(false), upgrade_mode_(lock_mode) {}
+
+    txn_id_t txn_id_;
+    TableLockMode lock_mode_;
+    bool granted_;
+    // an upgrading request keeps its granted lock_mode_ while it waits for upgrade_mode_
+    bool upgrading_;
+    TableLockMode upgrade_mode_;
+  };
+
+  class TableLockQueue {
+   public:
+    std::list<TableLockRequest> request_queue_;
+    // for notifying blocked transactions on this table
+    std::condition_variable cv_;
+    // number of transactions blocked on cv_, the queue is only reclaimed when there are none
+    size_t waiting_ = 0;
+  };
+
+  /** A partition of the lock table. Its latch only protects the map, not the queues in it. */
+  class LockTableShard {
+   public:
+    std::mutex latch_;
+    std::unordered_map<RID, LockRequestQueue> lock_table_;
   };
 
  public:
   /**
-   * Creates a new lock manager configured for the deadlock prevention policy.
+   * Creates a new lock manager configured for a deadlock policy.
+   * @param policy how deadlocks are prevented or resolved
+   * @param escalation_threshold the number of row locks a transaction takes on one table
+   * before the table lock covering them replaces them
    */
-  LockManager() = default;
+  explicit LockManager(DeadlockPolicy policy = DeadlockPolicy::WOUND_WAIT,
+                       size_t escalation_threshold = LOCK_ESCALATION_THRESHOLD);
 
-  ~LockManager() = default;
+  ~LockManager();
+
+  DISALLOW_COPY_AND_MOVE(LockManager);
 
   /*
    * [LOCK_NOTE]: For all locking functions, we:
@@ -104,11 +160,216 @@ class LockManager {
    */
   bool Unlock(Transaction *txn, const RID &rid);
 
+  /*
+   * Tables are locked in a hierarchy with their rows: a row lock needs an intention lock of
+   * the same kind on its table, and a SHARED or EXCLUSIVE table lock covers every row at once.
+   * Locking a table the transaction has already locked in a weaker mode upgrades the lock.
+   * Once a transaction holds escalation_threshold row locks on a table, the next row lock
+   * escalates to a SHARED or EXCLUSIVE table lock and the row locks it covers are released.
+   */
+
+  /**
+   * Acquire a lock on a table. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the lock
+   * @param oid the table to be locked
+   * @param mode the mode to lock the table in, it is combined with the mode the table is already locked in
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockTable(Transaction *txn, table_oid_t oid, TableLockMode mode);
+
+  /**
+   * Release the table lock held by the transaction. Its row locks on the table should be released first.
+   * @param txn the transaction releasing the lock
+   * @param oid the table that is locked by the transaction
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, table_oid_t oid);
+
+  /**
+   * Acquire a shared lock on a row of a table, together with an INTENTION_SHARED lock on the table.
+   * No row lock is taken if the table lock already covers reading the row.
+   * @param txn the transaction requesting the shared lock
+   * @param oid the table the row belongs to
+   * @param rid the RID to be locked in shared mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockShared(Transaction *txn, table_oid_t oid, const RID &rid);
+
+  /**
+   * Acquire an exclusive lock on a row of a table, together with an INTENTION_EXCLUSIVE lock on the table.
+   * No row lock is taken if the table is locked in EXCLUSIVE mode. A shared row lock is upgraded.
+   * @param txn the transaction requesting the exclusive lock
+   * @param oid the table the row belongs to
+   * @param rid the RID to be locked in exclusive mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockExclusive(Transaction *txn, table_oid_t oid, const RID &rid);
+
+  /*
+   * Index keys are locked so that a SERIALIZABLE probe of a key sees no phantom: the probe locks the key in
+   * shared mode whether or not the index holds it, and every transaction that adds or removes the key locks
+   * it in exclusive mode. A key lock lives in the lock table next to the row locks, under a RID outside every
+   * table heap: its page id identifies the index, its slot is the hash of the key. Keys whose hashes collide
+   * share a lock, which costs concurrency but not correctness. Key locks are held until the transaction ends.
+   */
+
+  /**
+   * Acquire a shared lock on an index key, before probing the index for it. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the shared lock
+   * @param index_oid the index that is probed
+   * @param key the key that is probed, in the key schema of the index
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockKeyShared(Transaction *txn, index_oid_t index_oid, const Tuple &key);
+
+  /**
+   * Acquire an exclusive lock on an index key, before adding or removing an entry with the key.
+   * A shared lock on the key is upgraded. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the exclusive lock
+   * @param index_oid the index that is changed
+   * @param key the key that is changed, in the key schema of the index
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockKeyExclusive(Transaction *txn, index_oid_t index_oid, const Tuple &key);
+
+  /** @return the RID that names the lock on a key of an index */
+  static RID GetKeyLockName(index_oid_t index_oid, const Tuple &key);
+
+  /*** Graph API, only used by the DETECTION policy ***/
+
+  /** Adds an edge from t1 -> t2, t1 waits for t2. */
+  void AddEdge(txn_id_t t1, txn_id_t t2);
+
+  /** Removes an edge from t1 -> t2. */
+  void RemoveEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Checks if the graph has a cycle, returning the newest transaction ID in the cycle if so.
+   * @param[out] txn_id if the graph has a cycle, will contain the newest transaction ID
+   * @return false if the graph has no cycle, otherwise stores the newest transaction ID in the cycle to txn_id
+   */
+  bool HasCycle(txn_id_t *txn_id);
+
+  /** @return the list of all edges in the graph, used for testing only! */
+  std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
+
+  /** Runs cycle detection in the background every cycle_detection_interval, until the lock manager goes away. */
+  void RunCycleDetection();
+
+  /** @return the number of request queues in the lock table, i.e. of RIDs that are locked or waited for */
+  size_t GetQueueCount();
+
+  /** @return the contention statistics of the lock manager, counted since it started or was last reset */
+  LockStats *GetStats() { return &stats_; }
+
  private:
-  std::mutex latch_;
+  /**
+   * QueueHandle latches the request queue of a RID for one lock call, creating the queue if needed.
+   * The shard latch is only held for the lookup. When the handle goes away, the queue is
+   * reclaimed if no request is left in it and no other lock call is using it.
+   */
+  class QueueHandle {
+   public:
+    QueueHandle(LockManager *lock_mgr, const RID &rid);
+    ~QueueHandle();
+
+    DISALLOW_COPY_AND_MOVE(QueueHandle);
+
+    LockRequestQueue *operator->() { return queue_; }
+
+    /** @return the RID the queue belongs to */
+    const RID &GetRid() const { return rid_; }
+
+    /** @return the latch of the queue, held by this handle */
+    std::unique_lock<std::mutex> &Lock() { return lock_; }
+
+   private:
+    LockTableShard &shard_;
+    RID rid_;
+    LockRequestQueue *queue_;
+    std::unique_lock<std::mutex> lock_;
+  };
+
+  /** @return whether a table lock in mode wanted can be granted next to one in mode held */
+  static bool AreTableLocksCompatible(TableLockMode held, TableLockMode wanted);
+
+  /** @return the weakest mode that grants everything both held and wanted grant */
+  static TableLockMode CombineTableLocks(TableLockMode held, TableLockMode wanted);
+
+  /**
+   * Decide whether the transaction's request can be granted, resolving its conflicts with the requests
+   * queued before it according to the deadlock policy. The queue latch must be held.
+   * @return true if the request is granted, false if it has to wait or its transaction was aborted
+   */
+  bool CheckGrant(Transaction *txn, const RID &rid, LockRequestQueue *queue);
+
+  /**
+   * Block until the transaction's request in the queue is granted.
+   * If the transaction is aborted meanwhile, its request is removed and TransactionAbortException is thrown.
+   * @param mode the mode of the request, for the statistics
+   */
+  void WaitForGrant(Transaction *txn, QueueHandle *queue, LockStatsMode mode);
+
+  /** Abort the transaction for a reason and throw TransactionAbortException. */
+  [[noreturn]] void AbortTransaction(Transaction *txn, AbortReason reason);
+
+  /**
+   * Rebuild waits_for_ from the request queues.
+   * @param[out] row_waits the RID each waiting transaction waits for
+   * @param[out] table_waits the table each waiting transaction waits for
+   */
+  void BuildWaitsForGraph(std::unordered_map<txn_id_t, RID> *row_waits,
+                          std::unordered_map<txn_id_t, table_oid_t> *table_waits);
+
+  /**
+   * Abort the victim of a deadlock, unless it is already aborted. The caller must have latched a queue in which
+   * the victim still waits, so that the victim is alive and not committing.
+   */
+  void AbortVictim(txn_id_t victim);
+
+  /** Depth-first search for a cycle from txn_id, path holds the transactions on the current path. */
+  bool FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::unordered_set<txn_id_t> *visited,
+                 txn_id_t *newest);
+
+  /** Remove the transaction's request from the queue of rid, without any 2PL state change. */
+  void ReleaseRowLock(Transaction *txn, const RID &rid);
+
+  /**
+   * Lock a table in a mode covering rows, then release the row locks of the table the new mode covers.
+   * @return true if the table lock is granted, false otherwise
+   */
+  bool EscalateTableLock(Transaction *txn, table_oid_t oid, TableLockMode mode);
+
+  /** Erase the table's queue if no transaction uses it anymore. table_latch_ must be held. */
+  void ReclaimTableQueue(table_oid_t oid);
+
+  /** @return the shard of the lock table that rid belongs to */
+  LockTableShard &ShardOf(const RID &rid) { return shards_[std::hash<RID>()(rid) % shards_.size()]; }
+
+  /** How deadlocks are prevented or resolved. */
+  DeadlockPolicy policy_;
+  /** Row locks a transaction may hold on one table before they are escalated. */
+  size_t escalation_threshold_;
+
+  /** Lock table for lock requests, partitioned by RID hash. */
+  std::array<LockTableShard, LOCK_TABLE_SHARDS> shards_;
+
+  /** Protects the table locks, blocked transactions wait on it. Tables are few, they do not need sharding. */
+  std::mutex table_latch_;
+  /** Lock table for table lock requests. */
+  std::unordered_map<table_oid_t, TableLockQueue> table_lock_table_;
+
+  /** Whether the cycle detection thread keeps running. */
+  std::atomic<bool> enable_cycle_detection_{false};
+  /** The background thread of the DETECTION policy. */
+  std::thread cycle_detection_thread_;
+  /** Protects waits_for_. */
+  std::mutex waits_for_latch_;
+  /** Waits-for graph representation, kept sorted so that cycles are found deterministically. */
+  std::map<txn_id_t, std::set<txn_id_t>> waits_for_;
 
-  /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
+  /** Contention statistics. */
+  LockStats stats_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,206 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_stats.h
+//
+// Identification: src/include/concurrency/lock_stats.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/** The lock modes counted apart: the two row modes, then one per TableLockMode in its order. */
+enum class LockStatsMode { ROW_SHARED, ROW_EXCLUSIVE, TABLE_IS, TABLE_IX, TABLE_S, TABLE_SIX, TABLE_X };
+
+/**
+ * HotKeyCounter keeps the keys that occur most often in a stream, in bounded space.
+ *
+ * It is the space-saving algorithm: up to capacity keys are counted exactly, and a key that is not counted
+ * replaces the one with the smallest count, inheriting that count. A key's count is thus never below its
+ * real number of occurrences, and overestimates it by at most the smallest count kept.
+ */
+template <typename Key>
+class HotKeyCounter {
+ public:
+  explicit HotKeyCounter(size_t capacity) : capacity_(capacity) {}
+
+  DISALLOW_COPY_AND_MOVE(HotKeyCounter);
+
+  /** Count one occurrence of a key. */
+  void Add(const Key &key) {
+    std::scoped_lock lock(latch_);
+    auto it = counts_.find(key);
+    if (it != counts_.end()) {
+      it->second++;
+      return;
+    }
+    if (counts_.size() < capacity_) {
+      counts_.emplace(key, 1);
+      return;
+    }
+    auto victim = counts_.begin();
+    for (auto candidate = counts_.begin(); candidate != counts_.end(); ++candidate) {
+      if (candidate->second < victim->second) {
+        victim = candidate;
+      }
+    }
+    uint64_t count = victim->second + 1;
+    counts_.erase(victim);
+    counts_.emplace(key, count);
+  }
+
+  /** @return up to k keys with the highest counts, most frequent first */
+  std::vector<std::pair<Key, uint64_t>> Top(size_t k) {
+    std::vector<std::pair<Key, uint64_t>> top;
+    {
+      std::scoped_lock lock(latch_);
+      top.assign(counts_.begin(), counts_.end());
+    }
+    auto by_count = [](const auto &a, const auto &b) { return a.second > b.second; };
+    if (top.size() > k) {
+      std::partial_sort(top.begin(), top.begin() + k, top.end(), by_count);
+      top.resize(k);
+    } else {
+      std::sort(top.begin(), top.end(), by_count);
+    }
+    return top;
+  }
+
+  void Clear() {
+    std::scoped_lock lock(latch_);
+    counts_.clear();
+  }
+
+ private:
+  size_t capacity_;
+  std::mutex latch_;
+  std::unordered_map<Key, uint64_t> counts_;
+};
+
+/**
+ * LockStats profiles the lock manager: how often each lock mode is granted and waited for, how long the waits
+ * last, how many transactions are wounded or aborted and why, and which rows and tables are waited for most.
+ *
+ * The statistics stay on while the system runs, so the path of a lock granted at once only bumps a relaxed
+ * counter in a stripe picked by the calling thread, whose cache line few other threads write. Everything else
+ * is only recorded when a transaction waits or aborts, which already costs far more than the bookkeeping.
+ * Readers sum the stripes without stopping the writers, so a snapshot taken under load may be off by the calls
+ * in flight.
+ */
+class LockStats {
+ public:
+  static constexpr size_t MODE_COUNT = 7;
+  /** Bucket 0 counts the waits under 1us, bucket i the waits in [2^(i-1), 2^i) us, the last one all longer waits. */
+  static constexpr size_t WAIT_BUCKETS = 32;
+  static constexpr size_t ABORT_REASON_COUNT = static_cast<size_t>(AbortReason::WRITE_ON_READ_ONLY) + 1;
+
+  LockStats() = default;
+
+  DISALLOW_COPY_AND_MOVE(LockStats);
+
+  /** @return the statistics mode of a table lock mode */
+  static LockStatsMode ForTable(TableLockMode mode) {
+    return static_cast<LockStatsMode>(static_cast<size_t>(LockStatsMode::TABLE_IS) + static_cast<size_t>(mode));
+  }
+
+  /*** Recording, called by the lock manager ***/
+
+  /** Count a lock granted in a mode, whether or not the transaction waited for it. */
+  void RecordAcquire(LockStatsMode mode);
+
+  /** Count a wait for a row lock that ended, granted or not. */
+  void RecordRowWait(LockStatsMode mode, const RID &rid, std::chrono::steady_clock::duration wait_time);
+
+  /** Count a wait for a table lock that ended, granted or not. */
+  void RecordTableWait(LockStatsMode mode, table_oid_t oid, std::chrono::steady_clock::duration wait_time);
+
+  /** Count a younger transaction aborted by an older one under WOUND_WAIT, which is also an abort for DEADLOCK. */
+  void RecordWound() {
+    wounds_.fetch_add(1, std::memory_order_relaxed);
+    RecordAbort(AbortReason::DEADLOCK);
+  }
+
+  /** Count a transaction aborted by the lock manager, once, by whoever aborts it. */
+  void RecordAbort(AbortReason reason) {
+    aborts_[static_cast<size_t>(reason)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /*** Reading ***/
+
+  /** @return the number of locks granted in a mode */
+  uint64_t GetAcquisitions(LockStatsMode mode);
+
+  /** @return the number of requests in a mode that had to wait */
+  uint64_t GetWaits(LockStatsMode mode) { return waits_[static_cast<size_t>(mode)].load(std::memory_order_relaxed); }
+
+  /** @return the total time the requests in a mode waited */
+  std::chrono::microseconds GetWaitTime(LockStatsMode mode) {
+    return std::chrono::microseconds(wait_us_[static_cast<size_t>(mode)].load(std::memory_order_relaxed));
+  }
+
+  /** @return the number of waits in a mode in each bucket of the wait time histogram, see WAIT_BUCKETS */
+  std::array<uint64_t, WAIT_BUCKETS> GetWaitHistogram(LockStatsMode mode);
+
+  /** @return the number of transactions wounded under WOUND_WAIT */
+  uint64_t GetWounds() { return wounds_.load(std::memory_order_relaxed); }
+
+  /** @return the number of transactions the lock manager aborted for a reason */
+  uint64_t GetAborts(AbortReason reason) {
+    return aborts_[static_cast<size_t>(reason)].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @return up to k RIDs waited for most often, with their approximate wait counts, most waited for first.
+   * Index key locks show up under their lock names, see LockManager::GetKeyLockName.
+   */
+  std::vector<std::pair<RID, uint64_t>> GetHotRids(size_t k) { return hot_rids_.Top(k); }
+
+  /** @return up to k tables waited for most often, with their approximate wait counts */
+  std::vector<std::pair<table_oid_t, uint64_t>> GetHotTables(size_t k) { return hot_tables_.Top(k); }
+
+  /** Start counting from zero again. Calls recorded concurrently may be lost or kept. */
+  void Reset();
+
+ private:
+  static constexpr size_t STRIPE_COUNT = 16;
+  /** How many RIDs and tables the hot key counters keep. */
+  static constexpr size_t HOT_KEY_CAPACITY = 64;
+
+  /** The grant counters of a group of threads, on their own cache lines. */
+  struct alignas(64) Stripe {
+    std::array<std::atomic<uint64_t>, MODE_COUNT> acquisitions_{};
+  };
+
+  void RecordWait(LockStatsMode mode, std::chrono::steady_clock::duration wait_time);
+
+  std::array<Stripe, STRIPE_COUNT> stripes_;
+  std::array<std::atomic<uint64_t>, MODE_COUNT> waits_{};
+  std::array<std::atomic<uint64_t>, MODE_COUNT> wait_us_{};
+  std::array<std::array<std::atomic<uint64_t>, WAIT_BUCKETS>, MODE_COUNT> wait_histograms_{};
+  std::atomic<uint64_t> wounds_{0};
+  std::array<std::atomic<uint64_t>, ABORT_REASON_COUNT> aborts_{};
+  HotKeyCounter<RID> hot_rids_{HOT_KEY_CAPACITY};
+  HotKeyCounter<table_oid_t> hot_tables_{HOT_KEY_CAPACITY};
+};
+
+}  // namespace bustub
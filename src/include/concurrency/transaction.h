@@ -14,10 +14,14 @@
 
 #include <atomic>
 #include <deque>
+#include <limits>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
@@ -44,9 +48,25 @@ namespace bustub {
 enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
- * Transaction isolation level.
+ * Transaction isolation level. SERIALIZABLE transactions lock like REPEATABLE_READ ones, and also lock the index
+ * keys they probe, so that no phantom can appear under them. OPTIMISTIC transactions are serializable without
+ * taking locks while they run: they buffer their updates and deletes, and validate the versions they read when
+ * they commit.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class IsolationLevel {
+  READ_UNCOMMITTED,
+  REPEATABLE_READ,
+  READ_COMMITTED,
+  SNAPSHOT_ISOLATION,
+  OPTIMISTIC,
+  SERIALIZABLE
+};
+
+/**
+ * Lock modes on a whole table. The intention modes announce row locks of the same kind,
+ * SHARED_INTENTION_EXCLUSIVE reads the whole table and writes some of its rows.
+ */
+enum class TableLockMode { INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED, SHARED_INTENTION_EXCLUSIVE, EXCLUSIVE };
 
 /**
  * Type of write operation.
@@ -55,23 +75,56 @@ enum class WType { INSERT = 0, DELETE, UPDATE };
 
 class TableHeap;
 class Catalog;
+class VersionStore;
 using table_oid_t = uint32_t;
 using index_oid_t = uint32_t;
+/** The oid of a table heap outside the catalog, no table lock covers its rows. */
+static constexpr table_oid_t INVALID_TABLE_OID = std::numeric_limits<table_oid_t>::max();
 
 /**
  * WriteRecord tracks information related to a write.
  */
 class TableWriteRecord {
  public:
-  TableWriteRecord(RID rid, WType wtype, const Tuple &tuple, TableHeap *table)
-      : rid_(rid), wtype_(wtype), tuple_(tuple), table_(table) {}
+  TableWriteRecord(RID rid, WType wtype, const Tuple &tuple, TableHeap *table, lsn_t lsn = INVALID_LSN)
+      : rid_(rid), wtype_(wtype), tuple_(tuple), table_(table), lsn_(lsn) {}
 
   RID rid_;
   WType wtype_;
-  /** The tuple is only used for the update operation. */
+  /** The image the write replaced, for an update or a delete that marked the tuple. */
   Tuple tuple_;
   /** The table heap specifies which table this write record is for. */
   TableHeap *table_;
+  /** The LSN of the log record of the write, the CLR of its rollback names it. INVALID_LSN without logging. */
+  lsn_t lsn_;
+};
+
+/**
+ * BufferedWriteRecord holds an update or a delete of an OPTIMISTIC transaction until it commits,
+ * together with the index changes it implies.
+ */
+class BufferedWriteRecord {
+ public:
+  BufferedWriteRecord(table_oid_t table_oid, WType wtype, const Tuple &old_tuple, const Tuple &tuple,
+                      TableHeap *table, Catalog *catalog)
+      : table_oid_(table_oid),
+        wtype_(wtype),
+        old_tuple_(old_tuple),
+        tuple_(tuple),
+        table_(table),
+        catalog_(catalog) {}
+
+  /** The table is locked through its oid when the write is installed. */
+  table_oid_t table_oid_;
+  /** Either UPDATE or DELETE, inserts are not buffered. */
+  WType wtype_;
+  /** The image of the row before the transaction first wrote it, the one its index entries are built from. */
+  Tuple old_tuple_;
+  /** The new image of the row, only used for the update operation. */
+  Tuple tuple_;
+  TableHeap *table_;
+  /** The catalog that owns the indexes of the table. */
+  Catalog *catalog_;
 };
 
 /**
@@ -107,7 +160,11 @@ enum class AbortReason {
   UNLOCK_ON_SHRINKING,
   UPGRADE_CONFLICT,
   DEADLOCK,
-  LOCKSHARED_ON_READ_UNCOMMITTED
+  LOCKSHARED_ON_READ_UNCOMMITTED,
+  WRITE_CONFLICT,
+  VALIDATION_FAILED,
+  INSTALL_FAILED,
+  WRITE_ON_READ_ONLY
 };
 
 /**
@@ -137,6 +194,17 @@ class TransactionAbortException : public std::exception {
         return "Transaction " + std::to_string(txn_id_) + " aborted on deadlock\n";
       case AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED:
         return "Transaction " + std::to_string(txn_id_) + " aborted on lockshared on READ_UNCOMMITTED\n";
+      case AbortReason::WRITE_CONFLICT:
+        return "Transaction " + std::to_string(txn_id_) +
+               " aborted because a row it writes was changed after its snapshot was taken\n";
+      case AbortReason::VALIDATION_FAILED:
+        return "Transaction " + std::to_string(txn_id_) +
+               " aborted because a row it read was changed before it committed\n";
+      case AbortReason::INSTALL_FAILED:
+        return "Transaction " + std::to_string(txn_id_) +
+               " aborted because one of its buffered writes could not be written to the table\n";
+      case AbortReason::WRITE_ON_READ_ONLY:
+        return "Transaction " + std::to_string(txn_id_) + " aborted because it is read-only and tried to write\n";
     }
     // Todo: Should fail with unreachable.
     return "";
@@ -145,22 +213,35 @@ class TransactionAbortException : public std::exception {
 
 /**
  * Transaction tracks information related to a transaction.
+ *
+ * A read-only transaction reads the snapshot taken when it begins, whatever isolation level it asks for, so it
+ * never takes a lock. It has no lock sets and no write sets: any write aborts it.
  */
 class Transaction {
  public:
-  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
+  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                       bool read_only = false)
       : state_(TransactionState::GROWING),
-        isolation_level_(isolation_level),
+        isolation_level_(read_only ? IsolationLevel::SNAPSHOT_ISOLATION : isolation_level),
+        read_only_(read_only),
         thread_id_(std::this_thread::get_id()),
         txn_id_(txn_id),
-        prev_lsn_(INVALID_LSN),
-        shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        prev_lsn_(INVALID_LSN) {
+    page_set_ = std::make_shared<std::deque<bustub::Page *>>();
+    deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
+    if (read_only) {
+      return;
+    }
     // Initialize the sets that will be tracked.
+    shared_lock_set_ = std::make_shared<std::unordered_set<RID>>();
+    exclusive_lock_set_ = std::make_shared<std::unordered_set<RID>>();
+    table_lock_set_ = std::make_shared<std::unordered_map<table_oid_t, TableLockMode>>();
+    table_row_lock_set_ = std::make_shared<std::unordered_map<table_oid_t, std::unordered_set<RID>>>();
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
-    page_set_ = std::make_shared<std::deque<bustub::Page *>>();
-    deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
+    version_write_set_ = std::make_shared<std::vector<RID>>();
+    read_version_set_ = std::make_shared<std::unordered_map<RID, timestamp_t>>();
+    buffered_write_set_ = std::make_shared<std::unordered_map<RID, BufferedWriteRecord>>();
   }
 
   ~Transaction() = default;
@@ -176,6 +257,9 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline IsolationLevel GetIsolationLevel() const { return isolation_level_; }
 
+  /** @return true if the transaction was begun read-only */
+  inline bool IsReadOnly() const { return read_only_; }
+
   /** @return the list of table write records of this transaction */
   inline std::shared_ptr<std::deque<TableWriteRecord>> GetWriteSet() { return table_write_set_; }
 
@@ -223,10 +307,31 @@ class Transaction {
   inline std::shared_ptr<std::unordered_set<RID>> GetExclusiveLockSet() { return exclusive_lock_set_; }
 
   /** @return true if rid is shared locked by this transaction */
-  bool IsSharedLocked(const RID &rid) { return shared_lock_set_->find(rid) != shared_lock_set_->end(); }
+  bool IsSharedLocked(const RID &rid) {
+    return !read_only_ && shared_lock_set_->find(rid) != shared_lock_set_->end();
+  }
 
   /** @return true if rid is exclusively locked by this transaction */
-  bool IsExclusiveLocked(const RID &rid) { return exclusive_lock_set_->find(rid) != exclusive_lock_set_->end(); }
+  bool IsExclusiveLocked(const RID &rid) {
+    return !read_only_ && exclusive_lock_set_->find(rid) != exclusive_lock_set_->end();
+  }
+
+  /** @return true if the table is locked EXCLUSIVE by this transaction, which covers all of its rows */
+  bool IsTableExclusiveLocked(table_oid_t oid) {
+    if (read_only_) {
+      return false;
+    }
+    auto lock = table_lock_set_->find(oid);
+    return lock != table_lock_set_->end() && lock->second == TableLockMode::EXCLUSIVE;
+  }
+
+  /** @return the tables locked by this transaction, and the mode each of them is locked in */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, TableLockMode>> GetTableLockSet() { return table_lock_set_; }
+
+  /** @return the row locks taken through a table lock, grouped by table */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> GetTableRowLockSet() {
+    return table_row_lock_set_;
+  }
 
   /** @return the current state of the transaction */
   inline TransactionState GetState() { return state_; }
@@ -237,6 +342,13 @@ class Transaction {
    */
   inline void SetState(TransactionState state) { state_ = state; }
 
+  /**
+   * Set the state of the transaction from another one, e.g. to wound it.
+   * @param state new state
+   * @return the state it replaced
+   */
+  inline TransactionState ExchangeState(TransactionState state) { return state_.exchange(state); }
+
   /** @return the previous LSN */
   inline lsn_t GetPrevLSN() { return prev_lsn_; }
 
@@ -246,11 +358,64 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return the LSN of the BEGIN record of the transaction, INVALID_LSN if it was not logged */
+  inline lsn_t GetBeginLSN() { return begin_lsn_; }
+
+  /**
+   * Set the LSN of the BEGIN record.
+   * @param begin_lsn the LSN of the BEGIN record
+   */
+  inline void SetBeginLSN(lsn_t begin_lsn) { begin_lsn_ = begin_lsn; }
+
+  /** @return the commit timestamp of the snapshot the transaction reads under SNAPSHOT_ISOLATION */
+  inline timestamp_t GetReadTs() const { return read_ts_; }
+
+  /**
+   * Set the snapshot the transaction reads.
+   * @param read_ts the newest commit timestamp the transaction sees
+   */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return the version store the transaction records its writes in, nullptr if versions are not kept */
+  inline VersionStore *GetVersionStore() const { return version_store_; }
+
+  /**
+   * Set the version store the transaction records its writes in.
+   * @param version_store the version store of the transaction manager
+   */
+  inline void SetVersionStore(VersionStore *version_store) { version_store_ = version_store; }
+
+  /** @return true if the transaction records the versions its writes replace, guarded by the write latch */
+  inline bool IsVersioned() const { return versioned_; }
+
+  /**
+   * Set whether the transaction records the versions its writes replace. The write latch must be held while
+   * the transaction runs.
+   * @param versioned true to record versions
+   */
+  inline void SetVersioned(bool versioned) { versioned_ = versioned; }
+
+  /** @return the latch held while the transaction changes a row and its write set, or while the set is read */
+  inline std::mutex *GetWriteLatch() { return &write_latch_; }
+
+  /** @return the rows whose version chains the transaction owns */
+  inline std::shared_ptr<std::vector<RID>> GetVersionWriteSet() { return version_write_set_; }
+
+  /** @return the version of each row an OPTIMISTIC transaction read, validated when it commits */
+  inline std::shared_ptr<std::unordered_map<RID, timestamp_t>> GetReadVersionSet() { return read_version_set_; }
+
+  /** @return the updates and deletes an OPTIMISTIC transaction installs when it commits */
+  inline std::shared_ptr<std::unordered_map<RID, BufferedWriteRecord>> GetBufferedWriteSet() {
+    return buffered_write_set_;
+  }
+
  private:
-  /** The current transaction state. */
-  TransactionState state_;
+  /** The current transaction state. Another transaction's lock request may wound this one, so it is atomic. */
+  std::atomic<TransactionState> state_;
   /** The isolation level of the transaction. */
   IsolationLevel isolation_level_;
+  /** Whether the transaction reads its snapshot without locks and never writes. */
+  bool read_only_;
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
@@ -260,8 +425,25 @@ class Transaction {
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
-  /** The LSN of the last record written by the transaction. */
-  lsn_t prev_lsn_;
+  /** The LSN of the last record written by the transaction, read by checkpoints while the transaction runs. */
+  std::atomic<lsn_t> prev_lsn_;
+  /** The LSN of the first record written by the transaction, recovery reads the log from there on. */
+  std::atomic<lsn_t> begin_lsn_{INVALID_LSN};
+
+  /** MVCC: the newest commit timestamp the transaction sees. */
+  timestamp_t read_ts_{INVALID_TS};
+  /** MVCC: where the transaction records the versions its writes replace. */
+  VersionStore *version_store_{nullptr};
+  /** MVCC: whether the writes record versions, writers that began with no snapshot to serve do not. */
+  bool versioned_{true};
+  /** MVCC: lets a snapshot record the versions of an unversioned writer from its write set. */
+  std::mutex write_latch_;
+  /** MVCC: the rows the transaction recorded versions for. */
+  std::shared_ptr<std::vector<RID>> version_write_set_;
+  /** OCC: the versions of the rows read. */
+  std::shared_ptr<std::unordered_map<RID, timestamp_t>> read_version_set_;
+  /** OCC: the writes buffered until commit. */
+  std::shared_ptr<std::unordered_map<RID, BufferedWriteRecord>> buffered_write_set_;
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -272,6 +454,10 @@ class Transaction {
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the tables locked by this transaction. */
+  std::shared_ptr<std::unordered_map<table_oid_t, TableLockMode>> table_lock_set_;
+  /** LockManager: the row locks of each table, counted for lock escalation. */
+  std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> table_row_lock_set_;
 };
 
 }  // namespace bustub
@@ -13,13 +13,19 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>  // NOLINT
+#include <set>
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
+#include "concurrency/version_store.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
@@ -39,13 +45,17 @@ class TransactionManager {
    * Begins a new transaction.
    * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
    * @param isolation_level an optional isolation level of the transaction.
+   * @param read_only whether a newly created transaction is read-only. A read-only transaction reads a snapshot
+   * and takes no locks; it is not registered, and committing it only ends its snapshot.
    * @return an initialized transaction
    */
-  Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ);
+  Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                     bool read_only = false);
 
   /**
    * Commits a transaction.
    * @param txn the transaction to commit
+   * @throws TransactionAbortException after aborting an OPTIMISTIC transaction that fails to validate or install
    */
   void Commit(Transaction *txn);
 
@@ -59,29 +69,29 @@ class TransactionManager {
    * Global list of running transactions
    */
 
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
-  static std::shared_mutex txn_map_mutex;
+  /** The transaction registry is a global list of all the running transactions in the system. */
+  static TransactionRegistry txn_registry;
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * Locates and returns the transaction with the given transaction ID. The transaction is only guaranteed
+   * to stay alive while it holds or waits for a lock the caller has latched.
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr if it has committed or aborted
    */
-  static Transaction *GetTransaction(txn_id_t txn_id) {
-    TransactionManager::txn_map_mutex.lock_shared();
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    TransactionManager::txn_map_mutex.unlock_shared();
-    return res;
-  }
+  static Transaction *GetTransaction(txn_id_t txn_id) { return txn_registry.Find(txn_id); }
+
+  /**
+   * Collect the active transaction table for a fuzzy checkpoint, without stopping any transaction.
+   * @param[out] active_txns the id of each running transaction and the LSN of its last log record
+   * @return the LSN of the oldest BEGIN record of the running transactions, INVALID_LSN if none was logged
+   */
+  lsn_t GetActiveTransactions(std::vector<std::pair<txn_id_t, lsn_t>> *active_txns);
 
-  /** Prevents all transactions from performing operations, used for checkpointing. */
-  void BlockAllTransactions();
+  /** Drop the row versions that no running transaction can see anymore. */
+  void GarbageCollect();
 
-  /** Resumes all transactions, used for checkpointing. */
-  void ResumeTransactions();
+  /** @return the store of the row versions replaced by recent writes */
+  VersionStore *GetVersionStore() { return &version_store_; }
 
  private:
   /**
@@ -99,14 +109,84 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    std::vector<table_oid_t> locked_tables;
+    for (const auto &[oid, mode] : *txn->GetTableLockSet()) {
+      locked_tables.push_back(oid);
+    }
+    for (auto oid : locked_tables) {
+      lock_manager_->UnlockTable(txn, oid);
+    }
   }
 
-  std::atomic<txn_id_t> next_txn_id_{0};
-  LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  /**
+   * Validate an OPTIMISTIC transaction and write its buffered updates and deletes to the heap and then to the
+   * indexes, under exclusive locks on the written rows and keys. Validation and installation in the heap run as
+   * one critical section for all OPTIMISTIC commits, so a transaction that reads a row another one writes can
+   * not commit next to it.
+   * @param txn the committing transaction
+   * @throws TransactionAbortException after aborting the transaction if it can not commit
+   */
+  void InstallBufferedWrites(Transaction *txn);
 
-  /** The global transaction latch is used for checkpointing. */
-  ReaderWriterLatch global_txn_latch_;
+  /**
+   * Finish the transaction's table writes in one batch per table, so that each page is latched once.
+   * @param txn the committing or aborting transaction
+   * @param commit true to apply the deletes of a commit, false to roll back every write of an abort
+   */
+  void FinishTableWrites(Transaction *txn, bool commit);
+
+  /**
+   * Roll back the transaction's index writes, one index at a time, each newest first.
+   * @param txn the aborting transaction
+   */
+  void RollbackIndexWrites(Transaction *txn);
+
+  /**
+   * Append a BEGIN, COMMIT or ABORT record for the transaction, if logging is enabled.
+   * @return the LSN of the record, INVALID_LSN if nothing was logged
+   */
+  lsn_t LogTransactionRecord(Transaction *txn, LogRecordType type);
+
+  /**
+   * Append the COMMIT or ABORT record of the transaction and unregister it, both at once for a checkpoint:
+   * a transaction is in the active transaction table exactly until its last record is appended.
+   * @return the LSN of the record, INVALID_LSN if nothing was logged
+   */
+  lsn_t LogEndRecord(Transaction *txn, LogRecordType type);
+
+  /** @return true if the read timestamp of the transaction must hold back garbage collection */
+  static bool HasSnapshot(Transaction *txn) {
+    return txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION ||
+           txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC;
+  }
+
+  /**
+   * Stop tracking the snapshot or the unversioned writes of a finished transaction, collecting garbage versions
+   * every VERSION_GC_INTERVAL finished transactions.
+   * @param txn the transaction that committed or aborted
+   */
+  void EndSnapshot(Transaction *txn);
+
+  std::atomic<txn_id_t> next_txn_id_{0};
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
+
+  /** Shared by the transactions logging their end, exclusive while a checkpoint collects the active ones. */
+  std::shared_mutex end_latch_;
+  /** Serializes the validation and installation of OPTIMISTIC commits. */
+  std::mutex validation_latch_;
+  /** Row versions for SNAPSHOT_ISOLATION readers. */
+  VersionStore version_store_;
+  /** Protects the timestamps, commits are stamped one at a time so that snapshots never see half a commit. */
+  std::mutex ts_latch_;
+  /** The commit timestamp of the last committed transaction. */
+  timestamp_t last_commit_ts_{0};
+  /** The read timestamps of the running SNAPSHOT_ISOLATION and OPTIMISTIC transactions. */
+  std::multiset<timestamp_t> active_snapshots_;
+  /** The running writers that record no versions, they began while no snapshot was taken. */
+  std::unordered_set<Transaction *> unversioned_writers_;
+  /** Transactions finished since the last garbage collection. */
+  int finished_since_gc_{0};
 };
 
 }  // namespace bustub
@@ -0,0 +1,117 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+class Transaction;
+
+/**
+ * TransactionRegistry maps the ids of the running transactions to the transactions.
+ *
+ * The registry is a fixed array of buckets, each a singly linked list of nodes. Lookups are lock-free:
+ * they only pin the current epoch while they walk a list. Inserts and removals lock a stripe of buckets,
+ * and a removed node is only freed once every lookup that might still be walking past it has finished.
+ *
+ * The epoch advances when no lookup of the previous epoch is left, so at any time lookups run in at
+ * most two epochs, and the nodes retired two epochs ago can no longer be reached by anyone.
+ */
+class TransactionRegistry {
+ public:
+  TransactionRegistry() = default;
+
+  ~TransactionRegistry();
+
+  DISALLOW_COPY_AND_MOVE(TransactionRegistry);
+
+  /**
+   * Register a transaction. A transaction registered later hides an older one with the same id.
+   * @param txn the transaction that begins
+   */
+  void Insert(Transaction *txn);
+
+  /**
+   * Unregister a transaction.
+   * @param txn the transaction that committed or aborted
+   */
+  void Remove(Transaction *txn);
+
+  /**
+   * @param txn_id the id of the transaction to find
+   * @return the running transaction with this id, nullptr if there is none
+   */
+  Transaction *Find(txn_id_t txn_id);
+
+  /** @return the number of registered transactions */
+  size_t Size();
+
+  /**
+   * Visit every registered transaction. A bucket is visited under its stripe latch, so a visited
+   * transaction cannot finish unregistering, and cannot be deleted, before the callback returns.
+   * The callback must not begin, commit or abort a transaction.
+   * @param callback called once for each registered transaction
+   */
+  void ForEach(const std::function<void(Transaction *)> &callback);
+
+ private:
+  static constexpr size_t BUCKET_COUNT = 1024;
+  static constexpr size_t LATCH_COUNT = 64;
+  /** Lookups run in the current or the previous epoch, the third one holds the nodes being freed. */
+  static constexpr size_t EPOCH_COUNT = 3;
+
+  struct Node {
+    txn_id_t txn_id_;
+    Transaction *txn_;
+    std::atomic<Node *> next_{nullptr};
+  };
+
+  /** The number of lookups running in an epoch, on its own cache line. */
+  struct alignas(64) ReaderCount {
+    std::atomic<int64_t> count_{0};
+  };
+
+  static size_t BucketOf(txn_id_t txn_id) { return static_cast<size_t>(txn_id) % BUCKET_COUNT; }
+
+  /** @return the epoch the calling lookup is counted in, until it calls ExitEpoch */
+  uint64_t EnterEpoch();
+
+  void ExitEpoch(uint64_t epoch) { readers_[epoch % EPOCH_COUNT].count_.fetch_sub(1); }
+
+  /** Free a node that is no longer linked, once no lookup can reach it. */
+  void Retire(Node *node);
+
+  /** Advance the epoch if the lookups of the previous one are done. The retire latch must be held. */
+  void TryAdvanceEpoch();
+
+  std::array<std::atomic<Node *>, BUCKET_COUNT> buckets_{};
+  /** Bucket i is changed under latches_[i % LATCH_COUNT]. */
+  std::array<std::mutex, LATCH_COUNT> latches_;
+
+  std::atomic<uint64_t> epoch_{0};
+  std::array<ReaderCount, EPOCH_COUNT> readers_;
+  std::mutex retire_latch_;
+  /** The nodes retired in each epoch, not freed yet. */
+  std::array<std::vector<Node *>, EPOCH_COUNT> retired_;
+};
+
+}  // namespace bustub
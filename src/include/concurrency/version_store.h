@@ -0,0 +1,165 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/concurrency/version_store.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * VersionStore keeps the older versions of rows for multi-version concurrency control.
+ *
+ * The table heap always holds the newest version of a row, committed or not. Before a transaction
+ * changes a row for the first time, the image it replaces is pushed onto the row's version chain,
+ * together with the commit timestamp of the transaction that wrote that image. A transaction under
+ * SNAPSHOT_ISOLATION reads the newest version committed at or before its read timestamp, walking the
+ * chain back from the heap, and never takes a lock to do so.
+ *
+ * Versions are registered while the table page is latched, and readers resolve the versions of a
+ * page under the same latch, so a reader never sees a heap image without the chain that explains it.
+ *
+ * Versions are only needed while a snapshot is taken. A writer that begins with none records nothing, until a
+ * snapshot begins and records the images its earlier writes replaced from its write set. The chains are
+ * partitioned by RID, like the lock table, so that writers to different rows do not contend.
+ */
+class VersionStore {
+ public:
+  VersionStore() = default;
+
+  DISALLOW_COPY_AND_MOVE(VersionStore);
+
+  /**
+   * Check that a transaction may write a row. Under SNAPSHOT_ISOLATION, a transaction may not write a row
+   * that another transaction committed after its snapshot was taken; the first committer wins.
+   * The caller must hold an exclusive lock on the row.
+   * @param txn the writing transaction, it is aborted on a conflict
+   * @param rid the row to be written
+   * @throws TransactionAbortException on a write conflict
+   */
+  void CheckWrite(Transaction *txn, const RID &rid);
+
+  /**
+   * Record the image a transaction's write replaces, if the transaction is versioned. Only the first write of a
+   * transaction to a row is recorded, later ones replace its own uncommitted image. The table page of the row must
+   * be write latched, and the transaction's write latch held.
+   * @param txn the writing transaction
+   * @param rid the row that is written
+   * @param old_tuple the image before the write, nullptr if the row did not exist (an insert)
+   */
+  void RecordWrite(Transaction *txn, const RID &rid, const Tuple *old_tuple);
+
+  /**
+   * Record the images replaced by the writes a transaction made before it became versioned, from its write set.
+   * The transaction's write latch must be held.
+   * @param txn the writing transaction, already versioned
+   */
+  void RecordWriteSet(Transaction *txn);
+
+  /**
+   * Replace the images read from a table page with the versions a transaction sees.
+   * The table page of the rows must be latched.
+   * @param txn the reading transaction
+   * @param rids the rows that were read
+   * @param[in,out] tuples the heap image of each row, replaced by its visible version
+   * @param[in,out] exists whether the heap holds an image of each row, replaced by whether a version is visible
+   */
+  void GetVisibleVersions(Transaction *txn, const std::vector<RID> &rids, std::vector<Tuple> *tuples,
+                          std::vector<bool> *exists);
+
+  /**
+   * Record the version of a row an OPTIMISTIC transaction read, and apply the transaction's own buffered
+   * write to the image. The table page of the row must be latched.
+   * @param txn the reading transaction
+   * @param rid the row that was read
+   * @param[in,out] tuple the heap image of the row, replaced by the buffered update if there is one
+   * @return false if the transaction has deleted the row
+   */
+  bool ReadOptimistic(Transaction *txn, const RID &rid, Tuple *tuple);
+
+  /**
+   * Check that none of the rows an OPTIMISTIC transaction read has changed since. The caller must hold
+   * exclusive locks on the rows the transaction writes.
+   * @param txn the committing transaction
+   * @return true if the transaction may commit
+   */
+  bool Validate(Transaction *txn);
+
+  /**
+   * Make a transaction's writes visible to the snapshots taken from now on.
+   * @param txn the committing transaction
+   * @param commit_ts the commit timestamp of the transaction
+   */
+  void Commit(Transaction *txn, timestamp_t commit_ts);
+
+  /**
+   * Forget the versions a transaction recorded. Called once the table heap has been rolled back.
+   * @param txn the aborting transaction
+   */
+  void Abort(Transaction *txn);
+
+  /**
+   * Drop the versions no snapshot can see anymore.
+   * @param watermark the oldest read timestamp of a running transaction, or the newest commit timestamp
+   */
+  void GarbageCollect(timestamp_t watermark);
+
+  /** @return the number of old versions kept */
+  size_t GetVersionCount();
+
+ private:
+  /** An image of a row, and the commit timestamp of the transaction that wrote it. */
+  struct Version {
+    Tuple tuple_;
+    bool exists_;
+    timestamp_t ts_;
+  };
+
+  /** The history of one row. The table heap holds the image after undo_.back(). */
+  struct VersionChain {
+    /** The transaction that wrote the heap image and has not committed yet, if any */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** The commit timestamp of the heap image, if it is committed */
+    timestamp_t ts_{0};
+    /** The images the heap image replaced, oldest first */
+    std::vector<Version> undo_;
+  };
+
+  /** A partition of the version chains, each one latched on its own. */
+  struct VersionShard {
+    std::shared_mutex latch_;
+    std::unordered_map<RID, VersionChain> chains_;
+  };
+
+  /**
+   * The version of a row as an OPTIMISTIC transaction sees it: the commit timestamp of the heap image, 0 for
+   * any image committed before the transaction began, or INVALID_TS while another transaction writes the row.
+   */
+  timestamp_t GetVersion(Transaction *txn, const RID &rid);
+
+  /** @return the shard of the version chains that rid belongs to */
+  VersionShard &ShardOf(const RID &rid) { return shards_[std::hash<RID>()(rid) % shards_.size()]; }
+
+  /** Version chains, partitioned by RID hash. */
+  std::array<VersionShard, VERSION_STORE_SHARDS> shards_;
+};
+
+}  // namespace bustub
@@ -18,6 +18,7 @@
 
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/index_write_batch.h"
 #include "execution/plans/delete_plan.h"
 #include "storage/table/tuple.h"
 
@@ -60,5 +61,9 @@ class DeleteExecutor : public AbstractExecutor {
   const DeletePlanNode *plan_;
   /** The child executor from which RIDs for deleted tuples are pulled */
   std::unique_ptr<AbstractExecutor> child_executor_;
+  /** Metadata identifying the table that should be deleted from */
+  TableInfo *table_info_;
+  /** The index changes of this statement, applied once all tuples are deleted */
+  std::unique_ptr<IndexWriteBatch> index_batch_;
 };
 }  // namespace bustub
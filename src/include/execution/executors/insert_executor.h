@@ -14,9 +14,11 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/index_write_batch.h"
 #include "execution/plans/insert_plan.h"
 #include "storage/table/tuple.h"
 
@@ -64,6 +66,10 @@ class InsertExecutor : public AbstractExecutor {
   TableInfo *table_info_;
   TableHeap *table_heap_;
   std::unique_ptr<AbstractExecutor> child_executor_;
+  /** The index changes of this statement, applied once all tuples are inserted */
+  std::unique_ptr<IndexWriteBatch> index_batch_;
+  /** RIDs whose locks are released after the index changes are applied (READ_COMMITTED only) */
+  std::vector<RID> unlock_rids_;
 };
 
 }  // namespace bustub
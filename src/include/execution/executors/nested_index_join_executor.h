@@ -18,6 +18,7 @@
 #include <utility>
 #include <vector>
 
+#include "catalog/catalog.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/expressions/abstract_expression.h"
@@ -48,7 +49,22 @@ class NestIndexJoinExecutor : public AbstractExecutor {
   bool Next(Tuple *tuple, RID *rid) override;
 
  private:
+  /**
+   * Probe the inner index with one outer tuple, and buffer the joined tuples it produces.
+   * Under SERIALIZABLE the probed key is locked first, so no other transaction can add a matching row.
+   * @param outer_tuple the tuple from the outer table
+   */
+  void ProbeInner(const Tuple &outer_tuple);
+
   /** The nested index join plan node. */
   const NestedIndexJoinPlanNode *plan_;
+  /** The outer table child. */
+  std::unique_ptr<AbstractExecutor> child_executor_;
+  /** The inner table. */
+  TableInfo *inner_table_info_;
+  /** The index on the inner table. */
+  IndexInfo *index_info_;
+  /** The joined tuples of the current outer tuple that are not returned yet. */
+  std::vector<Tuple> buffer_;
 };
 }  // namespace bustub
@@ -48,11 +48,22 @@ class SeqScanExecutor : public AbstractExecutor {
   const Schema *GetOutputSchema() override { return plan_->OutputSchema(); }
 
  private:
+  /**
+   * Yield the next tuple visible in the snapshot of a SNAPSHOT_ISOLATION transaction, one table page at a time.
+   * @param[out] tuple the next visible tuple
+   * @return `true` if a tuple was produced, `false` after the last page
+   */
+  bool NextSnapshotTuple(Tuple *tuple);
+
   /** The sequential scan plan node to be executed */
   const SeqScanPlanNode *plan_;
   // add
   TableInfo *table_info_;
   TableHeap *table_heap_;
   TableIterator iter_;
+  /** The next page to read under SNAPSHOT_ISOLATION, and the visible tuples of the page read last */
+  page_id_t snapshot_page_id_{INVALID_PAGE_ID};
+  std::vector<Tuple> snapshot_tuples_;
+  size_t snapshot_pos_{0};
 };
 }  // namespace bustub
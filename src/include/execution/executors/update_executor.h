@@ -18,6 +18,7 @@
 
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/index_write_batch.h"
 #include "execution/plans/update_plan.h"
 #include "storage/table/tuple.h"
 #include "type/value_factory.h"
@@ -66,11 +67,23 @@ class UpdateExecutor : public AbstractExecutor {
    */
   Tuple GenerateUpdatedTuple(const Tuple &src_tuple);
 
+  /**
+   * Compute the new value of one updated column.
+   * @param src_tuple The tuple to be updated
+   * @param col_idx The index of the updated column
+   * @param info The update applied to the column
+   */
+  Value UpdatedValue(const Tuple &src_tuple, uint32_t col_idx, const UpdateInfo &info);
+
   /** The update plan node to be executed */
   const UpdatePlanNode *plan_;
   /** Metadata identifying the table that should be updated */
   const TableInfo *table_info_;
   /** The child executor to obtain value from */
   std::unique_ptr<AbstractExecutor> child_executor_;
+  /** The index changes of this statement, applied once all tuples are updated */
+  std::unique_ptr<IndexWriteBatch> index_batch_;
+  /** True if only fixed-size columns are updated, so tuples keep their size and layout */
+  bool in_place_{false};
 };
 }  // namespace bustub
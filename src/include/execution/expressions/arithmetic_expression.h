@@ -0,0 +1,73 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// arithmetic_expression.h
+//
+// Identification: src/include/execution/expressions/arithmetic_expression.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "catalog/schema.h"
+#include "common/exception.h"
+#include "execution/expressions/abstract_expression.h"
+#include "storage/table/tuple.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/** ArithmeticType represents the arithmetic operation that we want to perform. */
+enum class ArithmeticType { Plus, Minus, Multiply };
+
+/**
+ * ArithmeticExpression represents two expressions combined by an arithmetic operation.
+ */
+class ArithmeticExpression : public AbstractExpression {
+ public:
+  /** Creates a new arithmetic expression representing (left arith_type right). */
+  ArithmeticExpression(const AbstractExpression *left, const AbstractExpression *right, ArithmeticType arith_type)
+      : AbstractExpression({left, right}, left->GetReturnType()), arith_type_{arith_type} {}
+
+  Value Evaluate(const Tuple *tuple, const Schema *schema) const override {
+    Value lhs = GetChildAt(0)->Evaluate(tuple, schema);
+    Value rhs = GetChildAt(1)->Evaluate(tuple, schema);
+    return PerformArithmetic(lhs, rhs);
+  }
+
+  Value EvaluateJoin(const Tuple *left_tuple, const Schema *left_schema, const Tuple *right_tuple,
+                     const Schema *right_schema) const override {
+    Value lhs = GetChildAt(0)->EvaluateJoin(left_tuple, left_schema, right_tuple, right_schema);
+    Value rhs = GetChildAt(1)->EvaluateJoin(left_tuple, left_schema, right_tuple, right_schema);
+    return PerformArithmetic(lhs, rhs);
+  }
+
+  Value EvaluateAggregate(const std::vector<Value> &group_bys, const std::vector<Value> &aggregates) const override {
+    Value lhs = GetChildAt(0)->EvaluateAggregate(group_bys, aggregates);
+    Value rhs = GetChildAt(1)->EvaluateAggregate(group_bys, aggregates);
+    return PerformArithmetic(lhs, rhs);
+  }
+
+ private:
+  Value PerformArithmetic(const Value &lhs, const Value &rhs) const {
+    switch (arith_type_) {
+      case ArithmeticType::Plus:
+        return lhs.Add(rhs);
+      case ArithmeticType::Minus:
+        return lhs.Subtract(rhs);
+      case ArithmeticType::Multiply:
+        return lhs.Multiply(rhs);
+      default:
+        throw NotImplementedException("Unsupported arithmetic type.");
+    }
+  }
+
+  ArithmeticType arith_type_;
+};
+}  // namespace bustub
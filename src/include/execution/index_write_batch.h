@@ -0,0 +1,105 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// index_write_batch.h
+//
+// Identification: src/include/execution/index_write_batch.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * IndexWriteBatch buffers the index changes made by one DML statement.
+ *
+ * The indexes of the target table are resolved once, when the batch is created. Every row
+ * the statement touches is recorded per index, and Apply() then walks the indexes one by one,
+ * deleting and inserting that index's keys in sorted order. The matching IndexWriteRecords
+ * are handed to the transaction only once the changes have been applied.
+ */
+class IndexWriteBatch {
+ public:
+  /**
+   * Construct a new IndexWriteBatch for a table.
+   * @param catalog The catalog that owns the table and its indexes
+   * @param table_info The table whose indexes are maintained
+   */
+  IndexWriteBatch(Catalog *catalog, const TableInfo *table_info);
+
+  /** @return `true` if the table has at least one index */
+  bool HasIndexes() const { return !indexes_.empty(); }
+
+  /**
+   * Buffer the index entries of a newly inserted tuple.
+   * @param tuple The inserted tuple, in the table schema
+   * @param rid The RID of the inserted tuple
+   */
+  void Insert(const Tuple &tuple, RID rid);
+
+  /**
+   * Buffer the removal of the index entries of a deleted tuple.
+   * @param tuple The deleted tuple, in the table schema
+   * @param rid The RID of the deleted tuple
+   */
+  void Delete(const Tuple &tuple, RID rid);
+
+  /**
+   * Buffer the replacement of the index entries of an updated tuple.
+   * Indexes whose key attributes were not changed by the update are left alone.
+   * @param old_tuple The tuple before the update
+   * @param new_tuple The tuple after the update
+   * @param rid The RID of the updated tuple
+   */
+  void Update(const Tuple &old_tuple, const Tuple &new_tuple, RID rid);
+
+  /**
+   * Apply all buffered changes and record them in the transaction's index write set.
+   * For each index, the deletions are applied before the insertions, each sorted by key.
+   * The keys of an index are locked in exclusive mode before any of them is changed, so that
+   * SERIALIZABLE probes of those keys see no phantom.
+   * @param txn The transaction performing the statement
+   * @param lock_mgr The lock manager, or nullptr to change the keys without locking them
+   */
+  void Apply(Transaction *txn, LockManager *lock_mgr);
+
+ private:
+  /** A key of one index together with the RID it maps to. */
+  using IndexEntry = std::pair<Tuple, RID>;
+
+  /** The buffered changes to a single index. */
+  struct PendingIndexWrites {
+    explicit PendingIndexWrites(IndexInfo *index_info) : index_info_(index_info) {}
+    /** The index the changes apply to */
+    IndexInfo *index_info_;
+    /** The write records, in the order the statement produced them */
+    std::vector<IndexWriteRecord> records_;
+  };
+
+  /** @return `true` if any key attribute of the index differs between the two tuples */
+  bool KeyChanged(const Tuple &old_tuple, const Tuple &new_tuple, const IndexInfo *index_info) const;
+
+  /** @return the key of `tuple` for the given index */
+  Tuple KeyOf(Tuple *tuple, const IndexInfo *index_info) const;
+
+  /** @return the order in which `entries` should be applied, i.e. sorted by key */
+  static std::vector<size_t> SortedOrder(const std::vector<IndexEntry> &entries, const Schema *key_schema);
+
+  Catalog *catalog_;
+  const TableInfo *table_info_;
+  std::vector<PendingIndexWrites> indexes_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,145 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// pipeline.h
+//
+// Identification: src/include/execution/pipeline/pipeline.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "common/macros.h"
+#include "execution/pipeline/tuple_batch.h"
+
+namespace bustub {
+
+/**
+ * PipelineSource produces the batches that enter a pipeline, e.g. by scanning a table
+ * or by reading the state that an earlier pipeline built.
+ */
+class PipelineSource {
+ public:
+  virtual ~PipelineSource() = default;
+
+  /** Prepare the source. Called once, after every pipeline this one depends on has finished. */
+  virtual void Init() {}
+
+  /**
+   * Produce the next batch.
+   * @param[out] batch The batch to fill, it is cleared first
+   * @return `true` if the batch holds at least one tuple, `false` if the source is exhausted or suspended
+   */
+  virtual bool Next(TupleBatch *batch) = 0;
+
+  /**
+   * Called after Next() returned `false`, to tell an exhausted source from one that waits for a page.
+   * A waiting source keeps its position, Next() continues from there once resume has been called.
+   * @param resume Called, possibly on another thread, once the source can make progress again
+   * @return `true` if the source is waiting and takes care of calling resume, `false` if it is exhausted
+   */
+  virtual bool Suspend(std::function<void()> &&resume) { return false; }
+};
+
+/**
+ * PipelineOperator transforms batches inside a pipeline without materializing its input,
+ * e.g. a hash join probe or a limit.
+ */
+class PipelineOperator {
+ public:
+  virtual ~PipelineOperator() = default;
+
+  /** Prepare the operator. Called once, before the first batch is pushed. */
+  virtual void Init() {}
+
+  /**
+   * Push a batch through the operator.
+   * @param input The batch produced by the previous stage
+   * @param[out] output The tuples passed on to the next stage, it is empty on entry
+   * @return `false` if the operator does not need any more input, `true` otherwise
+   */
+  virtual bool Execute(const TupleBatch &input, TupleBatch *output) = 0;
+};
+
+/**
+ * PipelineSink consumes the batches leaving a pipeline. A sink that has to see all of its input
+ * before producing anything (a hash join build, an aggregation) is a pipeline breaker.
+ */
+class PipelineSink {
+ public:
+  virtual ~PipelineSink() = default;
+
+  /** Prepare the sink. Called once, before the first batch is pushed. */
+  virtual void Init() {}
+
+  /**
+   * Consume a batch.
+   * @param batch The batch produced by the last operator of the pipeline
+   * @return `false` if the sink does not need any more input, `true` otherwise
+   */
+  virtual bool Sink(const TupleBatch &batch) = 0;
+
+  /** Called once the pipeline has pushed its last batch. */
+  virtual void Finalize() {}
+};
+
+/**
+ * A Pipeline is a source, a chain of operators and a sink. Running it is a tight loop that pulls
+ * a batch from the source and pushes it through every operator into the sink. A pipeline may only
+ * run once all the pipelines it depends on, i.e. whose sinks its source reads, have finished.
+ */
+class Pipeline {
+ public:
+  /**
+   * Construct a new Pipeline.
+   * @param source The source of the pipeline
+   */
+  explicit Pipeline(std::unique_ptr<PipelineSource> &&source) : source_(std::move(source)) {}
+
+  DISALLOW_COPY_AND_MOVE(Pipeline);
+
+  /** Append an operator to the end of the pipeline. */
+  void AddOperator(std::unique_ptr<PipelineOperator> &&op) { operators_.emplace_back(std::move(op)); }
+
+  /** Set the sink of the pipeline. */
+  void SetSink(std::unique_ptr<PipelineSink> &&sink) { sink_ = std::move(sink); }
+
+  /** Make this pipeline wait for another one to finish. */
+  void AddDependency(const Pipeline *pipeline) { dependencies_.push_back(pipeline); }
+
+  /** @return `true` if every pipeline this one depends on has finished */
+  bool IsReady() const;
+
+  /** @return `true` once the sink has been finalized */
+  bool IsFinished() const { return finished_; }
+
+  /**
+   * Push the source's batches through the pipeline, then finalize the sink. If the source has to wait
+   * for I/O, Run() returns early and has to be called again once resume has been called.
+   * @param resume Called when a suspended pipeline can continue
+   * @return `true` if the pipeline has finished, `false` if it was suspended
+   */
+  bool Run(const std::function<void()> &resume);
+
+ private:
+  std::unique_ptr<PipelineSource> source_;
+  std::vector<std::unique_ptr<PipelineOperator>> operators_;
+  std::unique_ptr<PipelineSink> sink_;
+  std::vector<const Pipeline *> dependencies_;
+  /** Whether the source, operators and sink have been initialized */
+  bool started_{false};
+  /** Whether an operator or the sink asked to stop */
+  bool stopped_{false};
+  std::atomic<bool> finished_{false};
+};
+
+}  // namespace bustub
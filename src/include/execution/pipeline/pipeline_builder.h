@@ -0,0 +1,79 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// pipeline_builder.h
+//
+// Identification: src/include/execution/pipeline/pipeline_builder.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "execution/executor_context.h"
+#include "execution/pipeline/pipeline.h"
+#include "execution/pipeline/pipeline_operators.h"
+#include "execution/plans/abstract_plan.h"
+
+namespace bustub {
+
+/**
+ * PipelineBuilder splits a query plan into pipelines at its pipeline breakers.
+ *
+ * A hash join ends the pipeline of its left child with a build sink and continues the pipeline
+ * of its right child with a probe. An aggregation ends the pipeline of its child and starts a new
+ * one that reads the groups. Distinct and limit are streamed. Every other plan node becomes the
+ * source of a pipeline through its Volcano executor.
+ *
+ * With late materialization, a table scanned on the probe side of a hash join only computes the
+ * columns its predicate and the join key need. The other columns are read by RID, page by page,
+ * for the rows that found a join partner.
+ */
+class PipelineBuilder {
+ public:
+  /**
+   * @param exec_ctx The executor context the pipelines run in
+   * @param late_materialization Whether probe side scans defer their payload columns
+   * @param page_reader The reader table scans prefetch their pages with, may be `nullptr`
+   */
+  explicit PipelineBuilder(ExecutorContext *exec_ctx, bool late_materialization = false,
+                           AsyncPageReader *page_reader = nullptr)
+      : exec_ctx_(exec_ctx), late_materialization_(late_materialization), page_reader_(page_reader) {}
+
+  /**
+   * Split a plan into pipelines.
+   * @param plan The root of the query plan
+   * @param result_set The set the output of the last pipeline is appended to, may be `nullptr`
+   * @return The pipelines, in an order in which every pipeline comes after its dependencies
+   */
+  std::vector<std::unique_ptr<Pipeline>> Build(const AbstractPlanNode *plan, std::vector<Tuple> *result_set);
+
+ private:
+  /** @return the pipeline that produces the output of plan, still without a sink */
+  Pipeline *BuildPipeline(const AbstractPlanNode *plan);
+
+  /** @return a new pipeline starting at source */
+  Pipeline *NewPipeline(std::unique_ptr<PipelineSource> &&source);
+
+  /**
+   * Build the probe pipeline of a hash join whose right child is a table scan, deferring the
+   * scan's columns that are not needed to find the join partners.
+   * @return the probe pipeline, or `nullptr` if the join needs every column of the scan
+   */
+  Pipeline *BuildLateMaterializedProbe(const HashJoinPlanNode *join_plan, const std::shared_ptr<HashJoinState> &state);
+
+  /** Mark the columns that expr reads in required. */
+  static void CollectColumns(const AbstractExpression *expr, std::vector<bool> *required);
+
+  ExecutorContext *exec_ctx_;
+  bool late_materialization_;
+  AsyncPageReader *page_reader_;
+  std::vector<std::unique_ptr<Pipeline>> pipelines_;
+};
+
+}  // namespace bustub
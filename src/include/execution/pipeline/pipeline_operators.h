@@ -0,0 +1,238 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// pipeline_operators.h
+//
+// Identification: src/include/execution/pipeline/pipeline_operators.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "buffer/async_page_reader.h"
+#include "execution/executor_context.h"
+#include "execution/executors/abstract_executor.h"
+#include "execution/executors/aggregation_executor.h"
+#include "execution/executors/distinct_executor.h"
+#include "execution/executors/hash_join_executor.h"
+#include "execution/pipeline/pipeline.h"
+#include "execution/plans/aggregation_plan.h"
+#include "execution/plans/distinct_plan.h"
+#include "execution/plans/hash_join_plan.h"
+#include "execution/plans/limit_plan.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "storage/table/table_heap.h"
+
+namespace bustub {
+
+/**
+ * SeqScanSource scans a table one page at a time, applying the plan's predicate and projection,
+ * and takes the same row locks as the SeqScanExecutor.
+ *
+ * With an AsyncPageReader, the next page is prefetched as soon as a page has been copied. If the
+ * scan catches up with a read that is still in flight, it suspends instead of blocking on the disk.
+ */
+class SeqScanSource : public PipelineSource {
+ public:
+  /**
+   * @param exec_ctx The executor context the scan runs in
+   * @param plan The sequential scan plan
+   * @param page_reader The reader used to prefetch pages, `nullptr` to read them synchronously
+   */
+  SeqScanSource(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan, AsyncPageReader *page_reader = nullptr);
+
+  /**
+   * Only compute some of the output columns, the others are left NULL. The columns the
+   * predicate refers to must be among them. A later MaterializeOperator can fill in the rest.
+   * @param required For each column of the output schema, whether it is computed
+   */
+  void SetRequiredColumns(std::vector<bool> &&required) { required_ = std::move(required); }
+
+  void Init() override;
+
+  bool Next(TupleBatch *batch) override;
+
+  bool Suspend(std::function<void()> &&resume) override;
+
+ private:
+  /** Copy the live tuples of the next page. @return `false` if the page is still being read */
+  bool LoadNextPage();
+
+  ExecutorContext *exec_ctx_;
+  const SeqScanPlanNode *plan_;
+  AsyncPageReader *page_reader_;
+  const TableInfo *table_info_{nullptr};
+  /** The tuples of the current page, and the position of the next one to scan */
+  std::vector<Tuple> page_tuples_;
+  size_t page_pos_{0};
+  page_id_t next_page_id_{INVALID_PAGE_ID};
+  /** Whether the scan stopped at a page that is still being read */
+  bool waiting_{false};
+  /** The output columns to compute, empty if all of them are */
+  std::vector<bool> required_;
+};
+
+/**
+ * MaterializeOperator re-reads the rows of a late materialized scan by RID and
+ * computes all of the scan's output columns. Each batch is read page by page.
+ */
+class MaterializeOperator : public PipelineOperator {
+ public:
+  MaterializeOperator(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan);
+
+  void Init() override;
+
+  bool Execute(const TupleBatch &input, TupleBatch *output) override;
+
+ private:
+  ExecutorContext *exec_ctx_;
+  const SeqScanPlanNode *plan_;
+  const TableInfo *table_info_{nullptr};
+};
+
+/**
+ * ExecutorSource drains a Volcano executor tree. It lets the push engine run any plan
+ * it cannot split into pipelines itself, e.g. DML and nested loop joins.
+ */
+class ExecutorSource : public PipelineSource {
+ public:
+  ExecutorSource(ExecutorContext *exec_ctx, const AbstractPlanNode *plan);
+
+  void Init() override;
+
+  bool Next(TupleBatch *batch) override;
+
+ private:
+  ExecutorContext *exec_ctx_;
+  const AbstractPlanNode *plan_;
+  std::unique_ptr<AbstractExecutor> executor_;
+  bool exhausted_{false};
+};
+
+/** The hash table built by a hash join's build pipeline and probed by its probe pipeline. */
+struct HashJoinState {
+  std::unordered_map<HashJoinKey, std::vector<Tuple>> ht_;
+};
+
+/** HashJoinBuildSink inserts the left input of a hash join into the join hash table. */
+class HashJoinBuildSink : public PipelineSink {
+ public:
+  HashJoinBuildSink(const HashJoinPlanNode *plan, std::shared_ptr<HashJoinState> state);
+
+  bool Sink(const TupleBatch &batch) override;
+
+ private:
+  const HashJoinPlanNode *plan_;
+  std::shared_ptr<HashJoinState> state_;
+};
+
+/** HashJoinFilterOperator drops the tuples of a hash join's right input that have no match in the hash table. */
+class HashJoinFilterOperator : public PipelineOperator {
+ public:
+  HashJoinFilterOperator(const HashJoinPlanNode *plan, std::shared_ptr<HashJoinState> state);
+
+  bool Execute(const TupleBatch &input, TupleBatch *output) override;
+
+ private:
+  const HashJoinPlanNode *plan_;
+  std::shared_ptr<HashJoinState> state_;
+};
+
+/** HashJoinProbeOperator joins its input, the right side of a hash join, against the built hash table. */
+class HashJoinProbeOperator : public PipelineOperator {
+ public:
+  HashJoinProbeOperator(const HashJoinPlanNode *plan, std::shared_ptr<HashJoinState> state);
+
+  bool Execute(const TupleBatch &input, TupleBatch *output) override;
+
+ private:
+  const HashJoinPlanNode *plan_;
+  std::shared_ptr<HashJoinState> state_;
+};
+
+/** The groups built by an aggregation's input pipeline and read by its output pipeline. */
+struct AggregationState {
+  explicit AggregationState(const AggregationPlanNode *plan)
+      : ht_(plan->GetAggregates(), plan->GetAggregateTypes()) {}
+  SimpleAggregationHashTable ht_;
+};
+
+/** AggregationSink combines its input into the aggregation hash table. */
+class AggregationSink : public PipelineSink {
+ public:
+  AggregationSink(const AggregationPlanNode *plan, std::shared_ptr<AggregationState> state);
+
+  bool Sink(const TupleBatch &batch) override;
+
+ private:
+  const AggregationPlanNode *plan_;
+  std::shared_ptr<AggregationState> state_;
+};
+
+/** AggregationSource emits the groups of a finished aggregation that satisfy its HAVING clause. */
+class AggregationSource : public PipelineSource {
+ public:
+  AggregationSource(const AggregationPlanNode *plan, std::shared_ptr<AggregationState> state);
+
+  void Init() override;
+
+  bool Next(TupleBatch *batch) override;
+
+ private:
+  const AggregationPlanNode *plan_;
+  std::shared_ptr<AggregationState> state_;
+  std::optional<SimpleAggregationHashTable::Iterator> iter_;
+};
+
+/** DistinctOperator drops every tuple it has already passed on. */
+class DistinctOperator : public PipelineOperator {
+ public:
+  explicit DistinctOperator(const DistinctPlanNode *plan);
+
+  void Init() override;
+
+  bool Execute(const TupleBatch &input, TupleBatch *output) override;
+
+ private:
+  const DistinctPlanNode *plan_;
+  std::unordered_set<DistinctKey> seen_;
+};
+
+/** LimitOperator passes on the first `limit` tuples and then stops the pipeline. */
+class LimitOperator : public PipelineOperator {
+ public:
+  explicit LimitOperator(const LimitPlanNode *plan);
+
+  void Init() override;
+
+  bool Execute(const TupleBatch &input, TupleBatch *output) override;
+
+ private:
+  const LimitPlanNode *plan_;
+  size_t remaining_{0};
+};
+
+/** ResultSink collects the output of a query's last pipeline. */
+class ResultSink : public PipelineSink {
+ public:
+  /** @param result_set The vector the tuples are appended to, may be `nullptr` */
+  explicit ResultSink(std::vector<Tuple> *result_set) : result_set_(result_set) {}
+
+  bool Sink(const TupleBatch &batch) override;
+
+ private:
+  std::vector<Tuple> *result_set_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,66 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_batch.h
+//
+// Identification: src/include/execution/pipeline/tuple_batch.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * TupleBatch is the unit of work that flows through a pipeline: up to
+ * PIPELINE_BATCH_SIZE tuples, each with the RID it was read from.
+ */
+class TupleBatch {
+ public:
+  TupleBatch() {
+    tuples_.reserve(PIPELINE_BATCH_SIZE);
+    rids_.reserve(PIPELINE_BATCH_SIZE);
+  }
+
+  /** Append a tuple and its RID to the batch. */
+  void Append(const Tuple &tuple, const RID &rid) {
+    tuples_.push_back(tuple);
+    rids_.push_back(rid);
+  }
+
+  /** @return the number of tuples in the batch */
+  size_t Size() const { return tuples_.size(); }
+
+  /** @return `true` if the batch holds no tuple */
+  bool IsEmpty() const { return tuples_.empty(); }
+
+  /** @return `true` if a source should stop adding tuples to the batch */
+  bool IsFull() const { return tuples_.size() >= static_cast<size_t>(PIPELINE_BATCH_SIZE); }
+
+  /** @return the tuple at position idx */
+  const Tuple &GetTuple(size_t idx) const { return tuples_[idx]; }
+
+  /** @return the RID of the tuple at position idx */
+  const RID &GetRid(size_t idx) const { return rids_[idx]; }
+
+  /** Remove every tuple from the batch, keeping the allocated capacity. */
+  void Clear() {
+    tuples_.clear();
+    rids_.clear();
+  }
+
+ private:
+  std::vector<Tuple> tuples_;
+  std::vector<RID> rids_;
+};
+
+}  // namespace bustub
@@ -21,13 +21,17 @@
 namespace bustub {
 
 /** The UpdateType enumeration describes the supported update operations */
-enum class UpdateType { Add, Set };
+enum class UpdateType { Add, Set, Expression };
 
 /** Metadata about an Update. */
 struct UpdateInfo {
+  /** Add the integer `update_val` to the column, or set the column to it. */
   UpdateInfo(UpdateType type, int update_val) : type_{type}, update_val_{update_val} {}
+  /** Set the column to `expr`, evaluated against the tuple before the update. */
+  explicit UpdateInfo(const AbstractExpression *expr) : type_{UpdateType::Expression}, update_val_{0}, expr_{expr} {}
   UpdateType type_;
   int update_val_;
+  const AbstractExpression *expr_{nullptr};
 };
 
 /**
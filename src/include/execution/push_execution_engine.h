@@ -0,0 +1,111 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// push_execution_engine.h
+//
+// Identification: src/include/execution/push_execution_engine.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "buffer/async_page_reader.h"
+#include "buffer/buffer_pool_manager.h"
+#include "catalog/catalog.h"
+#include "common/thread_pool.h"
+#include "concurrency/transaction_manager.h"
+#include "execution/executor_context.h"
+#include "execution/pipeline/pipeline.h"
+#include "execution/plans/abstract_plan.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * The PushExecutionEngine executes query plans as push-based pipelines.
+ *
+ * The plan is split into pipelines by a PipelineBuilder, and every pipeline runs as a task
+ * on a thread pool shared by all queries. The pipelines of one query run one after another:
+ * the Transaction a query executes in is not safe to use from several threads at once.
+ *
+ * Given an AsyncPageReader, table scans prefetch their pages on its I/O threads. A pipeline whose
+ * scan reaches a page that is still being read gives its worker back to the pool, and is submitted
+ * again once the read completes, so that the worker can run other queries in the meantime.
+ */
+class PushExecutionEngine {
+ public:
+  /**
+   * Construct a new PushExecutionEngine instance.
+   * @param bpm The buffer pool manager used by the execution engine
+   * @param txn_mgr The transaction manager used by the execution engine
+   * @param catalog The catalog used by the execution engine
+   * @param thread_pool The thread pool the pipelines are scheduled on
+   * @param late_materialization Whether scans defer the columns they do not need (see PipelineBuilder)
+   * @param page_reader The reader table scans prefetch their pages with, `nullptr` to read them synchronously
+   */
+  PushExecutionEngine(BufferPoolManager *bpm, TransactionManager *txn_mgr, Catalog *catalog, ThreadPool *thread_pool,
+                      bool late_materialization = false, AsyncPageReader *page_reader = nullptr)
+      : bpm_{bpm},
+        txn_mgr_{txn_mgr},
+        catalog_{catalog},
+        thread_pool_{thread_pool},
+        late_materialization_{late_materialization},
+        page_reader_{page_reader} {}
+
+  DISALLOW_COPY_AND_MOVE(PushExecutionEngine);
+
+  /**
+   * Execute a query plan, blocking until its last pipeline has finished.
+   * Exceptions thrown by a pipeline are rethrown to the caller.
+   * @param plan The query plan to execute
+   * @param result_set The set of tuples produced by executing the plan
+   * @param txn The transaction context in which the query executes
+   * @param exec_ctx The executor context in which the query executes
+   * @return `true` if execution of the query plan succeeds, `false` otherwise
+   */
+  bool Execute(const AbstractPlanNode *plan, std::vector<Tuple> *result_set, Transaction *txn,
+               ExecutorContext *exec_ctx);
+
+ private:
+  /** The pipelines of a query that is being executed. */
+  struct QueryRun {
+    std::vector<std::unique_ptr<Pipeline>> pipelines_;
+    std::mutex latch_;
+    std::condition_variable cv_;
+    bool done_{false};
+    std::exception_ptr error_;
+  };
+
+  /** Submit the next pipeline of a query to the thread pool, or wake up its caller if there is none. */
+  void ScheduleNext(QueryRun *run);
+
+  /** Submit a pipeline to the thread pool, to start it or to resume it after it was suspended. */
+  void Submit(QueryRun *run, Pipeline *pipeline);
+
+  /** Mark a query as done and wake up its caller. */
+  static void Finish(QueryRun *run, std::exception_ptr error);
+
+  /** The buffer pool manager used during query execution */
+  [[maybe_unused]] BufferPoolManager *bpm_;
+  /** The transaction manager used during query execution */
+  [[maybe_unused]] TransactionManager *txn_mgr_;
+  /** The catalog used during query execution */
+  [[maybe_unused]] Catalog *catalog_;
+  /** The thread pool the pipelines run on */
+  ThreadPool *thread_pool_;
+  /** Whether scans defer the columns they do not need */
+  bool late_materialization_;
+  /** The reader table scans prefetch their pages with */
+  AsyncPageReader *page_reader_;
+};
+
+}  // namespace bustub
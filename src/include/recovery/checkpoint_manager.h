@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +21,9 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager takes ARIES-style fuzzy checkpoints. Transactions keep running: a checkpoint only logs the
+ * active transaction table and the dirty page table as they were around its begin record, and recovery starts
+ * its analysis from that record. Once the end record is durable, the master record points recovery at it.
  */
 class CheckpointManager {
  public:
@@ -31,13 +35,19 @@ class CheckpointManager {
 
   ~CheckpointManager() = default;
 
+  /** Take a checkpoint, logging a CHECKPOINT_BEGIN and a CHECKPOINT_END record. */
   void BeginCheckpoint();
+  /** Complete the checkpoint. Nothing was blocked, so there is nothing to resume. */
   void EndCheckpoint();
 
+  /** @return the LSN of the begin record of the last checkpoint, INVALID_LSN if none was taken */
+  lsn_t GetLastCheckpointLSN() { return last_checkpoint_lsn_; }
+
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  std::atomic<lsn_t> last_checkpoint_lsn_{INVALID_LSN};
 };
 
 }  // namespace bustub
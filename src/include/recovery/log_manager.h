@@ -13,9 +13,14 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
+#include <deque>
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <utility>
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
@@ -23,52 +28,157 @@
 namespace bustub {
 
 /**
- * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
- * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ * The master record points recovery at the last complete checkpoint. Recovery reads the log from scan_offset on,
+ * and starts its analysis at the checkpoint's begin record.
+ */
+struct MasterRecord {
+  /** The LSN of the begin record of the checkpoint. */
+  lsn_t checkpoint_lsn_;
+  /** The oldest record recovery may need, no later than the begin record. */
+  lsn_t scan_lsn_;
+  /** The offset in the log of a record at or before scan_lsn_. */
+  int64_t scan_offset_;
+};
+
+/**
+ * LogManager appends log records to an in-memory log buffer and writes them to the disk log file from a
+ * background flush thread.
+ *
+ * There are two buffers. Transactions append to one while the flush thread writes the other, and the thread
+ * swaps them when the log buffer fills up, when log_timeout passes, or when someone forces a flush. A
+ * committing transaction forces a flush and waits until its commit record is durable; every transaction that
+ * committed while the previous write was under way is covered by the same write.
+ *
+ * Appending takes no lock. A single compare-and-swap on one word reserves the next LSN together with the
+ * room for the record in the current buffer, then the record is copied into its room while other threads
+ * copy theirs. The flush thread seals a buffer by switching the word to the other buffer, and waits for the
+ * copies into the sealed buffer that are still under way before it writes the buffer out.
+ *
+ * LSNs are dense, they do not tell where a record is in the log file. The log manager remembers where each
+ * buffer since the last checkpoint starts, so that the master record can point recovery at the right offset.
  */
 class LogManager {
  public:
-  explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
+  explicit LogManager(DiskManager *disk_manager) : persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+    for (auto &buffer : buffers_) {
+      buffer = new char[LOG_BUFFER_SIZE];
+    }
+    buffer_starts_.emplace_back(0, disk_manager_->GetLogSize());
   }
 
   ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
+    StopFlushThread();
+    for (auto &buffer : buffers_) {
+      delete[] buffer;
+      buffer = nullptr;
+    }
   }
 
+  /** Set enable_logging and start the flush thread. */
   void RunFlushThread();
+  /** Write out the log buffer, stop the flush thread and clear enable_logging. */
   void StopFlushThread();
 
+  /**
+   * Append a log record to the log buffer, waiting for the flush thread to make room if it is full.
+   * @param log_record the record, its LSN is set
+   * @return the LSN assigned to the record
+   */
   lsn_t AppendLogRecord(LogRecord *log_record);
 
-  inline lsn_t GetNextLSN() { return next_lsn_; }
+  /**
+   * Block until every log record up to lsn is durable, forcing a flush if it is not yet.
+   * Without a flush thread, the log buffer is written out by the caller.
+   * @param lsn the LSN that has to be durable
+   */
+  void Flush(lsn_t lsn);
+
+  /**
+   * Point recovery at a checkpoint, once its end record is durable, and release the log segments it no longer needs.
+   * @param checkpoint_lsn the LSN of the begin record of the checkpoint
+   * @param scan_lsn the oldest record recovery may need, see MasterRecord
+   */
+  void WriteMasterRecord(lsn_t checkpoint_lsn, lsn_t scan_lsn);
+
+  /**
+   * Continue a log recovered from disk. Only allowed before anything is appended.
+   * @param next_lsn the LSN of the next record
+   * @param log_size the end of the last complete record in the log, the next record is written there
+   */
+  void SetLogEnd(lsn_t next_lsn, int64_t log_size);
+
+  inline lsn_t GetNextLSN() { return static_cast<lsn_t>(reservation_.load() >> LSN_SHIFT); }
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
-  inline char *GetLogBuffer() { return log_buffer_; }
+  inline char *GetLogBuffer() { return buffers_[BufferOf(reservation_.load())]; }
 
  private:
-  // TODO(students): you may add your own member variables
+  /*
+   * The reservation word holds the next LSN in its high 32 bits, the buffer records are appended to in
+   * bit 31, and the number of bytes reserved in that buffer in the low bits.
+   */
+  static constexpr uint64_t LSN_SHIFT = 32;
+  static constexpr uint64_t BUFFER_BIT = 1ULL << 31;
+  static constexpr uint64_t OFFSET_MASK = BUFFER_BIT - 1;
+
+  static size_t BufferOf(uint64_t reservation) { return (reservation & BUFFER_BIT) != 0 ? 1 : 0; }
+
+  /** @return whether a record of size bytes fits in the current buffer */
+  bool HasRoom(int32_t size) {
+    return (reservation_.load() & OFFSET_MASK) + static_cast<uint64_t>(size) <= LOG_BUFFER_SIZE;
+  }
 
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /** Block until a record of size bytes may fit in the current buffer, writing it out if needed. */
+  void WaitForRoom(int32_t size);
+
+  /** The body of the flush thread. */
+  void FlushLoop();
+
+  /**
+   * Seal the current buffer and write out its records. latch_ must be held through lock, it is released
+   * during the write if unlock_for_write is true; only one write may be under way at a time, so a caller
+   * other than the flush thread must first wait for write_in_progress_ to clear.
+   */
+  void WriteLogBuffer(std::unique_lock<std::mutex> *lock, bool unlock_for_write);
+
+  /** The next LSN, the current buffer and the bytes reserved in it, see LSN_SHIFT. */
+  std::atomic<uint64_t> reservation_{0};
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
-  char *log_buffer_;
-  char *flush_buffer_;
+  /** The two log buffers, one is appended to while the other one is written out. */
+  std::array<char *, 2> buffers_;
+  /** The number of bytes copied into each buffer, a sealed buffer is complete once it reaches the reserved size. */
+  std::array<std::atomic<uint64_t>, 2> filled_{};
 
+  /** Serializes the writes, and protects the flags and the buffer starts below. */
   std::mutex latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
-
+  /**
+   * The first LSN and the offset in the log file of each buffer written since the scan LSN of the last
+   * checkpoint, oldest first. The last one is the buffer being appended to.
+   */
+  std::deque<std::pair<lsn_t, int64_t>> buffer_starts_;
+
+  std::thread *flush_thread_{nullptr};
+  /** Whether the flush thread keeps running. */
+  bool flush_thread_running_{false};
+  /** Whether someone waits for the log buffer to be written out before log_timeout. */
+  bool flush_requested_{false};
+  /**
+   * Whether the flush thread is writing a buffer with latch_ released. It may still be when it is told to stop,
+   * and a caller that writes on its own must not seal the other buffer meanwhile.
+   */
+  bool write_in_progress_{false};
+
+  /** Wakes the flush thread. */
   std::condition_variable cv_;
+  /** Wakes the appenders waiting for room in the log buffer. */
+  std::condition_variable append_cv_;
+  /** Wakes the transactions waiting for their records to become durable. */
+  std::condition_variable flushed_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
@@ -13,7 +13,10 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,31 +35,54 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** The start of a fuzzy checkpoint. */
+  CHECKPOINT_BEGIN,
+  /** The end of a fuzzy checkpoint, with the tables collected since its start. */
+  CHECKPOINT_END,
+  /** A compensation log record, the change that rolled back an earlier record. */
+  CLR,
 };
 
 /**
  * For every write operation on the table page, you should write ahead a corresponding log record.
  *
- * For EACH log record, HEADER is like (5 fields in common, 20 bytes in total).
+ * Most fields are varints, 7 bits per byte, low bits first, the high bit set on every byte but the last. Ids and
+ * LSNs are stored plus one, so that INVALID is 0. The LSN is the one fixed field, 4 bytes: it is assigned in the
+ * same step that reserves the room for the record, so the size of the record can not depend on it. The size
+ * counts every byte of the record, its own included. LogType is a single byte.
+ *
+ * For EACH log record, HEADER is like (5 fields in common, 8 to 20 bytes in total).
  *---------------------------------------------
  * | size | LSN | transID | prevLSN | LogType |
  *---------------------------------------------
+ * A tuple_rid is | page_id | slot_num |, a tuple is | tuple_size | tuple_data(char[] array) |
  * For insert type log record
- *---------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
- *---------------------------------------------------------------
+ *------------------------------
+ * | HEADER | tuple_rid | tuple |
+ *------------------------------
  * For delete type (including markdelete, rollbackdelete, applydelete)
- *----------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
- *---------------------------------------------------------------
- * For update type log record
- *-----------------------------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
- *-----------------------------------------------------------------------------------
+ *------------------------------
+ * | HEADER | tuple_rid | tuple |
+ *------------------------------
+ * For update type log record, only the byte ranges the update changed, each with its old and its new bytes.
+ * Redo and undo apply them to the tuple the page holds, see ApplyUpdate
+ *-------------------------------------------------------------------------------------------------
+ * | HEADER | tuple_rid | range_count | (gap, old_size, new_size, old_data, new_data) * range_count |
+ *-------------------------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *------------------------------------
+ * For checkpoint begin type log record, the header alone.
+ * For checkpoint end type log record, prevLSN is the LSN of the checkpoint begin record
+ *---------------------------------------------------------------------------------------------------
+ * | HEADER | txn_count | (txn_id, last_lsn) * txn_count | page_count | (page_id, rec_lsn) * page_count |
+ *---------------------------------------------------------------------------------------------------
+ * For compensation log record, undo_lsn is the LSN of the record it rolls back, and the body of the change
+ * (an INSERT, a delete type or an UPDATE) follows as in a record of that type
+ *-------------------------------------------------------
+ * | HEADER | undo_lsn | action LogType | action body |
+ *-------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
@@ -67,7 +93,9 @@ class LogRecord {
 
   // constructor for Transaction type(BEGIN/COMMIT/ABORT)
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type)
-      : size_(HEADER_SIZE), txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {
+    ComputeSize();
+  }
 
   // constructor for INSERT/DELETE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &rid, const Tuple &tuple)
@@ -81,8 +109,7 @@ class LogRecord {
       delete_rid_ = rid;
       delete_tuple_ = tuple;
     }
-    // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
+    ComputeSize();
   }
 
   // constructor for UPDATE type
@@ -93,21 +120,38 @@ class LogRecord {
         log_record_type_(log_record_type),
         update_rid_(update_rid),
         old_tuple_(old_tuple),
-        new_tuple_(new_tuple) {
-    // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
+        new_tuple_(new_tuple),
+        update_ranges_(DiffTuples(old_tuple, new_tuple)) {
+    ComputeSize();
   }
 
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
-      : size_(HEADER_SIZE),
-        txn_id_(txn_id),
+      : txn_id_(txn_id),
         prev_lsn_(prev_lsn),
         log_record_type_(log_record_type),
         prev_page_id_(prev_page_id),
         page_id_(page_id) {
-    // calculate log record size, header size + sizeof(prev_page_id) + sizeof(page_id)
-    size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
+    ComputeSize();
+  }
+
+  // constructor for CHECKPOINT_END type
+  LogRecord(lsn_t begin_lsn, std::vector<std::pair<txn_id_t, lsn_t>> active_txns,
+            std::vector<std::pair<page_id_t, lsn_t>> dirty_pages)
+      : txn_id_(INVALID_TXN_ID),
+        prev_lsn_(begin_lsn),
+        log_record_type_(LogRecordType::CHECKPOINT_END),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    ComputeSize();
+  }
+
+  // constructor for CLR type, action is the record of the change that rolls back the record undo_lsn
+  LogRecord(lsn_t undo_lsn, LogRecord action) : LogRecord(std::move(action)) {
+    action_type_ = log_record_type_;
+    log_record_type_ = LogRecordType::CLR;
+    undo_lsn_ = undo_lsn;
+    ComputeSize();
   }
 
   ~LogRecord() = default;
@@ -120,6 +164,7 @@ class LogRecord {
 
   inline RID &GetInsertRID() { return insert_rid_; }
 
+  /** The tuples of an UPDATE record are only known to the record that was constructed, not to one read back. */
   inline Tuple &GetOriginalTuple() { return old_tuple_; }
 
   inline Tuple &GetUpdateTuple() { return new_tuple_; }
@@ -128,6 +173,16 @@ class LogRecord {
 
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline page_id_t GetNewPageId() { return page_id_; }
+
+  inline std::vector<std::pair<txn_id_t, lsn_t>> &GetActiveTxns() { return active_txns_; }
+
+  inline std::vector<std::pair<page_id_t, lsn_t>> &GetDirtyPages() { return dirty_pages_; }
+
+  inline lsn_t GetUndoLSN() { return undo_lsn_; }
+
+  inline LogRecordType GetActionType() { return action_type_; }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -138,6 +193,40 @@ class LogRecord {
 
   inline LogRecordType &GetLogRecordType() { return log_record_type_; }
 
+  /**
+   * Replay the byte ranges an UPDATE record, or a CLR of an update, changed.
+   * @param tuple the tuple as the update found it, or as it left it if undo is true
+   * @param undo whether to turn the updated tuple back into the old one
+   * @param[out] result the tuple as the update left it, or as it found it if undo is true
+   * @return false if tuple is not the one the update changed
+   */
+  bool ApplyUpdate(const Tuple &tuple, bool undo, Tuple *result) const;
+
+  /**
+   * Serialize the record, its LSN already set.
+   * @param[out] dest where the size bytes of the record go
+   */
+  void SerializeTo(char *dest) const;
+
+  /**
+   * Deserialize a record.
+   * @param data the serialized record, all of its size bytes are readable
+   * @return false if data does not hold a well-formed record
+   */
+  bool DeserializeFrom(const char *data);
+
+  /**
+   * Read the size of a serialized record, the first field.
+   * @param data the serialized record
+   * @param available the number of bytes readable at data, the size is read from at most MAX_SIZE_BYTES of them
+   * @param[out] size the size of the record
+   * @return false if the bytes do not start with a size a record may have
+   */
+  static bool ReadSize(const char *data, int32_t available, int32_t *size);
+
+  /** The number of bytes the size of a record may take. */
+  static constexpr int32_t MAX_SIZE_BYTES = 5;
+
   // For debug purpose
   inline std::string ToString() const {
     std::ostringstream os;
@@ -176,7 +265,36 @@ class LogRecord {
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
-  static const int HEADER_SIZE = 20;
+
+  // case5: for checkpoint end, the active transaction table and the dirty page table
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+
+  // case6: for compensation, the record rolled back and the type of the change, its body is in case 1 to 3
+  lsn_t undo_lsn_{INVALID_LSN};
+  LogRecordType action_type_{LogRecordType::INVALID};
+
+  /** A byte range an update changed. It starts gap bytes after the end of the previous range, in both tuples. */
+  struct UpdateRange {
+    uint32_t gap_;
+    std::string old_data_;
+    std::string new_data_;
+  };
+
+  // case3: for update operation, what goes to the log
+  std::vector<UpdateRange> update_ranges_;
+
+  /** The size of the smallest record, a header with one-byte varints. */
+  static const int MIN_SIZE = 8;
+
+  /**
+   * @return the ranges where the bytes of the two tuples differ. Only the last range may change the length of
+   * the tuple, so that every range starts at the same offset in both tuples.
+   */
+  static std::vector<UpdateRange> DiffTuples(const Tuple &old_tuple, const Tuple &new_tuple);
+
+  /** Calculate size_, the number of bytes SerializeTo writes. */
+  void ComputeSize();
 };  // namespace bustub
 
 }  // namespace bustub
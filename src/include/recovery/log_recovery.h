@@ -13,22 +13,53 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "recovery/log_manager.h"
 #include "recovery/log_record.h"
 
 namespace bustub {
 
+class TablePage;
+
 /**
- * Read log file from disk, redo and undo.
+ * Read log file from disk, redo and undo, the ARIES way.
+ *
+ * The analysis pass reads the log from the checkpoint the master record points at, and rebuilds the active
+ * transaction table and the dirty page table as they were at the crash. Redo repeats history from the oldest
+ * change a dirty page may lack, skipping the pages whose LSN shows they already hold a change. Undo rolls back
+ * the transactions that were still active, newest change first, and logs a CLR for every change it undoes, so a
+ * crash during recovery never undoes a change twice.
+ *
+ * The log is read in chunks of LOG_BUFFER_SIZE bytes, and only from the checkpoint's scan LSN on. Recovery runs
+ * before logging is enabled, and sets the log manager up to continue the recovered log.
+ *
+ * Redo runs in parallel. A change to a page only depends on the earlier changes to the same page, so the thread
+ * reading the log hands each record to the worker owning its page, picked by page id, and every worker applies
+ * the records of its pages in LSN order. The reading thread prefetches the pages as it hands records over, so
+ * they are often in the buffer pool by the time their worker gets to them.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
+  /**
+   * @param redo_threads the number of workers redo runs, at most half of the buffer pool frames since every
+   * worker and prefetch pins a page
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+              size_t redo_threads = std::thread::hardware_concurrency())
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        log_manager_(log_manager),
+        redo_threads_(redo_threads) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
@@ -37,20 +68,98 @@ class LogRecovery {
     log_buffer_ = nullptr;
   }
 
+  /** Run the analysis pass, then redo every logged change the pages on disk lack. */
   void Redo();
+  /** Roll back the transactions that were active at the crash. Called after Redo. */
   void Undo();
+  /**
+   * Deserialize a log record.
+   * @param data the serialized record, all of its size bytes are readable
+   * @param[out] log_record the record
+   * @return false if data does not hold a well-formed record
+   */
   bool DeserializeLogRecord(const char *data, LogRecord *log_record);
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** How many records the reading thread hands a redo worker at once. */
+  static constexpr size_t REDO_BATCH_SIZE = 64;
+  /** How many batches may wait for a redo worker before the reading thread waits for it. */
+  static constexpr size_t REDO_QUEUE_DEPTH = 16;
+
+  /** The records of one redo worker, each with the page it changes. NEWPAGE is handed over once per page. */
+  using RedoBatch = std::vector<std::pair<page_id_t, LogRecord>>;
+
+  /** The queue of a redo worker. */
+  struct RedoPartition {
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::deque<RedoBatch> batches_;
+    /** Whether the reading thread has handed over every record. */
+    bool done_{false};
+  };
+
+  /** Rebuild the active transaction table and the dirty page table, and find the end of the log. */
+  void Analyze();
+
+  /** Update the tables with a record logged after the checkpoint began. */
+  void AnalyzeRecord(LogRecord *log_record);
+
+  /** Apply the batches of a partition, until the reading thread is done. Runs on a redo worker. */
+  void RedoPartitionLoop(RedoPartition *partition);
+
+  /**
+   * Apply the change of a record to one of its pages, unless the page already holds it.
+   * @param[in,out] page_lsns the LSNs of the pages the worker has already fetched, which hold every change up to them
+   */
+  void RedoRecord(page_id_t page_id, LogRecord *log_record, std::unordered_map<page_id_t, lsn_t> *page_lsns);
+
+  /** Roll back the change of a record of a transaction that did not finish, and log its CLR. */
+  void UndoRecord(LogRecord *log_record);
+
+  /**
+   * @return the page pinned, if it may lack the change logged at lsn; nullptr otherwise
+   */
+  TablePage *FetchPageToRedo(page_id_t page_id, lsn_t lsn, std::unordered_map<page_id_t, lsn_t> *page_lsns);
+
+  /**
+   * Read the record at offset in the log file.
+   * @param backward whether the records before this one are read next, rather than the ones after it
+   * @return false if there is no complete record at offset
+   */
+  bool ReadLogRecord(int64_t offset, LogRecord *log_record, bool backward);
+
+  /** @return bytes [offset, offset + size) of the log, read into the log buffer if needed; nullptr past end */
+  const char *FetchLog(int64_t offset, int size, bool backward);
+
+  /** @return the offset in the log of a record read by the analysis pass, -1 if it was not read */
+  int64_t OffsetOf(lsn_t lsn) {
+    return lsn >= first_lsn_ && lsn - first_lsn_ < static_cast<lsn_t>(lsn_mapping_.size())
+               ? lsn_mapping_[lsn - first_lsn_]
+               : -1;
+  }
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogManager *log_manager_;
+  size_t redo_threads_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  /** The transactions that committed or aborted since the analysis began. */
+  std::unordered_set<txn_id_t> finished_txn_;
+  /** The pages that may lack changes, and the LSN of the oldest change each one may lack. Read-only during redo. */
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table_;
+  /** Mapping the log sequence number to log offset for undos, LSNs are dense from first_lsn_ on. */
+  std::vector<int64_t> lsn_mapping_;
+  lsn_t first_lsn_{INVALID_LSN};
 
-  int offset_ __attribute__((__unused__));
+  /** The offset of the first byte kept in the log, the start of its oldest segment. */
+  int64_t log_start_{0};
+  /** The offset of the end of the log, the end of the last complete record once analysis is done. */
+  int64_t log_size_{0};
+  /** The offset in the log of the first byte in log_buffer_, and the number of bytes in it. */
+  int64_t offset_{0};
+  int buffer_size_{0};
   char *log_buffer_;
 };
 
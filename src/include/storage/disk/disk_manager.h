@@ -13,6 +13,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <future>  // NOLINT
 #include <mutex>   // NOLINT
@@ -25,14 +26,20 @@ namespace bustub {
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is split into segment files of a fixed size, named after the database file with the segment number
+ * appended: test.log.0, test.log.1 and so on. Log offsets are logical, segment n holds the bytes from
+ * n * log_segment_size on, so an offset names its segment without reading any other. Once a checkpoint no longer
+ * needs the segments before an offset, they are deleted, or moved to the archive directory if there is one.
  */
 class DiskManager {
  public:
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param log_segment_size the size of a log segment file in bytes
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, int log_segment_size = LOG_SEGMENT_SIZE);
 
   ~DiskManager() = default;
 
@@ -66,10 +73,49 @@ class DiskManager {
    * Read a log entry from the log file.
    * @param[out] log_data output buffer
    * @param size size of the log entry
-   * @param offset offset of the log entry in the file
+   * @param offset offset of the log entry in the log
    * @return true if the read was successful, false otherwise
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  bool ReadLog(char *log_data, int size, int64_t offset);
+
+  /**
+   * Cut off the end of the log, such as a record torn by a crash.
+   * @param size the offset the log ends at from now on
+   */
+  void TruncateLog(int64_t size);
+
+  /** @return the offset of the first byte in the log, the start of the oldest segment kept */
+  int64_t GetLogStart();
+
+  /** @return the offset of the end of the log */
+  int64_t GetLogSize();
+
+  /**
+   * Delete or archive the log segments that end at or before an offset. The segment being written is kept.
+   * @param offset the oldest byte of the log that recovery may still read
+   */
+  void ReleaseLogBefore(int64_t offset);
+
+  /**
+   * Move released log segments into a directory, instead of deleting them.
+   * @param archive_dir the directory, created if needed; empty to delete released segments again
+   */
+  void SetLogArchiveDirectory(const std::string &archive_dir);
+
+  /**
+   * Write the master record, which tells recovery where to start reading the log.
+   * @param data raw master record
+   * @param size size of the master record
+   */
+  void WriteMasterRecord(const char *data, int size);
+
+  /**
+   * Read the master record.
+   * @param[out] data output buffer
+   * @param size size of the master record
+   * @return true if a complete master record was read, false if there is none
+   */
+  bool ReadMasterRecord(char *data, int size);
 
   /** @return the number of disk flushes */
   int GetNumFlushes() const;
@@ -91,9 +137,31 @@ class DiskManager {
 
  private:
   int GetFileSize(const std::string &file_name);
-  // stream to write log file
+  /** @return the file name of a log segment */
+  std::string GetLogSegmentName(int64_t segment) const;
+  /** Open the last log segment for appending, creating it if needed. */
+  void OpenLogSegment();
+
+  // stream to append to the last log segment, opened by the first write
   std::fstream log_io_;
+  // stream to read log segments
+  std::ifstream log_read_io_;
+  // log segments are named log_name_ followed by their number
   std::string log_name_;
+  int log_segment_size_;
+  /** The oldest and the newest log segment kept, and the number of bytes in the newest one. */
+  int64_t first_log_segment_{0};
+  int64_t last_log_segment_{0};
+  int log_segment_used_{0};
+  /** The segment log_read_io_ has open and where the last read stopped, -1 if the stream has been moved since. */
+  int64_t log_read_segment_{-1};
+  int64_t log_read_offset_{-1};
+  // where released log segments go, they are deleted if empty
+  std::string log_archive_dir_;
+  // protects the log segments, the flush thread writes while checkpoints release segments
+  std::mutex log_io_latch_;
+  // file that holds the master record
+  std::string master_name_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
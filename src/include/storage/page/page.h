@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -63,8 +64,11 @@ class Page {
   /** @return the page LSN. */
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
-  /** Sets the page LSN. */
-  inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
+  /** Sets the page LSN, the page is then written out only after the log up to it is durable. */
+  inline void SetLSN(lsn_t lsn) {
+    memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t));
+    has_lsn_ = true;
+  }
 
  protected:
   static_assert(sizeof(page_id_t) == 4);
@@ -86,6 +90,13 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /** The recovery LSN: the page on disk holds every change logged before it. */
+  lsn_t rec_lsn_ = INVALID_LSN;
+  /**
+   * True if a logged change set the page LSN since the page was read in. Only such pages carry an LSN,
+   * the same bytes hold other data on index and header pages.
+   */
+  std::atomic<bool> has_lsn_{false};
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
 };
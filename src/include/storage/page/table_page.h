@@ -77,7 +77,7 @@ class TablePage : public Page {
    * @param tuple tuple to insert
    * @param[out] rid rid of the inserted tuple
    * @param txn transaction performing the insert
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a table lock of txn already covers the row
    * @param log_manager the log manager
    * @return true if the insert is successful (i.e. there is enough space)
    */
@@ -87,7 +87,7 @@ class TablePage : public Page {
    * Mark a tuple as deleted. This does not actually delete the tuple.
    * @param rid rid of the tuple to mark as deleted
    * @param txn transaction performing the delete
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a table lock of txn already covers the row
    * @param log_manager the log manager
    * @return true if marking the tuple as deleted is successful (i.e the tuple exists)
    */
@@ -99,18 +99,27 @@ class TablePage : public Page {
    * @param[out] old_tuple old value of the tuple
    * @param rid rid of the tuple
    * @param txn transaction performing the update
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a table lock of txn already covers the row
    * @param log_manager the log manager
+   * @param undo_lsn the LSN of the update this one rolls back, if any; the change is then logged as a CLR
    * @return true if updating the tuple succeeded
    */
   bool UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID &rid, Transaction *txn,
-                   LockManager *lock_manager, LogManager *log_manager);
+                   LockManager *lock_manager, LogManager *log_manager, lsn_t undo_lsn = INVALID_LSN);
 
-  /** To be called on commit or abort. Actually perform the delete or rollback an insert. */
-  void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
+  /**
+   * To be called on commit or abort. Actually perform the delete or rollback an insert.
+   * On abort, undo_lsn is the LSN of the insert rolled back, and the delete is logged as a CLR.
+   * The caller must hold an exclusive lock on the row, either its own or through the table.
+   */
+  void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager, lsn_t undo_lsn = INVALID_LSN);
 
-  /** To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete. */
-  void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
+  /**
+   * To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete.
+   * undo_lsn is the LSN of the MarkDelete, if known; the rollback is then logged as a CLR.
+   * The caller must hold an exclusive lock on the row, either its own or through the table.
+   */
+  void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager, lsn_t undo_lsn = INVALID_LSN);
 
   /**
    * Read a tuple from a table.
@@ -122,6 +131,18 @@ class TablePage : public Page {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
 
+  /**
+   * Read the image of a tuple as the page holds it, without locking, even if the tuple is marked as deleted.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read
+   * @param[out] is_deleted whether the tuple is marked as deleted, if not nullptr
+   * @return true if the slot holds a tuple
+   */
+  bool ReadTuple(const RID &rid, Tuple *tuple, bool *is_deleted = nullptr);
+
+  /** @return the number of slots in this page, some of which may be empty */
+  uint32_t GetSlotCount() { return GetTupleCount(); }
+
   /** @return the rid of the first tuple in this page */
 
   /**
@@ -190,6 +211,15 @@ class TablePage : public Page {
     memcpy(GetData() + OFFSET_TUPLE_SIZE + SIZE_TUPLE * slot_num, &size, sizeof(uint32_t));
   }
 
+  /**
+   * Append the log record of a change to this page. Its LSN becomes the page LSN and the transaction's previous LSN.
+   * @param log_record the record of the change
+   * @param undo_lsn the LSN of the record the change rolls back, if any; the change is then logged as a CLR
+   * @param txn transaction performing the change
+   * @param log_manager the log manager
+   */
+  void LogChange(LogRecord log_record, lsn_t undo_lsn, Transaction *txn, LogManager *log_manager);
+
   /** @return true if the tuple is deleted or empty */
   static bool IsDeleted(uint32_t tuple_size) { return static_cast<bool>(tuple_size & DELETE_MASK) || tuple_size == 0; }
 
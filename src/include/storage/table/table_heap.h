@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
@@ -46,9 +48,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param txn the creating transaction
+   * @param table_oid the oid of the table in the catalog, an EXCLUSIVE lock on it covers the rows of the heap
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            Transaction *txn);
+            Transaction *txn, table_oid_t table_oid = INVALID_TABLE_OID);
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
@@ -90,6 +93,16 @@ class TableHeap {
    */
   void RollbackDelete(const RID &rid, Transaction *txn);
 
+  /**
+   * Called on Commit/Abort to finish a batch of the transaction's writes to this table: a commit applies its
+   * deletes, an abort rolls back its inserts, deletes and updates. The writes are visited page by page,
+   * so every page the batch touches is fetched and latched only once.
+   * @param writes the writes to finish, newest first; writes to the same page are finished in this order
+   * @param commit true if the transaction commits, false if it aborts
+   * @param txn the committing or aborting transaction
+   */
+  void FinishWrites(const std::vector<const TableWriteRecord *> &writes, bool commit, Transaction *txn);
+
   /**
    * Read a tuple from the table.
    * @param rid rid of the tuple to read
@@ -99,6 +112,26 @@ class TableHeap {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn);
 
+  /**
+   * Read a batch of tuples from the table. The RIDs are visited in page order,
+   * so every page the batch touches is fetched and latched only once.
+   * @param rids rids of the tuples to read
+   * @param[out] tuples the tuples read, in the order of rids
+   * @param[out] found for each rid, whether the read was successful
+   * @param txn transaction performing the read
+   */
+  void GetTuples(const std::vector<RID> &rids, std::vector<Tuple> *tuples, std::vector<bool> *found,
+                 Transaction *txn);
+
+  /**
+   * Read the tuples of one page as a SNAPSHOT_ISOLATION transaction sees them, without taking any lock.
+   * @param page_id id of the table page to read
+   * @param[out] tuples the versions of the page's tuples visible in the transaction's snapshot
+   * @param txn transaction performing the read
+   * @return the id of the next page of the table, INVALID_PAGE_ID after the last one
+   */
+  page_id_t GetSnapshotPage(page_id_t page_id, std::vector<Tuple> *tuples, Transaction *txn);
+
   /** @return the begin iterator of this table */
   TableIterator Begin(Transaction *txn);
 
@@ -109,10 +142,21 @@ class TableHeap {
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
  private:
+  /** @return the lock manager to lock the rows txn writes, nullptr if its table lock already covers them */
+  LockManager *GetRowLockManager(Transaction *txn) {
+    return txn->IsTableExclusiveLocked(table_oid_) ? nullptr : lock_manager_;
+  }
+
+  /** @return true if txn holds an exclusive lock on the row, either its own or through the table */
+  bool IsExclusiveLocked(Transaction *txn, const RID &rid) {
+    return txn->IsExclusiveLocked(rid) || txn->IsTableExclusiveLocked(table_oid_);
+  }
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  table_oid_t table_oid_{INVALID_TABLE_OID};
 };
 
 }  // namespace bustub
@@ -61,9 +61,15 @@ class Tuple {
   // deserialize tuple data(deep copy)
   void DeserializeFrom(const char *storage);
 
+  // deserialize tuple data of a known size, without the size in front(deep copy)
+  void DeserializeFrom(const char *data, uint32_t size);
+
   // return RID of current tuple
   inline RID GetRid() const { return rid_; }
 
+  // set RID of current tuple
+  inline void SetRid(const RID &rid) { rid_ = rid; }
+
   // Get the address of this tuple in the table's backing store
   inline char *GetData() const { return data_; }
 
@@ -74,6 +80,9 @@ class Tuple {
   // checks the schema to see how to return the Value.
   Value GetValue(const Schema *schema, uint32_t column_idx) const;
 
+  // Overwrite the value of a fixed-size (inlined) column in place
+  void SetValue(const Schema *schema, uint32_t column_idx, const Value &value);
+
   // Generates a key tuple given schemas and attributes
   Tuple KeyFromTuple(const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs);
 
@@ -13,42 +13,167 @@
 #include "recovery/log_manager.h"
 
 namespace bustub {
-/*
- * set enable_logging = true
- * Start a separate thread to execute flush to disk operation periodically
- * The flush can be triggered when timeout or the log buffer is full or buffer
- * pool manager wants to force flush (it only happens when the flushed page has
- * a larger LSN than persistent LSN)
- *
- * This thread runs forever until system shutdown/StopFlushThread
- */
-void LogManager::RunFlushThread() {}
-
-/*
- * Stop and join the flush thread, set enable_logging = false
- */
-void LogManager::StopFlushThread() {}
-
-/*
- * append a log record into log buffer
- * you MUST set the log record's lsn within this method
- * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
- */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+
+void LogManager::RunFlushThread() {
+  std::scoped_lock lock(latch_);
+  if (flush_thread_running_) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_running_ = true;
+  flush_thread_ = new std::thread(&LogManager::FlushLoop, this);
+}
+
+void LogManager::StopFlushThread() {
+  {
+    std::scoped_lock lock(latch_);
+    if (!flush_thread_running_) {
+      return;
+    }
+    flush_thread_running_ = false;
+  }
+  cv_.notify_one();
+  // 退出前线程会把缓冲区剩下的日志写出去
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+  enable_logging = false;
+}
+
+void LogManager::FlushLoop() {
+  std::unique_lock lock(latch_);
+  while (true) {
+    cv_.wait_for(lock, log_timeout, [this] { return flush_requested_ || !flush_thread_running_; });
+    // 超时、缓冲区满或者有事务在等待持久化，都把当前缓冲区整个写出去
+    WriteLogBuffer(&lock, true);
+    if (!flush_thread_running_ && (reservation_.load() & OFFSET_MASK) == 0) {
+      break;
+    }
+  }
+}
+
+void LogManager::WriteLogBuffer(std::unique_lock<std::mutex> *lock, bool unlock_for_write) {
+  flush_requested_ = false;
+  // 切换到另一个缓冲区，之后的预留都落在新缓冲区的开头
+  uint64_t reservation = reservation_.load();
+  do {
+    if ((reservation & OFFSET_MASK) == 0) {
+      flushed_cv_.notify_all();
+      return;
+    }
+  } while (!reservation_.compare_exchange_weak(reservation,
+                                               ((reservation >> LSN_SHIFT) << LSN_SHIFT) |
+                                                   ((reservation & BUFFER_BIT) ^ BUFFER_BIT)));
+  size_t buffer = BufferOf(reservation);
+  uint64_t size = reservation & OFFSET_MASK;
+  auto last_lsn = static_cast<lsn_t>((reservation >> LSN_SHIFT) - 1);
+  // 新缓冲区在文件里紧跟着封存的缓冲区
+  buffer_starts_.emplace_back(last_lsn + 1, buffer_starts_.back().second + static_cast<int64_t>(size));
+  append_cv_.notify_all();
+
+  if (unlock_for_write) {
+    write_in_progress_ = true;
+    lock->unlock();
+  }
+  // 等还在往封存的缓冲区里拷贝的线程拷完
+  while (filled_[buffer].load(std::memory_order_acquire) < size) {
+    std::this_thread::yield();
+  }
+  disk_manager_->WriteLog(buffers_[buffer], static_cast<int>(size));
+  // 再次切换回这个缓冲区之前不会有人往里写
+  filled_[buffer].store(0, std::memory_order_relaxed);
+  if (unlock_for_write) {
+    lock->lock();
+    write_in_progress_ = false;
+  }
+  persistent_lsn_ = last_lsn;
+  flushed_cv_.notify_all();
+}
+
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  BUSTUB_ASSERT(log_record->size_ <= LOG_BUFFER_SIZE, "A log record can not be larger than the log buffer.");
+  // 一次CAS同时预留LSN和缓冲区空间
+  uint64_t reservation = reservation_.load();
+  while (true) {
+    if ((reservation & OFFSET_MASK) + log_record->size_ > LOG_BUFFER_SIZE) {
+      WaitForRoom(log_record->size_);
+      reservation = reservation_.load();
+      continue;
+    }
+    uint64_t reserved = reservation + (1ULL << LSN_SHIFT) + static_cast<uint64_t>(log_record->size_);
+    if (reservation_.compare_exchange_weak(reservation, reserved)) {
+      break;
+    }
+  }
+  size_t buffer = BufferOf(reservation);
+  log_record->lsn_ = static_cast<lsn_t>(reservation >> LSN_SHIFT);
+  // 拷贝不需要加锁，各线程写各自预留的区域
+  log_record->SerializeTo(buffers_[buffer] + (reservation & OFFSET_MASK));
+  filled_[buffer].fetch_add(log_record->size_, std::memory_order_release);
+  return log_record->lsn_;
+}
+
+void LogManager::WaitForRoom(int32_t size) {
+  std::unique_lock lock(latch_);
+  if (HasRoom(size)) {
+    return;
+  }
+  // 没有刷盘线程就自己写，正在退出的刷盘线程可能还在写另一个缓冲区，等它写完
+  if (!flush_thread_running_) {
+    flushed_cv_.wait(lock, [this] { return !write_in_progress_; });
+    if (!HasRoom(size)) {
+      WriteLogBuffer(&lock, false);
+    }
+    return;
+  }
+  flush_requested_ = true;
+  cv_.notify_one();
+  // 封存缓冲区时持有latch，不会错过通知
+  append_cv_.wait(lock, [this, size] { return HasRoom(size); });
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  std::unique_lock lock(latch_);
+  BUSTUB_ASSERT(lsn < GetNextLSN(), "Can not wait for an LSN that has not been assigned.");
+  if (persistent_lsn_ >= lsn) {
+    return;
+  }
+  if (!flush_thread_running_) {
+    flushed_cv_.wait(lock, [this] { return !write_in_progress_; });
+    if (persistent_lsn_ < lsn) {
+      WriteLogBuffer(&lock, false);
+    }
+    return;
+  }
+  // 组提交：写盘期间到来的事务都在等下一次写，一次写盘覆盖它们所有人
+  flush_requested_ = true;
+  cv_.notify_one();
+  // 刷盘线程停止前会写完缓冲区，所以只能等到lsn真正持久化
+  flushed_cv_.wait(lock, [this, lsn] { return persistent_lsn_ >= lsn; });
+}
+
+void LogManager::WriteMasterRecord(lsn_t checkpoint_lsn, lsn_t scan_lsn) {
+  MasterRecord master{checkpoint_lsn, scan_lsn, 0};
+  {
+    std::scoped_lock lock(latch_);
+    // 以后的检查点不会再需要scan_lsn之前的日志
+    while (buffer_starts_.size() > 1 && buffer_starts_[1].first <= scan_lsn) {
+      buffer_starts_.pop_front();
+    }
+    master.scan_offset_ = buffer_starts_.front().second;
+  }
+  disk_manager_->WriteMasterRecord(reinterpret_cast<const char *>(&master), sizeof(master));
+  // 主记录写好之后，扫描起点之前的日志段就没用了
+  disk_manager_->ReleaseLogBefore(master.scan_offset_);
+}
+
+void LogManager::SetLogEnd(lsn_t next_lsn, int64_t log_size) {
+  std::scoped_lock lock(latch_);
+  uint64_t reservation = reservation_.load();
+  BUSTUB_ASSERT((reservation & OFFSET_MASK) == 0, "The log must be set up before anything is appended.");
+  reservation_ = (static_cast<uint64_t>(next_lsn) << LSN_SHIFT) | (reservation & BUFFER_BIT);
+  persistent_lsn_ = next_lsn - 1;
+  buffer_starts_.assign(1, {next_lsn, log_size});
+}
 
 }  // namespace bustub
@@ -0,0 +1,425 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_record.cpp
+//
+// Identification: src/recovery/log_record.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_record.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace bustub {
+
+/** Two changed ranges at most this many bytes apart are logged as one, a range costs a few bytes of its own. */
+static constexpr uint32_t MAX_RANGE_GAP = 4;
+
+/** @return the number of bytes a varint of value takes */
+static int32_t VarintSize(uint32_t value) {
+  int32_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+/** @return an id or an LSN as it is stored, INVALID is 0 */
+static uint32_t EncodeId(int32_t id) { return static_cast<uint32_t>(id) + 1; }
+
+static int32_t DecodeId(uint32_t value) { return static_cast<int32_t>(value - 1); }
+
+/** Reads the fields of a serialized record. A field that runs past the end fails, and so does every later one. */
+class LogReader {
+ public:
+  LogReader(const char *data, const char *end) : data_(data), end_(end) {}
+
+  bool ReadVarint(uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35 && data_ < end_; shift += 7) {
+      auto byte = static_cast<uint8_t>(*data_++);
+      *value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return Fail();
+  }
+
+  bool ReadId(int32_t *id) {
+    uint32_t value;
+    if (!ReadVarint(&value)) {
+      return false;
+    }
+    *id = DecodeId(value);
+    return true;
+  }
+
+  bool ReadType(LogRecordType *type) {
+    if (data_ == end_) {
+      return Fail();
+    }
+    *type = static_cast<LogRecordType>(static_cast<uint8_t>(*data_++));
+    return true;
+  }
+
+  bool ReadFixed(int32_t *value) {
+    if (end_ - data_ < static_cast<ptrdiff_t>(sizeof(*value))) {
+      return Fail();
+    }
+    memcpy(value, data_, sizeof(*value));
+    data_ += sizeof(*value);
+    return true;
+  }
+
+  /** @return the next size bytes, nullptr if the record ends before them */
+  const char *ReadBytes(uint32_t size) {
+    if (static_cast<size_t>(end_ - data_) < size) {
+      Fail();
+      return nullptr;
+    }
+    const char *bytes = data_;
+    data_ += size;
+    return bytes;
+  }
+
+  bool ReadRID(RID *rid) {
+    int32_t page_id;
+    uint32_t slot_num;
+    if (!ReadId(&page_id) || !ReadVarint(&slot_num)) {
+      return false;
+    }
+    rid->Set(page_id, slot_num);
+    return true;
+  }
+
+  bool ReadTuple(Tuple *tuple) {
+    uint32_t size;
+    const char *bytes = ReadVarint(&size) ? ReadBytes(size) : nullptr;
+    if (bytes == nullptr) {
+      return false;
+    }
+    tuple->DeserializeFrom(bytes, size);
+    return true;
+  }
+
+  /** @return whether every field so far was read */
+  bool IsValid() const { return valid_; }
+
+  /** @return whether every field was read, and they fill the record up to its end */
+  bool IsComplete() const { return valid_ && data_ == end_; }
+
+ private:
+  bool Fail() {
+    valid_ = false;
+    data_ = end_;
+    return false;
+  }
+
+  const char *data_;
+  const char *end_;
+  bool valid_{true};
+};
+
+std::vector<LogRecord::UpdateRange> LogRecord::DiffTuples(const Tuple &old_tuple, const Tuple &new_tuple) {
+  const char *old_data = old_tuple.GetData();
+  const char *new_data = new_tuple.GetData();
+  uint32_t old_size = old_tuple.GetLength();
+  uint32_t new_size = new_tuple.GetLength();
+  std::vector<UpdateRange> ranges;
+  if (old_size != new_size) {
+    // A tuple that changes its length is one range, without the bytes both tuples start and end with.
+    uint32_t min_size = std::min(old_size, new_size);
+    uint32_t prefix = 0;
+    while (prefix < min_size && old_data[prefix] == new_data[prefix]) {
+      prefix++;
+    }
+    uint32_t suffix = 0;
+    while (suffix < min_size - prefix && old_data[old_size - 1 - suffix] == new_data[new_size - 1 - suffix]) {
+      suffix++;
+    }
+    ranges.push_back({prefix, std::string(old_data + prefix, old_size - prefix - suffix),
+                      std::string(new_data + prefix, new_size - prefix - suffix)});
+    return ranges;
+  }
+
+  uint32_t previous_end = 0;
+  for (uint32_t start = 0; start < old_size; start++) {
+    if (old_data[start] == new_data[start]) {
+      continue;
+    }
+    uint32_t end = start + 1;
+    for (uint32_t i = end; i < old_size && i <= end + MAX_RANGE_GAP; i++) {
+      if (old_data[i] != new_data[i]) {
+        end = i + 1;
+      }
+    }
+    ranges.push_back(
+        {start - previous_end, std::string(old_data + start, end - start), std::string(new_data + start, end - start)});
+    previous_end = end;
+    start = end;
+  }
+  return ranges;
+}
+
+bool LogRecord::ApplyUpdate(const Tuple &tuple, bool undo, Tuple *result) const {
+  const char *data = tuple.GetData();
+  uint32_t size = tuple.GetLength();
+  std::string updated;
+  updated.reserve(size);
+  uint32_t offset = 0;
+  for (const auto &range : update_ranges_) {
+    const std::string &from = undo ? range.new_data_ : range.old_data_;
+    const std::string &to = undo ? range.old_data_ : range.new_data_;
+    uint32_t start = offset + range.gap_;
+    if (start > size || size - start < from.size() || memcmp(data + start, from.data(), from.size()) != 0) {
+      return false;
+    }
+    updated.append(data + offset, range.gap_);
+    updated.append(to);
+    offset = start + from.size();
+  }
+  updated.append(data + offset, size - offset);
+  result->DeserializeFrom(updated.data(), updated.size());
+  return true;
+}
+
+void LogRecord::ComputeSize() {
+  auto rid_size = [](const RID &rid) { return VarintSize(EncodeId(rid.GetPageId())) + VarintSize(rid.GetSlotNum()); };
+  auto tuple_size = [](const Tuple &tuple) { return VarintSize(tuple.GetLength()) + tuple.GetLength(); };
+
+  int32_t size = sizeof(lsn_t) + VarintSize(EncodeId(txn_id_)) + VarintSize(EncodeId(prev_lsn_)) + 1;
+  LogRecordType body_type = log_record_type_;
+  if (body_type == LogRecordType::CLR) {
+    size += VarintSize(EncodeId(undo_lsn_)) + 1;
+    body_type = action_type_;
+  }
+  switch (body_type) {
+    case LogRecordType::INSERT:
+      size += rid_size(insert_rid_) + tuple_size(insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      size += rid_size(delete_rid_) + tuple_size(delete_tuple_);
+      break;
+    case LogRecordType::UPDATE:
+      size += rid_size(update_rid_) + VarintSize(update_ranges_.size());
+      for (const auto &range : update_ranges_) {
+        size += VarintSize(range.gap_) + VarintSize(range.old_data_.size()) + VarintSize(range.new_data_.size()) +
+                range.old_data_.size() + range.new_data_.size();
+      }
+      break;
+    case LogRecordType::NEWPAGE:
+      size += VarintSize(EncodeId(prev_page_id_)) + VarintSize(EncodeId(page_id_));
+      break;
+    case LogRecordType::CHECKPOINT_END:
+      size += VarintSize(active_txns_.size()) + VarintSize(dirty_pages_.size());
+      for (const auto &[txn_id, last_lsn] : active_txns_) {
+        size += VarintSize(EncodeId(txn_id)) + VarintSize(EncodeId(last_lsn));
+      }
+      for (const auto &[page_id, rec_lsn] : dirty_pages_) {
+        size += VarintSize(EncodeId(page_id)) + VarintSize(EncodeId(rec_lsn));
+      }
+      break;
+    default:
+      break;
+  }
+  // The size counts its own bytes, which depend on the size.
+  size_ = size + 1;
+  while (size_ != size + VarintSize(size_)) {
+    size_ = size + VarintSize(size_);
+  }
+}
+
+void LogRecord::SerializeTo(char *dest) const {
+  char *start = dest;
+  auto write_varint = [&dest](uint32_t value) {
+    while (value >= 0x80) {
+      *dest++ = static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    *dest++ = static_cast<char>(value);
+  };
+  auto write_bytes = [&dest](const char *data, size_t size) {
+    memcpy(dest, data, size);
+    dest += size;
+  };
+  auto write_rid = [&write_varint](const RID &rid) {
+    write_varint(EncodeId(rid.GetPageId()));
+    write_varint(rid.GetSlotNum());
+  };
+  auto write_tuple = [&write_varint, &write_bytes](const Tuple &tuple) {
+    write_varint(tuple.GetLength());
+    write_bytes(tuple.GetData(), tuple.GetLength());
+  };
+
+  write_varint(size_);
+  write_bytes(reinterpret_cast<const char *>(&lsn_), sizeof(lsn_));
+  write_varint(EncodeId(txn_id_));
+  write_varint(EncodeId(prev_lsn_));
+  *dest++ = static_cast<char>(log_record_type_);
+
+  LogRecordType body_type = log_record_type_;
+  if (body_type == LogRecordType::CLR) {
+    write_varint(EncodeId(undo_lsn_));
+    *dest++ = static_cast<char>(action_type_);
+    body_type = action_type_;
+  }
+  switch (body_type) {
+    case LogRecordType::INSERT:
+      write_rid(insert_rid_);
+      write_tuple(insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      write_rid(delete_rid_);
+      write_tuple(delete_tuple_);
+      break;
+    case LogRecordType::UPDATE:
+      write_rid(update_rid_);
+      write_varint(update_ranges_.size());
+      for (const auto &range : update_ranges_) {
+        write_varint(range.gap_);
+        write_varint(range.old_data_.size());
+        write_varint(range.new_data_.size());
+        write_bytes(range.old_data_.data(), range.old_data_.size());
+        write_bytes(range.new_data_.data(), range.new_data_.size());
+      }
+      break;
+    case LogRecordType::NEWPAGE:
+      write_varint(EncodeId(prev_page_id_));
+      write_varint(EncodeId(page_id_));
+      break;
+    case LogRecordType::CHECKPOINT_END:
+      write_varint(active_txns_.size());
+      for (const auto &[txn_id, last_lsn] : active_txns_) {
+        write_varint(EncodeId(txn_id));
+        write_varint(EncodeId(last_lsn));
+      }
+      write_varint(dirty_pages_.size());
+      for (const auto &[page_id, rec_lsn] : dirty_pages_) {
+        write_varint(EncodeId(page_id));
+        write_varint(EncodeId(rec_lsn));
+      }
+      break;
+    default:
+      break;
+  }
+  BUSTUB_ASSERT(dest - start == size_, "The serialized record must fill its size.");
+}
+
+bool LogRecord::ReadSize(const char *data, int32_t available, int32_t *size) {
+  LogReader reader(data, data + std::min(available, MAX_SIZE_BYTES));
+  uint32_t value;
+  if (!reader.ReadVarint(&value) || value < static_cast<uint32_t>(MIN_SIZE) || value > LOG_BUFFER_SIZE) {
+    return false;
+  }
+  *size = static_cast<int32_t>(value);
+  return true;
+}
+
+bool LogRecord::DeserializeFrom(const char *data) {
+  int32_t size;
+  if (!ReadSize(data, MAX_SIZE_BYTES, &size)) {
+    return false;
+  }
+  LogReader reader(data, data + size);
+  uint32_t read_size;
+  reader.ReadVarint(&read_size);
+  size_ = size;
+  if (!reader.ReadFixed(&lsn_) || !reader.ReadId(&txn_id_) || !reader.ReadId(&prev_lsn_) ||
+      !reader.ReadType(&log_record_type_) || lsn_ < 0 || log_record_type_ <= LogRecordType::INVALID ||
+      log_record_type_ > LogRecordType::CLR) {
+    return false;
+  }
+
+  // A failed field fails the ones after it, so the fields are read without checking each of them.
+  LogRecordType body_type = log_record_type_;
+  if (body_type == LogRecordType::CLR) {
+    reader.ReadId(&undo_lsn_);
+    reader.ReadType(&action_type_);
+    body_type = action_type_;
+  }
+  switch (body_type) {
+    case LogRecordType::INSERT:
+      reader.ReadRID(&insert_rid_);
+      reader.ReadTuple(&insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      reader.ReadRID(&delete_rid_);
+      reader.ReadTuple(&delete_tuple_);
+      break;
+    case LogRecordType::UPDATE: {
+      uint32_t count = 0;
+      reader.ReadRID(&update_rid_);
+      reader.ReadVarint(&count);
+      update_ranges_.clear();
+      for (uint32_t i = 0; i < count && reader.IsValid(); i++) {
+        UpdateRange range;
+        uint32_t old_size = 0;
+        uint32_t new_size = 0;
+        reader.ReadVarint(&range.gap_);
+        reader.ReadVarint(&old_size);
+        reader.ReadVarint(&new_size);
+        const char *old_data = reader.ReadBytes(old_size);
+        const char *new_data = reader.ReadBytes(new_size);
+        if (old_data != nullptr && new_data != nullptr) {
+          range.old_data_.assign(old_data, old_size);
+          range.new_data_.assign(new_data, new_size);
+          update_ranges_.push_back(std::move(range));
+        }
+      }
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      reader.ReadId(&prev_page_id_);
+      reader.ReadId(&page_id_);
+      break;
+    case LogRecordType::CHECKPOINT_END: {
+      uint32_t count = 0;
+      active_txns_.clear();
+      dirty_pages_.clear();
+      reader.ReadVarint(&count);
+      for (uint32_t i = 0; i < count && reader.IsValid(); i++) {
+        std::pair<txn_id_t, lsn_t> entry;
+        reader.ReadId(&entry.first);
+        reader.ReadId(&entry.second);
+        active_txns_.push_back(entry);
+      }
+      count = 0;
+      reader.ReadVarint(&count);
+      for (uint32_t i = 0; i < count && reader.IsValid(); i++) {
+        std::pair<page_id_t, lsn_t> entry;
+        reader.ReadId(&entry.first);
+        reader.ReadId(&entry.second);
+        dirty_pages_.push_back(entry);
+      }
+      break;
+    }
+    case LogRecordType::BEGIN:
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+    case LogRecordType::CHECKPOINT_BEGIN:
+      // Only a plain record may be the header alone.
+      if (log_record_type_ != body_type) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  return reader.IsComplete();
+}
+
+}  // namespace bustub
@@ -12,29 +12,443 @@
 
 #include "recovery/log_recovery.h"
 
+#include <memory>
+#include <queue>
+#include <utility>
+
+#include "buffer/async_page_reader.h"
+#include "common/thread_pool.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
+
+/** @return the type of the change a record logs, the action of a CLR */
+static LogRecordType ChangeType(LogRecord *log_record) {
+  return log_record->GetLogRecordType() == LogRecordType::CLR ? log_record->GetActionType()
+                                                               : log_record->GetLogRecordType();
+}
+
+/** @return the tuple a record changes, a RID on no page if it changes none */
+static RID ChangedRID(LogRecord *log_record) {
+  switch (ChangeType(log_record)) {
+    case LogRecordType::INSERT:
+      return log_record->GetInsertRID();
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      return log_record->GetDeleteRID();
+    case LogRecordType::UPDATE:
+      return log_record->GetUpdateRID();
+    default:
+      return RID();
+  }
+}
+
+/** @return the LSN of a page, INVALID_LSN if the page never reached the disk and is all zeros */
+static lsn_t PageLSN(Page *page) {
+  lsn_t lsn = page->GetLSN();
+  if (lsn == 0 && std::all_of(page->GetData(), page->GetData() + PAGE_SIZE, [](char byte) { return byte == 0; })) {
+    return INVALID_LSN;
+  }
+  return lsn;
+}
+
 /*
  * deserialize a log record from log buffer
- * @return: true means deserialize succeed, otherwise can't deserialize cause
- * incomplete log record
+ * @return: true means deserialize succeed, otherwise the bytes are not a
+ * complete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) {
+  return log_record->DeserializeFrom(data);
+}
+
+const char *LogRecovery::FetchLog(int64_t offset, int size, bool backward) {
+  if (offset < log_start_ || size > log_size_ - offset) {
+    return nullptr;
+  }
+  if (offset < offset_ || offset + size > offset_ + buffer_size_) {
+    // 顺着读就读从这里开始的一整块，倒着读就读到这里为止的一整块
+    offset_ = backward ? std::max<int64_t>(log_start_, offset + size - LOG_BUFFER_SIZE) : offset;
+    buffer_size_ = static_cast<int>(std::min<int64_t>(LOG_BUFFER_SIZE, log_size_ - offset_));
+    if (!disk_manager_->ReadLog(log_buffer_, buffer_size_, offset_)) {
+      buffer_size_ = 0;
+      return nullptr;
+    }
+  }
+  return log_buffer_ + (offset - offset_);
+}
+
+bool LogRecovery::ReadLogRecord(int64_t offset, LogRecord *log_record, bool backward) {
+  // 记录大小是变长的，先取它可能占的字节
+  int header_size = static_cast<int>(std::min<int64_t>(LogRecord::MAX_SIZE_BYTES, log_size_ - offset));
+  const char *header = header_size > 0 ? FetchLog(offset, header_size, backward) : nullptr;
+  int32_t size;
+  if (header == nullptr || !LogRecord::ReadSize(header, header_size, &size)) {
+    return false;
+  }
+  const char *data = FetchLog(offset, size, backward);
+  return data != nullptr && DeserializeLogRecord(data, log_record);
+}
+
+void LogRecovery::Analyze() {
+  log_start_ = disk_manager_->GetLogStart();
+  log_size_ = disk_manager_->GetLogSize();
+  offset_ = log_start_;
+  buffer_size_ = 0;
+
+  // 主记录指向最后一个检查点所在的段，没有的话从留下的第一个段读
+  MasterRecord master{INVALID_LSN, INVALID_LSN, log_start_};
+  if (disk_manager_->ReadMasterRecord(reinterpret_cast<char *>(&master), sizeof(master))) {
+    LogRecord first;
+    // 主记录必须属于这份日志
+    if (!ReadLogRecord(master.scan_offset_, &first, false) || first.lsn_ > master.scan_lsn_ ||
+        master.scan_lsn_ > master.checkpoint_lsn_) {
+      master = MasterRecord{INVALID_LSN, INVALID_LSN, log_start_};
+    }
+  }
+
+  int64_t offset = master.scan_offset_;
+  while (true) {
+    LogRecord log_record;
+    if (!ReadLogRecord(offset, &log_record, false)) {
+      break;
+    }
+    if (first_lsn_ == INVALID_LSN) {
+      first_lsn_ = log_record.lsn_;
+    } else if (log_record.lsn_ != first_lsn_ + static_cast<lsn_t>(lsn_mapping_.size())) {
+      // LSN接不上的不是这份日志的记录
+      break;
+    }
+    lsn_mapping_.push_back(offset);
+    offset += log_record.size_;
+    // 检查点之前的记录只需要知道位置
+    if (log_record.lsn_ >= master.checkpoint_lsn_) {
+      AnalyzeRecord(&log_record);
+    }
+  }
+
+  // 截掉崩溃时写了一半的记录，新的日志接在最后一条完整的记录后面
+  if (offset < log_size_) {
+    disk_manager_->TruncateLog(offset);
+    log_size_ = offset;
+  }
+  lsn_t next_lsn = first_lsn_ == INVALID_LSN ? 0 : first_lsn_ + static_cast<lsn_t>(lsn_mapping_.size());
+  log_manager_->SetLogEnd(next_lsn, log_size_);
+}
+
+void LogRecovery::AnalyzeRecord(LogRecord *log_record) {
+  txn_id_t txn_id = log_record->txn_id_;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::BEGIN:
+      // 事务ID在重启后会被重用
+      finished_txn_.erase(txn_id);
+      active_txn_[txn_id] = log_record->lsn_;
+      break;
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+      active_txn_.erase(txn_id);
+      finished_txn_.insert(txn_id);
+      break;
+    case LogRecordType::CHECKPOINT_BEGIN:
+      break;
+    case LogRecordType::CHECKPOINT_END:
+      // 检查点的表在开始记录之后收集，和之后读到的记录合并
+      for (const auto &[active_txn_id, last_lsn] : log_record->active_txns_) {
+        if (finished_txn_.count(active_txn_id) == 0) {
+          auto [it, inserted] = active_txn_.emplace(active_txn_id, last_lsn);
+          it->second = std::max(it->second, last_lsn);
+        }
+      }
+      for (const auto &[page_id, rec_lsn] : log_record->dirty_pages_) {
+        if (rec_lsn != INVALID_LSN) {
+          auto [it, inserted] = dirty_page_table_.emplace(page_id, rec_lsn);
+          it->second = std::min(it->second, rec_lsn);
+        }
+      }
+      break;
+    default: {
+      // 提交之后还有真正执行删除的记录。不是CLR的APPLYDELETE只在COMMIT之后写，
+      // 即使COMMIT在检查点之前没有读到，它的事务也已经提交了
+      if (log_record->log_record_type_ == LogRecordType::APPLYDELETE) {
+        active_txn_.erase(txn_id);
+        finished_txn_.insert(txn_id);
+      } else if (finished_txn_.count(txn_id) == 0) {
+        active_txn_[txn_id] = log_record->lsn_;
+      }
+      if (ChangeType(log_record) == LogRecordType::NEWPAGE) {
+        dirty_page_table_.emplace(log_record->page_id_, log_record->lsn_);
+        if (log_record->prev_page_id_ != INVALID_PAGE_ID) {
+          dirty_page_table_.emplace(log_record->prev_page_id_, log_record->lsn_);
+        }
+      } else {
+        dirty_page_table_.emplace(ChangedRID(log_record).GetPageId(), log_record->lsn_);
+      }
+      break;
+    }
+  }
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
- *read log file from the beginning to end (you must prefetch log records into
- *log buffer to reduce unnecessary I/O operations), remember to compare page's
- *LSN with log_record's sequence number, and also build active_txn_ table &
- *lsn_mapping_ table
+ *analyze the log from the last checkpoint on, then repeat history from the
+ *oldest change a dirty page may lack, comparing each page's LSN with the
+ *record's sequence number. The records are applied by workers partitioned by
+ *page id
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  BUSTUB_ASSERT(!enable_logging, "Recovery runs before logging is enabled.");
+  Analyze();
+  if (first_lsn_ == INVALID_LSN) {
+    return;
+  }
+  auto end_lsn = first_lsn_ + static_cast<lsn_t>(lsn_mapping_.size());
+  lsn_t redo_lsn = end_lsn;
+  for (const auto &[page_id, rec_lsn] : dirty_page_table_) {
+    redo_lsn = std::min(redo_lsn, rec_lsn);
+  }
+  if (redo_lsn == end_lsn) {
+    return;
+  }
+
+  // 每个工作线程和每个预读线程最多同时固定一页
+  size_t max_threads = std::max<size_t>(1, (buffer_pool_manager_->GetPoolSize() - 1) / 2);
+  size_t thread_count = std::clamp<size_t>(redo_threads_, 1, max_threads);
+  std::vector<RedoPartition> partitions(thread_count);
+  std::vector<std::thread> workers;
+  workers.reserve(thread_count);
+  for (auto &partition : partitions) {
+    workers.emplace_back(&LogRecovery::RedoPartitionLoop, this, &partition);
+  }
+  auto io_pool = std::make_unique<ThreadPool>(thread_count);
+  AsyncPageReader page_reader(buffer_pool_manager_, io_pool.get());
+
+  std::vector<RedoBatch> batches(thread_count);
+  auto hand_over = [&partitions, &batches](size_t i) {
+    RedoPartition &partition = partitions[i];
+    {
+      std::unique_lock lock(partition.latch_);
+      partition.cv_.wait(lock, [&partition] { return partition.batches_.size() < REDO_QUEUE_DEPTH; });
+      partition.batches_.emplace_back(std::move(batches[i]));
+    }
+    partition.cv_.notify_all();
+    batches[i].clear();
+    batches[i].reserve(REDO_BATCH_SIZE);
+  };
+  auto dispatch = [&](page_id_t page_id, const LogRecord &log_record) {
+    // 页不在脏页表里，或者页上已经有这个修改
+    auto it = dirty_page_table_.find(page_id);
+    if (it == dirty_page_table_.end() || it->second > log_record.lsn_) {
+      return;
+    }
+    size_t i = static_cast<size_t>(page_id) % thread_count;
+    RedoBatch &batch = batches[i];
+    if (batch.empty() || batch.back().first != page_id) {
+      page_reader.Prefetch(page_id);
+    }
+    batch.emplace_back(page_id, log_record);
+    if (batch.size() == REDO_BATCH_SIZE) {
+      hand_over(i);
+    }
+  };
+
+  for (lsn_t lsn = std::max(redo_lsn, first_lsn_); lsn < end_lsn; lsn++) {
+    LogRecord log_record;
+    bool read = ReadLogRecord(OffsetOf(lsn), &log_record, false);
+    BUSTUB_ASSERT(read, "The analysis pass read this record.");
+    if (ChangeType(&log_record) == LogRecordType::NEWPAGE) {
+      // 新页和前一页指向它的链接分开重做
+      dispatch(log_record.page_id_, log_record);
+      if (log_record.prev_page_id_ != INVALID_PAGE_ID) {
+        dispatch(log_record.prev_page_id_, log_record);
+      }
+    } else if (RID rid = ChangedRID(&log_record); rid.GetPageId() != INVALID_PAGE_ID) {
+      dispatch(rid.GetPageId(), log_record);
+    }
+  }
+
+  for (size_t i = 0; i < thread_count; i++) {
+    if (!batches[i].empty()) {
+      hand_over(i);
+    }
+    {
+      std::scoped_lock lock(partitions[i].latch_);
+      partitions[i].done_ = true;
+    }
+    partitions[i].cv_.notify_all();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  // 预读要在page_reader析构之前做完
+  io_pool.reset();
+}
+
+void LogRecovery::RedoPartitionLoop(RedoPartition *partition) {
+  std::unordered_map<page_id_t, lsn_t> page_lsns;
+  while (true) {
+    RedoBatch batch;
+    {
+      std::unique_lock lock(partition->latch_);
+      partition->cv_.wait(lock, [partition] { return partition->done_ || !partition->batches_.empty(); });
+      if (partition->batches_.empty()) {
+        return;
+      }
+      batch = std::move(partition->batches_.front());
+      partition->batches_.pop_front();
+    }
+    partition->cv_.notify_all();
+    for (auto &[page_id, log_record] : batch) {
+      RedoRecord(page_id, &log_record, &page_lsns);
+    }
+  }
+}
+
+TablePage *LogRecovery::FetchPageToRedo(page_id_t page_id, lsn_t lsn, std::unordered_map<page_id_t, lsn_t> *page_lsns) {
+  auto it = page_lsns->find(page_id);
+  if (it != page_lsns->end() && it->second >= lsn) {
+    return nullptr;
+  }
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't fetch a page to redo.");
+  lsn_t page_lsn = PageLSN(page);
+  if (page_lsn >= lsn) {
+    // 页上已经有的修改都不用再读这一页
+    (*page_lsns)[page_id] = page_lsn;
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    return nullptr;
+  }
+  return page;
+}
+
+void LogRecovery::RedoRecord(page_id_t page_id, LogRecord *log_record,
+                             std::unordered_map<page_id_t, lsn_t> *page_lsns) {
+  lsn_t lsn = log_record->lsn_;
+  TablePage *page = FetchPageToRedo(page_id, lsn, page_lsns);
+  if (page == nullptr) {
+    return;
+  }
+  RID rid = ChangedRID(log_record);
+  switch (ChangeType(log_record)) {
+    case LogRecordType::NEWPAGE:
+      if (page_id == log_record->page_id_) {
+        page->Init(page_id, PAGE_SIZE, log_record->prev_page_id_, nullptr, nullptr);
+      } else {
+        page->SetNextPageId(log_record->page_id_);
+      }
+      break;
+    case LogRecordType::INSERT: {
+      // 页面和当初插入时一样，插入会落在同一个槽
+      RID inserted;
+      bool is_inserted = page->InsertTuple(log_record->insert_tuple_, &inserted, nullptr, nullptr, nullptr);
+      BUSTUB_ASSERT(is_inserted && inserted == rid, "Redoing an insert must fill the slot it filled.");
+      break;
+    }
+    case LogRecordType::MARKDELETE:
+      page->MarkDelete(rid, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->ApplyDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->RollbackDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE: {
+      // 页上缺的修改都在之前重做过了，元组就是这次更新之前的样子
+      Tuple current;
+      Tuple updated;
+      Tuple replaced;
+      page->ReadTuple(rid, &current);
+      bool applied = log_record->ApplyUpdate(current, false, &updated);
+      BUSTUB_ASSERT(applied, "Redoing an update must find the bytes it replaced.");
+      page->UpdateTuple(updated, &replaced, rid, nullptr, nullptr, nullptr);
+      break;
+    }
+    default:
+      break;
+  }
+  page->SetLSN(lsn);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
- *iterate through active txn map and undo each operation
+ *roll back the changes of the active transactions, newest first, following
+ *each transaction's prevLSN chain and logging a CLR for every change undone
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  // 所有没结束的事务一起按LSN从新到旧回滚
+  std::priority_queue<std::pair<lsn_t, txn_id_t>> to_undo;
+  for (const auto &[txn_id, last_lsn] : active_txn_) {
+    to_undo.emplace(last_lsn, txn_id);
+  }
+  // 已经被CLR回滚过的记录
+  std::unordered_set<lsn_t> undone;
+  while (!to_undo.empty()) {
+    auto [lsn, txn_id] = to_undo.top();
+    to_undo.pop();
+    // 扫描从最老的活跃事务的BEGIN开始，回滚链上的记录一定在日志里
+    int64_t offset = OffsetOf(lsn);
+    LogRecord log_record;
+    bool read = offset != -1 && ReadLogRecord(offset, &log_record, true);
+    BUSTUB_ASSERT(read, "A record on the prevLSN chain of a transaction is missing from the log.");
+    if (log_record.log_record_type_ != LogRecordType::BEGIN) {
+      if (log_record.log_record_type_ == LogRecordType::CLR) {
+        undone.insert(log_record.undo_lsn_);
+      } else if (undone.erase(lsn) == 0) {
+        UndoRecord(&log_record);
+      }
+      if (log_record.prev_lsn_ != INVALID_LSN) {
+        to_undo.emplace(log_record.prev_lsn_, txn_id);
+        continue;
+      }
+    }
+    // 回滚到了事务的第一条记录
+    LogRecord abort_record(txn_id, active_txn_[txn_id], LogRecordType::ABORT);
+    log_manager_->AppendLogRecord(&abort_record);
+    active_txn_.erase(txn_id);
+  }
+  log_manager_->Flush(log_manager_->GetNextLSN() - 1);
+}
+
+void LogRecovery::UndoRecord(LogRecord *log_record) {
+  txn_id_t txn_id = log_record->txn_id_;
+  RID rid = ChangedRID(log_record);
+  LogRecordType type = log_record->log_record_type_;
+  // NEWPAGE留下一个空页；APPLYDELETE和ROLLBACKDELETE只在提交之后或者作为CLR记录
+  if (type != LogRecordType::INSERT && type != LogRecordType::MARKDELETE && type != LogRecordType::UPDATE) {
+    return;
+  }
+
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't fetch a page to undo.");
+  LogRecord action;
+  switch (type) {
+    case LogRecordType::INSERT:
+      action = LogRecord(txn_id, active_txn_[txn_id], LogRecordType::APPLYDELETE, rid, log_record->insert_tuple_);
+      page->ApplyDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::MARKDELETE:
+      action = LogRecord(txn_id, active_txn_[txn_id], LogRecordType::ROLLBACKDELETE, rid, log_record->delete_tuple_);
+      page->RollbackDelete(rid, nullptr, nullptr);
+      break;
+    default: {
+      // 记录里只有改动的字节，旧的元组要从页上现在的元组算出来
+      Tuple current;
+      Tuple old_tuple;
+      Tuple replaced;
+      page->ReadTuple(rid, &current);
+      bool applied = log_record->ApplyUpdate(current, true, &old_tuple);
+      BUSTUB_ASSERT(applied, "The tuple must hold the update being undone.");
+      action = LogRecord(txn_id, active_txn_[txn_id], LogRecordType::UPDATE, rid, current, old_tuple);
+      page->UpdateTuple(old_tuple, &replaced, rid, nullptr, nullptr, nullptr);
+      break;
+    }
+  }
+  LogRecord clr(log_record->lsn_, std::move(action));
+  lsn_t lsn = log_manager_->AppendLogRecord(&clr);
+  active_txn_[txn_id] = lsn;
+  page->SetLSN(lsn);
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
+}
 
 }  // namespace bustub
@@ -11,8 +11,12 @@
 //===----------------------------------------------------------------------===//
 
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <mutex>  // NOLINT
 #include <string>
@@ -27,31 +31,43 @@ namespace bustub {
 static char *buffer_used;
 
 /**
- * Constructor: open/create a single database file & log file
+ * Constructor: open/create a single database file, and find the segments of
+ * the log. Log segments are only created by the first log write
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file, int log_segment_size)
+    : log_segment_size_(log_segment_size),
+      file_name_(db_file),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  master_name_ = file_name_.substr(0, n) + ".master";
 
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
+  // 段号最小和最大的两个段之间的段都在
+  std::filesystem::path log_path(log_name_);
+  std::string prefix = log_path.filename().string() + ".";
+  std::error_code error;
+  bool found = false;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(log_path.has_parent_path() ? log_path.parent_path() : ".", error)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+        !std::all_of(name.begin() + prefix.size(), name.end(), [](char c) { return std::isdigit(c) != 0; })) {
+      continue;
     }
+    int64_t segment = std::stoll(name.substr(prefix.size()));
+    first_log_segment_ = found ? std::min(first_log_segment_, segment) : segment;
+    last_log_segment_ = found ? std::max(last_log_segment_, segment) : segment;
+    found = true;
   }
+  log_segment_used_ = std::max(GetFileSize(GetLogSegmentName(last_log_segment_)), 0);
 
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
@@ -78,7 +94,9 @@ void DiskManager::ShutDown() {
     std::scoped_lock scoped_db_io_latch(db_io_latch_);
     db_io_.close();
   }
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
   log_io_.close();
+  log_read_io_.close();
 }
 
 /**
@@ -110,6 +128,8 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   if (offset > GetFileSize(file_name_)) {
     LOG_DEBUG("I/O error reading past end of file");
     // std::cerr << "I/O error while reading" << std::endl;
+    // a page that never reached the disk reads as zeros, not as whatever the buffer held before
+    memset(page_data, 0, PAGE_SIZE);
   } else {
     // set read cursor to offset
     db_io_.seekp(offset);
@@ -132,6 +152,7 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
+ * A write that fills the last segment goes on in a new one
  */
 void DiskManager::WriteLog(char *log_data, int size) {
   // enforce swap log buffer
@@ -149,46 +170,183 @@ void DiskManager::WriteLog(char *log_data, int size) {
     assert(flush_log_f_->wait_for(std::chrono::seconds(10)) == std::future_status::ready);
   }
 
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
+  // sequence write, the next read has to reopen the segment
+  log_read_segment_ = -1;
+  while (size > 0) {
+    if (log_segment_used_ == log_segment_size_) {
+      log_io_.close();
+      last_log_segment_++;
+      log_segment_used_ = 0;
+    }
+    if (!log_io_.is_open()) {
+      OpenLogSegment();
+    }
+    int count = std::min(size, log_segment_size_ - log_segment_used_);
+    log_io_.write(log_data, count);
 
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+    // check for I/O error
+    if (log_io_.bad()) {
+      LOG_DEBUG("I/O error while writing log");
+      return;
+    }
+    // needs to flush to keep disk file in sync
+    log_io_.flush();
+    log_data += count;
+    size -= count;
+    log_segment_used_ += count;
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
   flush_log_ = false;
 }
 
 /**
- * Read the contents of the log into the given memory area
- * Always read from the beginning and perform sequence read
+ * Read the contents of the log into the given memory area, a read may span
+ * segments. Reads that continue where the last one stopped do not seek
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
-    return false;
+bool DiskManager::ReadLog(char *log_data, int size, int64_t offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  int read_count = 0;
+  while (read_count < size) {
+    int64_t segment = offset / log_segment_size_;
+    if (offset < 0 || segment < first_log_segment_ || segment > last_log_segment_) {
+      break;
+    }
+    if (segment != log_read_segment_) {
+      log_read_io_.close();
+      log_read_io_.clear();
+      log_read_io_.open(GetLogSegmentName(segment), std::ios::binary);
+      log_read_segment_ = segment;
+      log_read_offset_ = -1;
+    }
+    if (offset != log_read_offset_) {
+      log_read_io_.seekg(offset % log_segment_size_);
+    }
+    int count = static_cast<int>(std::min<int64_t>(size - read_count, (segment + 1) * log_segment_size_ - offset));
+    log_read_io_.read(log_data + read_count, count);
+
+    if (log_read_io_.bad()) {
+      LOG_DEBUG("I/O error while reading log");
+      log_read_segment_ = -1;
+      return false;
+    }
+    int segment_count = log_read_io_.gcount();
+    read_count += segment_count;
+    offset += segment_count;
+    log_read_offset_ = offset;
+    // if log file ends before reading "size"
+    if (segment_count < count) {
+      log_read_io_.clear();
+      break;
+    }
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
+  memset(log_data + read_count, 0, size - read_count);
+  return read_count > 0;
+}
 
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
-    return false;
+/**
+ * Cut the log at offset size, the segments after it are deleted
+ */
+void DiskManager::TruncateLog(int64_t size) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  log_io_.close();
+  log_read_segment_ = -1;
+  int64_t segment = size / log_segment_size_;
+  for (int64_t later = std::max(segment + 1, first_log_segment_); later <= last_log_segment_; later++) {
+    remove(GetLogSegmentName(later).c_str());
+  }
+  if (segment > last_log_segment_) {
+    return;
+  }
+  last_log_segment_ = std::max(segment, first_log_segment_);
+  log_segment_used_ = static_cast<int>(size - last_log_segment_ * log_segment_size_);
+  std::string segment_name = GetLogSegmentName(last_log_segment_);
+  if (GetFileSize(segment_name) >= 0 && truncate(segment_name.c_str(), log_segment_used_) != 0) {
+    LOG_DEBUG("I/O error while truncating log");
+  }
+}
+
+/**
+ * Delete or archive the segments before the one offset is in
+ */
+void DiskManager::ReleaseLogBefore(int64_t offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  // 正在写的最后一段总是留着
+  int64_t end = std::min(offset / log_segment_size_, last_log_segment_);
+  for (; first_log_segment_ < end; first_log_segment_++) {
+    if (log_read_segment_ == first_log_segment_) {
+      log_read_io_.close();
+      log_read_segment_ = -1;
+    }
+    std::filesystem::path segment_path(GetLogSegmentName(first_log_segment_));
+    std::error_code error;
+    if (log_archive_dir_.empty()) {
+      std::filesystem::remove(segment_path, error);
+    } else {
+      std::filesystem::path archive_path = std::filesystem::path(log_archive_dir_) / segment_path.filename();
+      std::filesystem::create_directories(log_archive_dir_, error);
+      std::filesystem::rename(segment_path, archive_path, error);
+      if (error) {
+        // 归档目录在别的文件系统上就只能复制
+        error.clear();
+        std::filesystem::copy_file(segment_path, archive_path, std::filesystem::copy_options::overwrite_existing,
+                                   error);
+        if (!error) {
+          std::filesystem::remove(segment_path, error);
+        }
+      }
+    }
+    if (error) {
+      LOG_DEBUG("I/O error while releasing log segment");
+    }
+  }
+}
+
+void DiskManager::SetLogArchiveDirectory(const std::string &archive_dir) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  log_archive_dir_ = archive_dir;
+}
+
+/**
+ * Replace the master record, the file is rewritten as a whole
+ */
+void DiskManager::WriteMasterRecord(const char *data, int size) {
+  std::ofstream master_io(master_name_, std::ios::binary | std::ios::trunc);
+  master_io.write(data, size);
+  master_io.flush();
+  if (master_io.bad()) {
+    LOG_DEBUG("I/O error while writing master record");
   }
-  // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
-  if (read_count < size) {
-    log_io_.clear();
-    memset(log_data + read_count, 0, size - read_count);
+}
+
+/**
+ * Read the master record
+ * @return: false means there is no complete master record
+ */
+bool DiskManager::ReadMasterRecord(char *data, int size) {
+  std::ifstream master_io(master_name_, std::ios::binary);
+  if (!master_io.is_open()) {
+    return false;
   }
+  master_io.read(data, size);
+  return master_io.gcount() == size;
+}
+
+/**
+ * Returns the offset of the first byte kept in the log
+ */
+int64_t DiskManager::GetLogStart() {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return first_log_segment_ * log_segment_size_;
+}
 
-  return true;
+/**
+ * Returns the offset of the end of the log
+ */
+int64_t DiskManager::GetLogSize() {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return last_log_segment_ * log_segment_size_ + log_segment_used_;
 }
 
 /**
@@ -215,4 +373,21 @@ int DiskManager::GetFileSize(const std::string &file_name) {
   return rc == 0 ? static_cast<int>(stat_buf.st_size) : -1;
 }
 
+/**
+ * Private helper function to get the file name of a log segment
+ */
+std::string DiskManager::GetLogSegmentName(int64_t segment) const { return log_name_ + "." + std::to_string(segment); }
+
+/**
+ * Private helper function to open the last log segment for appending
+ */
+void DiskManager::OpenLogSegment() {
+  std::string segment_name = GetLogSegmentName(last_log_segment_);
+  log_io_.clear();
+  log_io_.open(segment_name, std::ios::binary | std::ios::app | std::ios::out);
+  if (!log_io_.is_open()) {
+    throw Exception("can't open dblog file");
+  }
+}
+
 }  // namespace bustub
@@ -10,13 +10,25 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <mutex>  // NOLINT
+#include <numeric>
 
 #include "common/logger.h"
+#include "concurrency/version_store.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
+/** Abort a read-only transaction that tries to write, before it touches its write set, which it does not have. */
+static void CheckWritable(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::WRITE_ON_READ_ONLY);
+  }
+}
+
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
                      page_id_t first_page_id)
     : buffer_pool_manager_(buffer_pool_manager),
@@ -25,8 +37,11 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
       first_page_id_(first_page_id) {}
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     Transaction *txn)
-    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager) {
+                     Transaction *txn, table_oid_t table_oid)
+    : buffer_pool_manager_(buffer_pool_manager),
+      lock_manager_(lock_manager),
+      log_manager_(log_manager),
+      table_oid_(table_oid) {
   // Initialize the first table page.
   auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
   BUSTUB_ASSERT(first_page != nullptr, "Couldn't create a page for the table heap.");
@@ -37,6 +52,7 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
 }
 
 bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
+  CheckWritable(txn);
   if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
@@ -51,7 +67,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   cur_page->WLatch();
   // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
   // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  while (!cur_page->InsertTuple(tuple, rid, txn, GetRowLockManager(txn), log_manager_)) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
@@ -76,22 +92,39 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       new_page->WLatch();
       cur_page->SetNextPageId(next_page_id);
       new_page->Init(next_page_id, PAGE_SIZE, cur_page->GetTablePageId(), log_manager_, txn);
+      // The link to the new page is redone with the NEWPAGE record, it must not reach the disk before it.
+      if (enable_logging) {
+        cur_page->SetLSN(new_page->GetLSN());
+      }
       cur_page->WUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
       cur_page = new_page;
     }
   }
+  // Register the insert before unlatching, so that snapshot readers never see the new tuple without its chain.
+  // The write set grows under the write latch, a snapshot that begins now records the insert from there if the
+  // transaction was not versioned.
+  {
+    std::scoped_lock write_lock(*txn->GetWriteLatch());
+    if (txn->GetVersionStore() != nullptr) {
+      txn->GetVersionStore()->RecordWrite(txn, *rid, nullptr);
+    }
+    txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this, txn->GetPrevLSN());
+  }
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
-  // Update the transaction's write set.
-  txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this);
   return true;
 }
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // TODO(Amadou): remove empty page
+  CheckWritable(txn);
+  VersionStore *versions = txn->GetVersionStore();
+  if (versions != nullptr) {
+    versions->CheckWrite(txn, rid);
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -101,15 +134,31 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  bool is_marked = page->MarkDelete(rid, txn, GetRowLockManager(txn), log_manager_);
+  // Marking a tuple keeps its image, which is what snapshot readers see until the delete commits.
+  Tuple old_tuple;
+  if (is_marked) {
+    page->ReadTuple(rid, &old_tuple);
+  }
+  // Update the transaction's write set.
+  {
+    std::scoped_lock write_lock(*txn->GetWriteLatch());
+    if (is_marked && versions != nullptr) {
+      versions->RecordWrite(txn, rid, &old_tuple);
+    }
+    txn->GetWriteSet()->emplace_back(rid, WType::DELETE, old_tuple, this, is_marked ? txn->GetPrevLSN() : INVALID_LSN);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
-  // Update the transaction's write set.
-  txn->GetWriteSet()->emplace_back(rid, WType::DELETE, Tuple{}, this);
   return true;
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  CheckWritable(txn);
+  VersionStore *versions = txn->GetVersionStore();
+  if (versions != nullptr) {
+    versions->CheckWrite(txn, rid);
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -120,13 +169,19 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
-  page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
+  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, GetRowLockManager(txn), log_manager_);
   // Update the transaction's write set.
-  if (is_updated && txn->GetState() != TransactionState::ABORTED) {
-    txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
+  if (is_updated) {
+    std::scoped_lock write_lock(*txn->GetWriteLatch());
+    if (versions != nullptr) {
+      versions->RecordWrite(txn, rid, &old_tuple);
+    }
+    if (txn->GetState() != TransactionState::ABORTED) {
+      txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this, txn->GetPrevLSN());
+    }
   }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   return is_updated;
 }
 
@@ -135,6 +190,7 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Delete the tuple from the page.
+  BUSTUB_ASSERT(!enable_logging || IsExclusiveLocked(txn, rid), "We must own the exclusive lock!");
   page->WLatch();
   page->ApplyDelete(rid, txn, log_manager_);
   lock_manager_->Unlock(txn, rid);
@@ -147,12 +203,59 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Rollback the delete.
+  BUSTUB_ASSERT(!enable_logging || IsExclusiveLocked(txn, rid), "We must own an exclusive lock on the RID.");
   page->WLatch();
   page->RollbackDelete(rid, txn, log_manager_);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
+void TableHeap::FinishWrites(const std::vector<const TableWriteRecord *> &writes, bool commit, Transaction *txn) {
+  // Group the writes by page, a stable sort keeps the writes to one page newest first.
+  std::vector<const TableWriteRecord *> order(writes);
+  std::stable_sort(order.begin(), order.end(), [](const TableWriteRecord *lhs, const TableWriteRecord *rhs) {
+    return lhs->rid_.GetPageId() < rhs->rid_.GetPageId();
+  });
+
+  TablePage *page = nullptr;
+  for (const auto *write : order) {
+    // A commit only has deletes left to apply.
+    if (commit && write->wtype_ != WType::DELETE) {
+      continue;
+    }
+    const RID &rid = write->rid_;
+    if (page == nullptr || page->GetTablePageId() != rid.GetPageId()) {
+      if (page != nullptr) {
+        page->WUnlatch();
+        buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+      }
+      page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+      BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+      page->WLatch();
+    }
+    BUSTUB_ASSERT(!enable_logging || IsExclusiveLocked(txn, rid), "We must own the exclusive lock!");
+    // A rollback is logged as a CLR of the write, so that recovery never undoes the write twice.
+    if (write->wtype_ == WType::DELETE && !commit) {
+      page->RollbackDelete(rid, txn, log_manager_, write->lsn_);
+    } else if (write->wtype_ == WType::UPDATE) {
+      // The transaction already owns the row's version chain, there is nothing to record. It also still holds the
+      // row's lock, and an aborted transaction could not lock it again.
+      Tuple replaced;
+      bool rolled_back = page->UpdateTuple(write->tuple_, &replaced, rid, txn, nullptr, log_manager_, write->lsn_);
+      BUSTUB_ASSERT(rolled_back, "Rolling back an update should always work.");
+    } else {
+      // Applying a delete on commit, or rolling back an insert. Note that this also releases the lock when
+      // holding the page latch.
+      page->ApplyDelete(rid, txn, log_manager_, commit ? INVALID_LSN : write->lsn_);
+      lock_manager_->Unlock(txn, rid);
+    }
+  }
+  if (page != nullptr) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+  }
+}
+
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -164,11 +267,85 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   // Read the tuple from the page.
   page->RLatch();
   bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  // Record the version of the image under the same latch.
+  if (res && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    res = txn->GetVersionStore()->ReadOptimistic(txn, rid, tuple);
+  }
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
   return res;
 }
 
+void TableHeap::GetTuples(const std::vector<RID> &rids, std::vector<Tuple> *tuples, std::vector<bool> *found,
+                          Transaction *txn) {
+  tuples->assign(rids.size(), Tuple());
+  found->assign(rids.size(), false);
+
+  // Visit the RIDs sorted by page and slot, remembering where each one belongs in the output.
+  std::vector<size_t> order(rids.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return rids[lhs].Get() < rids[rhs].Get(); });
+
+  TablePage *page = nullptr;
+  for (auto idx : order) {
+    const RID &rid = rids[idx];
+    if (page == nullptr || page->GetTablePageId() != rid.GetPageId()) {
+      if (page != nullptr) {
+        page->RUnlatch();
+        buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+      }
+      page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+      // If the page could not be found, then abort the transaction.
+      if (page == nullptr) {
+        txn->SetState(TransactionState::ABORTED);
+        return;
+      }
+      page->RLatch();
+    }
+    (*found)[idx] = page->GetTuple(rid, &(*tuples)[idx], txn, lock_manager_);
+    if ((*found)[idx] && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+      (*found)[idx] = txn->GetVersionStore()->ReadOptimistic(txn, rid, &(*tuples)[idx]);
+    }
+  }
+  if (page != nullptr) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+  }
+}
+
+page_id_t TableHeap::GetSnapshotPage(page_id_t page_id, std::vector<Tuple> *tuples, Transaction *txn) {
+  tuples->clear();
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  // If the page could not be found, then abort the transaction.
+  if (page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return INVALID_PAGE_ID;
+  }
+  page->RLatch();
+  // Read every image the page holds, including the deleted ones, and resolve them under the same latch.
+  uint32_t slot_count = page->GetSlotCount();
+  std::vector<RID> rids;
+  std::vector<Tuple> images(slot_count);
+  std::vector<bool> exists(slot_count, false);
+  rids.reserve(slot_count);
+  for (uint32_t i = 0; i < slot_count; i++) {
+    rids.emplace_back(page_id, i);
+    bool is_deleted = false;
+    exists[i] = page->ReadTuple(rids.back(), &images[i], &is_deleted) && !is_deleted;
+  }
+  txn->GetVersionStore()->GetVisibleVersions(txn, rids, &images, &exists);
+  auto next_page_id = page->GetNextPageId();
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, false);
+
+  for (uint32_t i = 0; i < slot_count; i++) {
+    if (exists[i]) {
+      tuples->emplace_back(std::move(images[i]));
+    }
+  }
+  return next_page_id;
+}
+
 TableIterator TableHeap::Begin(Transaction *txn) {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
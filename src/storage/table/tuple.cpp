@@ -96,6 +96,15 @@ Value Tuple::GetValue(const Schema *schema, const uint32_t column_idx) const {
   return Value::DeserializeFrom(data_ptr, column_type);
 }
 
+void Tuple::SetValue(const Schema *schema, const uint32_t column_idx, const Value &value) {
+  assert(schema);
+  assert(allocated_);
+  const auto &col = schema->GetColumn(column_idx);
+  // Only inlined columns have a fixed size, anything else would change the tuple layout.
+  assert(col.IsInlined());
+  value.SerializeTo(data_ + col.GetOffset());
+}
+
 Tuple Tuple::KeyFromTuple(const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs) {
   std::vector<Value> values;
   values.reserve(key_attrs.size());
@@ -152,13 +161,17 @@ void Tuple::SerializeTo(char *storage) const {
 
 void Tuple::DeserializeFrom(const char *storage) {
   uint32_t size = *reinterpret_cast<const uint32_t *>(storage);
+  DeserializeFrom(storage + sizeof(int32_t), size);
+}
+
+void Tuple::DeserializeFrom(const char *data, uint32_t size) {
   // Construct a tuple.
   this->size_ = size;
   if (this->allocated_) {
     delete[] this->data_;
   }
   this->data_ = new char[this->size_];
-  memcpy(this->data_, storage + sizeof(int32_t), this->size_);
+  memcpy(this->data_, data, this->size_);
   this->allocated_ = true;
 }
 
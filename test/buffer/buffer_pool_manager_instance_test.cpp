@@ -14,6 +14,8 @@
 #include <cstdio>
 #include <random>
 #include <string>
+#include <utility>
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 
@@ -141,4 +143,58 @@ TEST(BufferPoolManagerInstanceTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, DirtyPageTableTest) {
+  const std::string db_name = "test.db";
+  auto *disk_manager = new DiskManager(db_name);
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(4, disk_manager, log_manager);
+  auto in_table = [bpm, log_manager](page_id_t page_id) {
+    std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+    bpm->GetDirtyPageTable(&dirty_pages);
+    for (const auto &[dirty_page_id, rec_lsn] : dirty_pages) {
+      if (dirty_page_id == page_id) {
+        EXPECT_EQ(log_manager->GetNextLSN(), rec_lsn);
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Scenario: a pinned page may be changed by its user, it is in the table until it is unpinned clean.
+  page_id_t page_id;
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+  EXPECT_TRUE(in_table(page_id));
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  EXPECT_FALSE(in_table(page_id));
+
+  // Scenario: a dirty page stays in the table until it is flushed.
+  ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  EXPECT_TRUE(in_table(page_id));
+  EXPECT_TRUE(bpm->FlushPage(page_id));
+  EXPECT_FALSE(in_table(page_id));
+
+  // Scenario: a page flushed while pinned keeps its recovery LSN, its user may have logged a change
+  // that is not on the page yet.
+  ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+  lsn_t rec_lsn = log_manager->GetNextLSN();
+  LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+  log_manager->AppendLogRecord(&log_record);
+  EXPECT_TRUE(bpm->FlushPage(page_id));
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  bpm->GetDirtyPageTable(&dirty_pages);
+  ASSERT_EQ(1, dirty_pages.size());
+  EXPECT_EQ(page_id, dirty_pages[0].first);
+  EXPECT_EQ(rec_lsn, dirty_pages[0].second);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+}
+
 }  // namespace bustub
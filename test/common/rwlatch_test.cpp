@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
 #include <thread>  // NOLINT
 #include <vector>
 
@@ -57,4 +58,45 @@ TEST(RWLatchTest, BasicTest) {
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+// NOLINTNEXTLINE
+TEST(RWLatchTest, WriterPreferenceTest) {
+  ReaderWriterLatch latch;
+  std::atomic<bool> written{false};
+  std::atomic<bool> reader_started{false};
+  std::atomic<bool> read{false};
+  bool read_after_write = false;
+
+  // A writer waits for the reader holding the latch.
+  latch.RLock();
+  std::thread writer([&] {
+    latch.WLock();
+    written = true;
+    latch.WUnlock();
+  });
+  while (!latch.IsWriterPending()) {
+    std::this_thread::yield();
+  }
+
+  // A reader arriving after the waiting writer has to let it go first.
+  std::thread reader([&] {
+    reader_started = true;
+    latch.RLock();
+    read_after_write = written;
+    read = true;
+    latch.RUnlock();
+  });
+  while (!reader_started) {
+    std::this_thread::yield();
+  }
+  // Neither can get in while the first reader holds the latch.
+  EXPECT_TRUE(latch.IsWriterPending());
+  EXPECT_FALSE(written);
+  EXPECT_FALSE(read);
+  latch.RUnlock();
+
+  writer.join();
+  reader.join();
+  EXPECT_TRUE(read_after_write);
+}
 }  // namespace bustub
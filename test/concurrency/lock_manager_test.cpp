@@ -215,6 +215,7 @@
  */
 
 #include <atomic>
+#include <numeric>
 #include <random>
 
 #include "common/exception.h"
@@ -808,4 +809,427 @@ TEST(LockManagerTest, WoundWaitFairnessTest) {
   }
 }
 
+
+/*
+ * Description: transactions locking disjoint rows spread over all lock table shards
+ * never wait for each other, and LockExclusive upgrades a shared lock the transaction holds.
+ */
+TEST(LockManagerTest, ShardedLockTableTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const int num_threads = 8;
+  const int rows_per_thread = 200;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      Transaction txn(t);
+      txn_mgr.Begin(&txn);
+      for (int i = 0; i < rows_per_thread; i++) {
+        RID rid{t, static_cast<uint32_t>(i)};
+        EXPECT_TRUE(lock_mgr.LockShared(&txn, rid));
+        EXPECT_TRUE(lock_mgr.LockExclusive(&txn, rid));
+      }
+      CheckGrowing(&txn);
+      CheckTxnLockSize(&txn, 0, rows_per_thread);
+      txn_mgr.Commit(&txn);
+      CheckTxnLockSize(&txn, 0, 0);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+}
+
+/*
+ * Description: request queues are reclaimed once their last lock is released,
+ * also when the queue had waiters or a wounded lock in it.
+ */
+TEST(LockManagerTest, ReclaimQueueTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+
+  // txn0 wounds txn1, which holds the lock.
+  Transaction txn0(0);
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, rid));
+  EXPECT_EQ(1, lock_mgr.GetQueueCount());
+  EXPECT_TRUE(lock_mgr.LockShared(&txn0, rid));
+  EXPECT_EQ(TransactionState::ABORTED, txn1.GetState());
+  txn_mgr.Abort(&txn1);
+  EXPECT_EQ(1, lock_mgr.GetQueueCount());
+  txn_mgr.Commit(&txn0);
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+
+  // txn3 waits for txn2.
+  Transaction txn2(2);
+  Transaction txn3(3);
+  txn_mgr.Begin(&txn2);
+  txn_mgr.Begin(&txn3);
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn2, rid));
+  std::thread waiter([&] { EXPECT_TRUE(lock_mgr.LockExclusive(&txn3, rid)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  txn_mgr.Commit(&txn2);
+  waiter.join();
+  EXPECT_EQ(1, lock_mgr.GetQueueCount());
+  txn_mgr.Commit(&txn3);
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+}
+
+/*
+ * Description: intention locks on a table are compatible with each other, a SHARED table lock
+ * waits for writers and covers the row locks of its transaction, and upgrades combine modes.
+ */
+TEST(LockManagerTest, TableLockTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+  RID rid{0, 0};
+
+  Transaction txn0(0);
+  Transaction txn1(1);
+  Transaction txn2(2);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  txn_mgr.Begin(&txn2);
+
+  // txn1 writes a row, txn2 reads another one: IX and IS are compatible.
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, oid, rid));
+  EXPECT_EQ(TableLockMode::INTENTION_EXCLUSIVE, txn1.GetTableLockSet()->at(oid));
+  EXPECT_TRUE(lock_mgr.LockShared(&txn2, oid, RID{0, 1}));
+  EXPECT_EQ(TableLockMode::INTENTION_SHARED, txn2.GetTableLockSet()->at(oid));
+  CheckTxnLockSize(&txn1, 0, 1);
+  CheckTxnLockSize(&txn2, 1, 0);
+
+  // txn2 waits for txn1 to release its IX lock before it can read the whole table.
+  std::atomic<bool> granted{false};
+  std::thread reader([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(&txn2, oid, TableLockMode::SHARED));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(&txn1);
+  reader.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(TableLockMode::SHARED, txn2.GetTableLockSet()->at(oid));
+
+  // The table lock covers the rows, no row lock is taken.
+  EXPECT_TRUE(lock_mgr.LockShared(&txn2, oid, RID{0, 2}));
+  CheckTxnLockSize(&txn2, 1, 0);
+  // Writing a row as well upgrades to SHARED_INTENTION_EXCLUSIVE.
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn2, oid, RID{0, 2}));
+  EXPECT_EQ(TableLockMode::SHARED_INTENTION_EXCLUSIVE, txn2.GetTableLockSet()->at(oid));
+  CheckTxnLockSize(&txn2, 1, 1);
+
+  // txn0 is older and wounds txn2 to lock the whole table.
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::EXCLUSIVE));
+  EXPECT_EQ(TransactionState::ABORTED, txn2.GetState());
+  txn_mgr.Abort(&txn2);
+  EXPECT_TRUE(txn2.GetTableLockSet()->empty());
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, oid, rid));
+  CheckTxnLockSize(&txn0, 0, 0);
+  txn_mgr.Commit(&txn0);
+  EXPECT_TRUE(txn0.GetTableLockSet()->empty());
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+}
+
+/*
+ * Description: a read-only transaction goes through the table-aware API without taking a lock,
+ * and any write aborts it.
+ */
+TEST(LockManagerTest, ReadOnlyTableLockTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+  RID rid{0, 0};
+
+  Transaction *txn = txn_mgr.Begin(nullptr, IsolationLevel::REPEATABLE_READ, true);
+  EXPECT_TRUE(lock_mgr.LockShared(txn, oid, rid));
+  EXPECT_TRUE(lock_mgr.LockTable(txn, oid, TableLockMode::SHARED));
+  EXPECT_TRUE(lock_mgr.Unlock(txn, rid));
+  EXPECT_TRUE(lock_mgr.UnlockTable(txn, oid));
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+  EXPECT_EQ(TransactionState::GROWING, txn->GetState());
+
+  try {
+    lock_mgr.LockExclusive(txn, oid, rid);
+    FAIL();
+  } catch (TransactionAbortException &e) {
+    EXPECT_EQ(AbortReason::WRITE_ON_READ_ONLY, e.GetAbortReason());
+  }
+  EXPECT_EQ(TransactionState::ABORTED, txn->GetState());
+  txn_mgr.Abort(txn);
+  delete txn;
+}
+
+/*
+ * Description: a table lock upgrade keeps the mode already granted while it waits, so a request
+ * queued before the upgrade cannot be granted over it.
+ */
+TEST(LockManagerTest, TableLockUpgradeTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+
+  Transaction txn0(0);
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::SHARED));
+  // txn1 queues behind txn0's SHARED lock.
+  std::atomic<bool> granted{false};
+  std::thread writer([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(&txn1, oid, TableLockMode::EXCLUSIVE));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+
+  // The upgrade only waits for granted requests, and txn1 still waits for it.
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::EXCLUSIVE));
+  EXPECT_EQ(TableLockMode::EXCLUSIVE, txn0.GetTableLockSet()->at(oid));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+
+  txn_mgr.Commit(&txn0);
+  writer.join();
+  EXPECT_TRUE(granted);
+  txn_mgr.Commit(&txn1);
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+}
+
+/*
+ * Description: a transaction that locks more rows of a table than the escalation threshold
+ * gets a table lock instead, and the row locks it covers are released.
+ */
+TEST(LockManagerTest, LockEscalationTest) {
+  const size_t threshold = 10;
+  LockManager lock_mgr{DeadlockPolicy::WOUND_WAIT, threshold};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+
+  Transaction txn0(0);
+  txn_mgr.Begin(&txn0);
+  for (uint32_t i = 0; i < threshold; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(&txn0, oid, RID{0, i}));
+  }
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, oid, RID{0, 0}));
+  CheckTxnLockSize(&txn0, threshold - 1, 1);
+  EXPECT_EQ(TableLockMode::INTENTION_EXCLUSIVE, txn0.GetTableLockSet()->at(oid));
+
+  // Reading one more row escalates to SIX, only the exclusive row lock is left.
+  EXPECT_TRUE(lock_mgr.LockShared(&txn0, oid, RID{0, threshold}));
+  EXPECT_EQ(TableLockMode::SHARED_INTENTION_EXCLUSIVE, txn0.GetTableLockSet()->at(oid));
+  CheckTxnLockSize(&txn0, 0, 1);
+  CheckGrowing(&txn0);
+
+  // Writing rows escalates to X once there are threshold exclusive row locks.
+  for (uint32_t i = 1; i <= threshold; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, oid, RID{1, i}));
+  }
+  EXPECT_EQ(TableLockMode::EXCLUSIVE, txn0.GetTableLockSet()->at(oid));
+  CheckTxnLockSize(&txn0, 0, 0);
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+
+  txn_mgr.Commit(&txn0);
+  EXPECT_TRUE(txn0.GetTableLockSet()->empty());
+  EXPECT_TRUE(txn0.GetTableRowLockSet()->empty());
+}
+
+/*
+ * Description: under wait-die a younger transaction aborts instead of waiting for an older one,
+ * an older transaction waits for a younger one.
+ */
+TEST(LockManagerTest, WaitDieTest) {
+  LockManager lock_mgr{DeadlockPolicy::WAIT_DIE};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+
+  Transaction txn0(0);
+  Transaction txn1(1);
+  Transaction txn2(2);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  txn_mgr.Begin(&txn2);
+
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, rid));
+  EXPECT_THROW(lock_mgr.LockShared(&txn2, rid), TransactionAbortException);
+  EXPECT_EQ(TransactionState::ABORTED, txn2.GetState());
+  txn_mgr.Abort(&txn2);
+
+  std::atomic<bool> granted{false};
+  std::thread waiter([&] {
+    EXPECT_TRUE(lock_mgr.LockShared(&txn0, rid));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  EXPECT_EQ(TransactionState::GROWING, txn1.GetState());
+  txn_mgr.Commit(&txn1);
+  waiter.join();
+  EXPECT_TRUE(granted);
+  txn_mgr.Commit(&txn0);
+}
+
+/*
+ * Description: the waits-for graph reports the newest transaction of a cycle.
+ */
+TEST(LockManagerTest, GraphTest) {
+  LockManager lock_mgr{DeadlockPolicy::DETECTION};
+  txn_id_t victim = INVALID_TXN_ID;
+
+  lock_mgr.AddEdge(0, 1);
+  lock_mgr.AddEdge(1, 2);
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+  lock_mgr.AddEdge(2, 0);
+  lock_mgr.AddEdge(3, 0);
+  EXPECT_EQ(4, lock_mgr.GetEdgeList().size());
+  EXPECT_TRUE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(2, victim);
+  lock_mgr.RemoveEdge(1, 2);
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+}
+
+/*
+ * Description: with deadlock detection, transactions wait for younger ones, and the background
+ * thread aborts the youngest transaction once they wait for each other.
+ */
+TEST(LockManagerTest, DeadlockDetectionTest) {
+  LockManager lock_mgr{DeadlockPolicy::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{0, 1};
+
+  Transaction txn0(0);
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, rid1));
+
+  std::thread older([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, rid1));
+    txn_mgr.Commit(&txn0);
+  });
+  // Waiting without a deadlock aborts nobody.
+  std::this_thread::sleep_for(cycle_detection_interval * 3);
+  EXPECT_EQ(TransactionState::GROWING, txn1.GetState());
+
+  EXPECT_THROW(lock_mgr.LockExclusive(&txn1, rid0), TransactionAbortException);
+  EXPECT_EQ(TransactionState::ABORTED, txn1.GetState());
+  txn_mgr.Abort(&txn1);
+  older.join();
+  EXPECT_EQ(TransactionState::COMMITTED, txn0.GetState());
+  EXPECT_EQ(0, lock_mgr.GetQueueCount());
+}
+
+
+/*
+ * Description: finished transactions leave the registry, lookups run concurrently with begins and commits.
+ */
+TEST(LockManagerTest, TransactionRegistryTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const int num_threads = 8;
+  const int txns_per_thread = 2000;
+  size_t registered = TransactionManager::txn_registry.Size();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < txns_per_thread; i++) {
+        Transaction *txn = txn_mgr.Begin();
+        txn_id_t txn_id = txn->GetTransactionId();
+        EXPECT_EQ(txn, TransactionManager::GetTransaction(txn_id));
+        // Look up the other threads' transactions while they come and go.
+        TransactionManager::GetTransaction(txn_id - 1);
+        if (i % 2 == 0) {
+          txn_mgr.Commit(txn);
+        } else {
+          txn_mgr.Abort(txn);
+        }
+        // Earlier tests may have left an unfinished transaction with the same id behind.
+        EXPECT_NE(txn, TransactionManager::GetTransaction(txn_id));
+        delete txn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(registered, TransactionManager::txn_registry.Size());
+}
+
+/*
+ * Description: the lock manager counts grants, waits, wounds and aborts, and reports the RIDs waited for most.
+ */
+TEST(LockManagerTest, LockStatsTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  LockStats *stats = lock_mgr.GetStats();
+  RID hot_rid{0, 0};
+  RID cold_rid{0, 1};
+
+  Transaction txn0(0);
+  Transaction txn1(1);
+  Transaction txn2(2);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  txn_mgr.Begin(&txn2);
+
+  // A younger transaction waits for the exclusive lock of an older one.
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, hot_rid));
+  EXPECT_TRUE(lock_mgr.LockShared(&txn0, cold_rid));
+  std::thread waiter([&] { EXPECT_TRUE(lock_mgr.LockShared(&txn1, hot_rid)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  txn_mgr.Commit(&txn0);
+  waiter.join();
+
+  EXPECT_EQ(1U, stats->GetAcquisitions(LockStatsMode::ROW_EXCLUSIVE));
+  EXPECT_EQ(2U, stats->GetAcquisitions(LockStatsMode::ROW_SHARED));
+  EXPECT_EQ(1U, stats->GetWaits(LockStatsMode::ROW_SHARED));
+  EXPECT_EQ(0U, stats->GetWaits(LockStatsMode::ROW_EXCLUSIVE));
+  EXPECT_GT(stats->GetWaitTime(LockStatsMode::ROW_SHARED).count(), 0);
+  auto histogram = stats->GetWaitHistogram(LockStatsMode::ROW_SHARED);
+  EXPECT_EQ(1U, std::accumulate(histogram.begin(), histogram.end(), uint64_t{0}));
+  histogram = stats->GetWaitHistogram(LockStatsMode::ROW_EXCLUSIVE);
+  EXPECT_EQ(0U, std::accumulate(histogram.begin(), histogram.end(), uint64_t{0}));
+  auto hot_rids = stats->GetHotRids(10);
+  ASSERT_EQ(1U, hot_rids.size());
+  EXPECT_EQ(hot_rid, hot_rids[0].first);
+  EXPECT_EQ(1U, hot_rids[0].second);
+
+  // The older transaction wounds the younger one sharing the row when it upgrades its lock. The wound is
+  // the one abort of the younger transaction, though it was not waiting.
+  EXPECT_TRUE(lock_mgr.LockShared(&txn2, cold_rid));
+  EXPECT_TRUE(lock_mgr.LockShared(&txn1, cold_rid));
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, cold_rid));
+  EXPECT_EQ(1U, stats->GetWounds());
+  EXPECT_EQ(1U, stats->GetAborts(AbortReason::DEADLOCK));
+  EXPECT_EQ(TransactionState::ABORTED, txn2.GetState());
+  EXPECT_FALSE(lock_mgr.LockShared(&txn2, hot_rid));
+  EXPECT_EQ(1U, stats->GetAborts(AbortReason::DEADLOCK));
+  txn_mgr.Abort(&txn2);
+  txn_mgr.Commit(&txn1);
+
+  Transaction txn3(3);
+  txn_mgr.Begin(&txn3);
+  lock_mgr.LockShared(&txn3, hot_rid);
+  lock_mgr.Unlock(&txn3, hot_rid);
+  EXPECT_THROW(lock_mgr.LockShared(&txn3, hot_rid), TransactionAbortException);
+  EXPECT_EQ(1U, stats->GetAborts(AbortReason::LOCK_ON_SHRINKING));
+  txn_mgr.Abort(&txn3);
+
+  stats->Reset();
+  EXPECT_EQ(0U, stats->GetAcquisitions(LockStatsMode::ROW_SHARED));
+  EXPECT_EQ(0U, stats->GetWounds());
+  EXPECT_TRUE(stats->GetHotRids(10).empty());
+}
+
 }  // namespace bustub
\ No newline at end of file
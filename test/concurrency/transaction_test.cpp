@@ -260,10 +260,12 @@
  */
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
 #include <memory>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -327,8 +329,10 @@ class GradingTransactionTest : public ::testing::Test {
 
   // This function is called after every test.
   void TearDown() override {
-    // Commit our transaction.
-    txn_mgr_->Commit(txn_);
+    // Commit our transaction, unless the test has committed it to publish the generated tables.
+    if (txn_->GetState() != TransactionState::COMMITTED) {
+      txn_mgr_->Commit(txn_);
+    }
     // Shut down the disk manager and clean up the transaction.
     disk_manager_->ShutDown();
     remove("executor_test.db");
@@ -593,6 +597,343 @@ TEST_F(GradingTransactionTest, SimpleUpdateRollbackTest) {
   delete txn3;
 }
 
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, BatchedRollbackTest) {
+  // txn1: UPDATE test_1 SET colB = colB + 1, then DELETE FROM test_1, over every page of the table
+  // txn1: abort, every row is back as it was
+  // txn2: DELETE FROM test_1, commit
+  auto table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  auto scan_plan = std::make_unique<SeqScanPlanNode>(out_schema, nullptr, table_info->oid_);
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(1, UpdateInfo(UpdateType::Add, 1)));
+  auto update_plan = std::make_unique<UpdatePlanNode>(scan_plan.get(), table_info->oid_, update_attrs);
+  auto delete_plan = std::make_unique<DeletePlanNode>(scan_plan.get(), table_info->oid_);
+  auto key_schema = ParseCreateStatement("a bigint");
+  auto index_info = GetExecutorContext()->GetCatalog()->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(
+      GetTxn(), "index1", "test_1", schema, *key_schema, {0}, 8, HashFunction<GenericKey<8>>{});
+  GetTxnManager()->Commit(GetTxn());
+
+  auto scan_all = [&]() {
+    std::vector<std::pair<int32_t, int32_t>> rows;
+    auto txn = GetTxnManager()->Begin();
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(scan_plan.get(), &result_set, txn, exec_ctx.get());
+    GetTxnManager()->Commit(txn);
+    delete txn;
+    for (const auto &tuple : result_set) {
+      rows.emplace_back(tuple.GetValue(out_schema, 0).GetAs<int32_t>(),
+                        tuple.GetValue(out_schema, 1).GetAs<int32_t>());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+  auto before = scan_all();
+  ASSERT_EQ(before.size(), TEST1_SIZE);
+
+  auto txn1 = GetTxnManager()->Begin();
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(update_plan.get(), nullptr, txn1, exec_ctx1.get());
+  GetExecutionEngine()->Execute(delete_plan.get(), nullptr, txn1, exec_ctx1.get());
+  ASSERT_EQ(txn1->GetWriteSet()->size(), 2 * TEST1_SIZE);
+  GetTxnManager()->Abort(txn1);
+  ASSERT_TRUE(txn1->GetWriteSet()->empty());
+  ASSERT_TRUE(txn1->GetIndexWriteSet()->empty());
+  delete txn1;
+  ASSERT_EQ(scan_all(), before);
+
+  // The index holds every key again, once.
+  auto txn2 = GetTxnManager()->Begin();
+  std::vector<RID> rids;
+  Tuple key(std::vector<Value>{ValueFactory::GetIntegerValue(before[0].first)}, index_info->index_->GetKeySchema());
+  index_info->index_->ScanKey(key, &rids, txn2);
+  ASSERT_EQ(rids.size(), 1);
+
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(delete_plan.get(), nullptr, txn2, exec_ctx2.get());
+  GetTxnManager()->Commit(txn2);
+  ASSERT_TRUE(txn2->GetWriteSet()->empty());
+  delete txn2;
+  ASSERT_TRUE(scan_all().empty());
+}
+
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, OptimisticUpdateTest) {
+  // txn1, txn2: UPDATE test_1 SET colB = colB + 1 WHERE colA == 5, both OPTIMISTIC
+  // txn1 commits, txn2 fails validation
+  auto table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto const5 = MakeConstantValueExpression(ValueFactory::GetIntegerValue(5));
+  auto predicate = MakeComparisonExpression(col_a, const5, ComparisonType::Equal);
+  auto col_c = MakeColumnValueExpression(schema, 0, "colC");
+  auto col_d = MakeColumnValueExpression(schema, 0, "colD");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}, {"colC", col_c}, {"colD", col_d}});
+  auto scan_plan = std::make_unique<SeqScanPlanNode>(out_schema, predicate, table_info->oid_);
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(1, UpdateInfo(UpdateType::Add, 1)));
+  auto update_plan = std::make_unique<UpdatePlanNode>(scan_plan.get(), table_info->oid_, update_attrs);
+
+  // Optimistic transactions do not read uncommitted rows, commit the generated tables first.
+  GetTxnManager()->Commit(GetTxn());
+  std::vector<Tuple> result_set;
+  auto reader = GetTxnManager()->Begin();
+  auto reader_ctx = std::make_unique<ExecutorContext>(reader, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(scan_plan.get(), &result_set, reader, reader_ctx.get());
+  GetTxnManager()->Commit(reader);
+  delete reader;
+  ASSERT_EQ(result_set.size(), 1);
+  auto old_b = result_set[0].GetValue(out_schema, 1).GetAs<int32_t>();
+
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(update_plan.get(), nullptr, txn1, exec_ctx1.get());
+  GetExecutionEngine()->Execute(update_plan.get(), nullptr, txn2, exec_ctx2.get());
+
+  // Neither transaction holds a lock, and each reads its own buffered write.
+  CheckTxnLockSize(txn1, 0, 0);
+  ASSERT_TRUE(txn1->GetTableLockSet()->empty());
+  result_set.clear();
+  GetExecutionEngine()->Execute(scan_plan.get(), &result_set, txn1, exec_ctx1.get());
+  ASSERT_EQ(result_set.size(), 1);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 1).GetAs<int32_t>(), old_b + 1);
+
+  // The first to commit wins, the other one read a version that has changed since.
+  GetTxnManager()->Commit(txn1);
+  try {
+    GetTxnManager()->Commit(txn2);
+    FAIL() << "txn2 should fail validation";
+  } catch (TransactionAbortException &e) {
+    ASSERT_EQ(e.GetAbortReason(), AbortReason::VALIDATION_FAILED);
+  }
+  ASSERT_EQ(txn2->GetState(), TransactionState::ABORTED);
+  CheckTxnLockSize(txn2, 0, 0);
+
+  auto txn3 = GetTxnManager()->Begin();
+  auto exec_ctx3 = std::make_unique<ExecutorContext>(txn3, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  result_set.clear();
+  GetExecutionEngine()->Execute(scan_plan.get(), &result_set, txn3, exec_ctx3.get());
+  ASSERT_EQ(result_set.size(), 1);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 1).GetAs<int32_t>(), old_b + 1);
+  GetTxnManager()->Commit(txn3);
+
+  delete txn1;
+  delete txn2;
+  delete txn3;
+}
+
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, OptimisticWriteSkewTest) {
+  // txn1: SELECT * FROM test_1 WHERE colA == 5; UPDATE test_1 SET colB = colB + 1 WHERE colA == 6
+  // txn2: SELECT * FROM test_1 WHERE colA == 6; UPDATE test_1 SET colB = colB + 1 WHERE colA == 5
+  // Both OPTIMISTIC and committing at the same time, they lock different rows, yet only one may commit.
+  auto table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto col_c = MakeColumnValueExpression(schema, 0, "colC");
+  auto col_d = MakeColumnValueExpression(schema, 0, "colD");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}, {"colC", col_c}, {"colD", col_d}});
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(1, UpdateInfo(UpdateType::Add, 1)));
+  std::vector<std::unique_ptr<SeqScanPlanNode>> scan_plans;
+  std::vector<std::unique_ptr<UpdatePlanNode>> update_plans;
+  for (int32_t key : {5, 6}) {
+    auto const_key = MakeConstantValueExpression(ValueFactory::GetIntegerValue(key));
+    auto predicate = MakeComparisonExpression(col_a, const_key, ComparisonType::Equal);
+    scan_plans.emplace_back(std::make_unique<SeqScanPlanNode>(out_schema, predicate, table_info->oid_));
+    update_plans.emplace_back(
+        std::make_unique<UpdatePlanNode>(scan_plans.back().get(), table_info->oid_, update_attrs));
+  }
+
+  // Optimistic transactions do not read uncommitted rows, commit the generated tables first.
+  GetTxnManager()->Commit(GetTxn());
+  std::vector<Transaction *> txns;
+  std::vector<std::unique_ptr<ExecutorContext>> exec_ctxs;
+  for (size_t i = 0; i < 2; i++) {
+    txns.push_back(GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC));
+    exec_ctxs.push_back(
+        std::make_unique<ExecutorContext>(txns[i], GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager()));
+  }
+  for (size_t i = 0; i < 2; i++) {
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(scan_plans[i].get(), &result_set, txns[i], exec_ctxs[i].get());
+    ASSERT_EQ(result_set.size(), 1);
+    GetExecutionEngine()->Execute(update_plans[1 - i].get(), nullptr, txns[i], exec_ctxs[i].get());
+  }
+
+  // Both rows are on the first page. Holding its latch stalls both commits before they install their writes,
+  // so that each gets as far as it can before the other one has written anything.
+  page_id_t page_id = table_info->table_->GetFirstPageId();
+  Page *page = GetBPM()->FetchPage(page_id);
+  page->RLatch();
+  std::atomic<int> committed{0};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 2; i++) {
+    threads.emplace_back([&, i] {
+      try {
+        GetTxnManager()->Commit(txns[i]);
+        committed++;
+      } catch (TransactionAbortException &e) {
+        EXPECT_EQ(e.GetAbortReason(), AbortReason::VALIDATION_FAILED);
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  page->RUnlatch();
+  GetBPM()->UnpinPage(page_id, false);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(committed, 1);
+  for (auto *txn : txns) {
+    CheckTxnLockSize(txn, 0, 0);
+    delete txn;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, OptimisticIndexTest) {
+  // txn1: UPDATE test_1 SET colA = 1000 WHERE colA == 5; UPDATE test_1 SET colA = 2000 WHERE colA == 1000
+  // txn2: DELETE FROM test_1 WHERE colA == 6
+  // Both OPTIMISTIC, one after the other, the index does not change until they commit.
+  auto table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}});
+  auto make_scan = [&](int32_t key) {
+    auto const_key = MakeConstantValueExpression(ValueFactory::GetIntegerValue(key));
+    auto predicate = MakeComparisonExpression(col_a, const_key, ComparisonType::Equal);
+    return std::make_unique<SeqScanPlanNode>(out_schema, predicate, table_info->oid_);
+  };
+  auto scan_plan1 = make_scan(5);
+  auto scan_plan2 = make_scan(1000);
+  auto scan_plan3 = make_scan(6);
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs1;
+  update_attrs1.insert(std::make_pair(0, UpdateInfo(UpdateType::Set, 1000)));
+  auto update_plan1 = std::make_unique<UpdatePlanNode>(scan_plan1.get(), table_info->oid_, update_attrs1);
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs2;
+  update_attrs2.insert(std::make_pair(0, UpdateInfo(UpdateType::Set, 2000)));
+  auto update_plan2 = std::make_unique<UpdatePlanNode>(scan_plan2.get(), table_info->oid_, update_attrs2);
+  auto delete_plan = std::make_unique<DeletePlanNode>(scan_plan3.get(), table_info->oid_);
+  auto key_schema = ParseCreateStatement("a bigint");
+  auto index_info = GetExecutorContext()->GetCatalog()->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(
+      GetTxn(), "index1", "test_1", schema, *key_schema, {0}, 8, HashFunction<GenericKey<8>>{});
+  GetTxnManager()->Commit(GetTxn());
+
+  auto count_key = [&](int32_t key, Transaction *txn) {
+    std::vector<RID> rids;
+    Tuple key_tuple(std::vector<Value>{ValueFactory::GetIntegerValue(key)}, index_info->index_->GetKeySchema());
+    index_info->index_->ScanKey(key_tuple, &rids, txn);
+    return rids.size();
+  };
+
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(update_plan1.get(), nullptr, txn1, exec_ctx1.get());
+  GetExecutionEngine()->Execute(update_plan2.get(), nullptr, txn1, exec_ctx1.get());
+  ASSERT_EQ(count_key(5, txn1), 1);
+  ASSERT_EQ(count_key(1000, txn1), 0);
+  ASSERT_EQ(count_key(2000, txn1), 0);
+  ASSERT_TRUE(txn1->GetIndexWriteSet()->empty());
+  // The index follows the heap when the writes are installed, from the image before the first update.
+  GetTxnManager()->Commit(txn1);
+
+  // txn2 scanned every row, it starts after txn1 so that it does not fail validation.
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(delete_plan.get(), nullptr, txn2, exec_ctx2.get());
+  ASSERT_EQ(count_key(6, txn2), 1);
+  ASSERT_TRUE(txn2->GetIndexWriteSet()->empty());
+  GetTxnManager()->Commit(txn2);
+
+  auto txn3 = GetTxnManager()->Begin();
+  ASSERT_EQ(count_key(5, txn3), 0);
+  ASSERT_EQ(count_key(1000, txn3), 0);
+  ASSERT_EQ(count_key(2000, txn3), 1);
+  ASSERT_EQ(count_key(6, txn3), 0);
+  GetTxnManager()->Commit(txn3);
+
+  delete txn1;
+  delete txn2;
+  delete txn3;
+}
+
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, ReadOnlyTest) {
+  // txn1: UPDATE test_1 SET colB = colB + 1 WHERE colA == 5, not committed yet
+  // txn2: read-only SELECT * FROM test_1 WHERE colA == 5, neither blocks nor locks
+  auto table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto const5 = MakeConstantValueExpression(ValueFactory::GetIntegerValue(5));
+  auto predicate = MakeComparisonExpression(col_a, const5, ComparisonType::Equal);
+  auto col_c = MakeColumnValueExpression(schema, 0, "colC");
+  auto col_d = MakeColumnValueExpression(schema, 0, "colD");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}, {"colC", col_c}, {"colD", col_d}});
+  auto scan_plan = std::make_unique<SeqScanPlanNode>(out_schema, predicate, table_info->oid_);
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(1, UpdateInfo(UpdateType::Add, 1)));
+  auto update_plan = std::make_unique<UpdatePlanNode>(scan_plan.get(), table_info->oid_, update_attrs);
+
+  // Snapshots only see committed rows, commit the generated tables first.
+  GetTxnManager()->Commit(GetTxn());
+  std::vector<Tuple> result_set;
+  auto txn1 = GetTxnManager()->Begin();
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(update_plan.get(), nullptr, txn1, exec_ctx1.get());
+  // No snapshot is taken, txn1 records the image it replaced only once txn2 begins.
+  ASSERT_EQ(GetTxnManager()->GetVersionStore()->GetVersionCount(), 0);
+
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ, true);
+  ASSERT_EQ(GetTxnManager()->GetVersionStore()->GetVersionCount(), 1);
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  ASSERT_TRUE(txn2->IsReadOnly());
+  ASSERT_EQ(txn2->GetIsolationLevel(), IsolationLevel::SNAPSHOT_ISOLATION);
+  ASSERT_EQ(TransactionManager::GetTransaction(txn2->GetTransactionId()), nullptr);
+  size_t queue_count = GetLockManager()->GetQueueCount();
+  GetExecutionEngine()->Execute(scan_plan.get(), &result_set, txn2, exec_ctx2.get());
+  ASSERT_EQ(result_set.size(), 1);
+  auto old_b = result_set[0].GetValue(out_schema, 1).GetAs<int32_t>();
+  ASSERT_EQ(GetLockManager()->GetQueueCount(), queue_count);
+  ASSERT_EQ(txn2->GetSharedLockSet(), nullptr);
+  ASSERT_EQ(txn2->GetWriteSet(), nullptr);
+
+  // Writing aborts the read-only transaction.
+  try {
+    GetExecutionEngine()->Execute(update_plan.get(), nullptr, txn2, exec_ctx2.get());
+    FAIL() << "txn2 should not write";
+  } catch (TransactionAbortException &e) {
+    ASSERT_EQ(e.GetAbortReason(), AbortReason::WRITE_ON_READ_ONLY);
+  }
+  ASSERT_EQ(txn2->GetState(), TransactionState::ABORTED);
+  GetTxnManager()->Abort(txn2);
+  GetTxnManager()->Commit(txn1);
+
+  // A read-only transaction begun after the commit sees the update.
+  auto txn3 = GetTxnManager()->Begin(nullptr, IsolationLevel::READ_COMMITTED, true);
+  auto exec_ctx3 = std::make_unique<ExecutorContext>(txn3, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  result_set.clear();
+  GetExecutionEngine()->Execute(scan_plan.get(), &result_set, txn3, exec_ctx3.get());
+  ASSERT_EQ(result_set.size(), 1);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 1).GetAs<int32_t>(), old_b + 1);
+  GetTxnManager()->Commit(txn3);
+  ASSERT_EQ(txn3->GetState(), TransactionState::COMMITTED);
+
+  delete txn1;
+  delete txn2;
+  delete txn3;
+}
+
 /****************************
  * Transaction Tests (25 pts)
  ****************************/
@@ -10,13 +10,17 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <memory>
 #include <numeric>
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "buffer/async_page_reader.h"
 #include "buffer/buffer_pool_manager_instance.h"
 #include "concurrency/transaction_manager.h"
 #include "execution/execution_engine.h"
@@ -32,8 +36,10 @@
 #include "execution/plans/distinct_plan.h"
 #include "execution/plans/hash_join_plan.h"
 #include "execution/plans/limit_plan.h"
+#include "execution/plans/nested_index_join_plan.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "execution/plans/update_plan.h"
+#include "execution/push_execution_engine.h"
 #include "executor_test_util.h"  // NOLINT
 #include "gtest/gtest.h"
 #include "storage/table/tuple.h"
@@ -110,6 +116,22 @@ TEST_F(ExecutorTest, SimpleSeqScanTest) {
   }
 }
 
+// SELECT colA FROM test_1 under REPEATABLE_READ locks the table once instead of every row
+TEST_F(ExecutorTest, SeqScanTableLockTest) {
+  TableInfo *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+  const Schema &schema = table_info->schema_;
+  auto *col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto *out_schema = MakeOutputSchema({{"colA", col_a}});
+  SeqScanPlanNode plan{out_schema, nullptr, table_info->oid_};
+
+  std::vector<Tuple> result_set{};
+  GetExecutionEngine()->Execute(&plan, &result_set, GetTxn(), GetExecutorContext());
+
+  ASSERT_EQ(result_set.size(), TEST1_SIZE);
+  ASSERT_EQ(GetTxn()->GetTableLockSet()->at(table_info->oid_), TableLockMode::SHARED);
+  ASSERT_TRUE(GetTxn()->GetSharedLockSet()->empty());
+}
+
 // INSERT INTO empty_table2 VALUES (100, 10), (101, 11), (102, 12)
 TEST_F(ExecutorTest, SimpleRawInsertTest) {
   // Create Values to insert
@@ -328,6 +350,65 @@ TEST_F(ExecutorTest, SimpleUpdateTest) {
   }
 }
 
+// UPDATE test_3 SET colB = colA * 2;
+TEST_F(ExecutorTest, UpdateWithExpressionAndIndexTest) {
+  auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_3");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  auto scan_plan = std::make_unique<SeqScanPlanNode>(out_schema, nullptr, table_info->oid_);
+
+  // One index on the updated column, one on a column the update leaves alone
+  auto key_schema = ParseCreateStatement("a bigint");
+  auto *index_a = GetExecutorContext()->GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "index_a", "test_3", schema, *key_schema, {0}, 8, HashFunctionType{});
+  auto *index_b = GetExecutorContext()->GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "index_b", "test_3", schema, *key_schema, {1}, 8, HashFunctionType{});
+
+  auto const2 = MakeConstantValueExpression(ValueFactory::GetIntegerValue(2));
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs{};
+  update_attrs.emplace(static_cast<uint32_t>(1), UpdateInfo{MakeArithmeticExpression(col_a, const2,
+                                                                                     ArithmeticType::Multiply)});
+  auto update_plan = std::make_unique<UpdatePlanNode>(scan_plan.get(), table_info->oid_, update_attrs);
+  GetExecutionEngine()->Execute(update_plan.get(), nullptr, GetTxn(), GetExecutorContext());
+
+  // Only index_b saw changes, and not for the first tuple where colB = 0 = colA * 2 already
+  auto index_writes = GetTxn()->GetIndexWriteSet();
+  ASSERT_EQ(index_writes->size(), TEST3_SIZE - 1);
+  for (const auto &write : *index_writes) {
+    ASSERT_EQ(write.index_oid_, index_b->index_oid_);
+    ASSERT_EQ(write.wtype_, WType::UPDATE);
+  }
+
+  std::vector<Tuple> result_set{};
+  GetExecutionEngine()->Execute(scan_plan.get(), &result_set, GetTxn(), GetExecutorContext());
+  ASSERT_EQ(result_set.size(), TEST3_SIZE);
+
+  std::vector<RID> rids{};
+  for (auto &tuple : result_set) {
+    auto a = tuple.GetValue(out_schema, out_schema->GetColIdx("colA")).GetAs<int32_t>();
+    ASSERT_EQ(tuple.GetValue(out_schema, out_schema->GetColIdx("colB")).GetAs<int32_t>(), a * 2);
+
+    // Both indexes must lead back to the updated tuple
+    for (auto *index_info : {index_a, index_b}) {
+      rids.clear();
+      auto key = tuple.KeyFromTuple(schema, index_info->key_schema_, index_info->index_->GetKeyAttrs());
+      index_info->index_->ScanKey(key, &rids, GetTxn());
+      ASSERT_EQ(rids.size(), 1);
+      Tuple indexed_tuple{};
+      ASSERT_TRUE(table_info->table_->GetTuple(rids[0], &indexed_tuple, GetTxn()));
+      ASSERT_EQ(indexed_tuple.GetValue(&schema, 0).GetAs<int32_t>(), a);
+    }
+  }
+
+  // colB is now always even, so the old odd keys are gone from index_b
+  rids.clear();
+  std::vector<Value> old_key_values{ValueFactory::GetIntegerValue(1)};
+  index_b->index_->ScanKey(Tuple{old_key_values, key_schema.get()}, &rids, GetTxn());
+  ASSERT_TRUE(rids.empty());
+}
+
 // DELETE FROM test_1 WHERE col_a == 50;
 TEST_F(ExecutorTest, SimpleDeleteTest) {
   // Construct query plan
@@ -373,6 +454,225 @@ TEST_F(ExecutorTest, SimpleDeleteTest) {
   ASSERT_TRUE(rids.empty());
 }
 
+// The index follows INSERT, UPDATE and DELETE statements, and an abort puts it back as it was.
+TEST_F(ExecutorTest, IndexMaintenanceRollbackTest) {
+  auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  auto scan_plan = std::make_unique<SeqScanPlanNode>(out_schema, nullptr, table_info->oid_);
+  auto const112 = MakeConstantValueExpression(ValueFactory::GetIntegerValue(112));
+  auto scan_112_plan = std::make_unique<SeqScanPlanNode>(
+      out_schema, MakeComparisonExpression(col_a, const112, ComparisonType::Equal), table_info->oid_);
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs{};
+  update_attrs.emplace(static_cast<uint32_t>(0), UpdateInfo{UpdateType::Add, 10});
+  auto update_plan = std::make_unique<UpdatePlanNode>(scan_plan.get(), table_info->oid_, update_attrs);
+  auto delete_plan = std::make_unique<DeletePlanNode>(scan_112_plan.get(), table_info->oid_);
+  std::vector<std::vector<Value>> raw_vals{{ValueFactory::GetIntegerValue(120), ValueFactory::GetIntegerValue(20)}};
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+
+  auto key_schema = ParseCreateStatement("a bigint");
+  auto *index_info = GetExecutorContext()->GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "index1", "empty_table2", schema, *key_schema, {0}, 8, HashFunctionType{});
+  // @return the colA of the rows the index maps a key to, which must be the key itself
+  auto lookup = [&](int32_t a, Transaction *txn) {
+    std::vector<RID> rids;
+    std::vector<Value> key_values{ValueFactory::GetIntegerValue(a)};
+    index_info->index_->ScanKey(Tuple{key_values, key_schema.get()}, &rids, txn);
+    for (const auto &rid : rids) {
+      Tuple indexed_tuple{};
+      EXPECT_TRUE(table_info->table_->GetTuple(rid, &indexed_tuple, txn));
+      EXPECT_EQ(indexed_tuple.GetValue(&schema, 0).GetAs<int32_t>(), a);
+    }
+    return rids.size();
+  };
+
+  // INSERT INTO empty_table2 VALUES (100, 0), ..., (104, 4), committed
+  std::vector<std::vector<Value>> initial_vals;
+  for (int32_t i = 0; i < 5; i++) {
+    initial_vals.push_back({ValueFactory::GetIntegerValue(100 + i), ValueFactory::GetIntegerValue(i)});
+  }
+  InsertPlanNode initial_insert_plan{std::move(initial_vals), table_info->oid_};
+  GetExecutionEngine()->Execute(&initial_insert_plan, nullptr, GetTxn(), GetExecutorContext());
+  for (int32_t a = 100; a < 105; a++) {
+    ASSERT_EQ(lookup(a, GetTxn()), 1);
+  }
+  GetTxnManager()->Commit(GetTxn());
+
+  // UPDATE empty_table2 SET colA = colA + 10; DELETE FROM empty_table2 WHERE colA == 112;
+  // INSERT INTO empty_table2 VALUES (120, 20)
+  auto run_statements = [&](Transaction *txn) {
+    auto exec_ctx =
+        std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    GetExecutionEngine()->Execute(update_plan.get(), nullptr, txn, exec_ctx.get());
+    GetExecutionEngine()->Execute(delete_plan.get(), nullptr, txn, exec_ctx.get());
+    GetExecutionEngine()->Execute(&insert_plan, nullptr, txn, exec_ctx.get());
+    for (int32_t a = 100; a < 105; a++) {
+      ASSERT_EQ(lookup(a, txn), 0);
+      ASSERT_EQ(lookup(a + 10, txn), a + 10 == 112 ? 0 : 1);
+    }
+    ASSERT_EQ(lookup(120, txn), 1);
+  };
+
+  // The abort restores the old keys and drops the new ones.
+  auto *txn1 = GetTxnManager()->Begin();
+  run_statements(txn1);
+  GetTxnManager()->Abort(txn1);
+  ASSERT_TRUE(txn1->GetIndexWriteSet()->empty());
+  delete txn1;
+  auto *txn2 = GetTxnManager()->Begin();
+  for (int32_t a = 100; a < 105; a++) {
+    ASSERT_EQ(lookup(a, txn2), 1);
+    ASSERT_EQ(lookup(a + 10, txn2), 0);
+  }
+  ASSERT_EQ(lookup(120, txn2), 0);
+
+  // The commit keeps the new keys.
+  run_statements(txn2);
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+  auto *txn3 = GetTxnManager()->Begin();
+  for (int32_t a = 100; a < 105; a++) {
+    ASSERT_EQ(lookup(a, txn3), 0);
+    ASSERT_EQ(lookup(a + 10, txn3), a + 10 == 112 ? 0 : 1);
+  }
+  ASSERT_EQ(lookup(120, txn3), 1);
+  GetTxnManager()->Commit(txn3);
+  delete txn3;
+}
+
+// A SNAPSHOT_ISOLATION reader keeps seeing the table as of its start, and may not overwrite newer commits.
+TEST_F(ExecutorTest, SnapshotIsolationTest) {
+  auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_3");
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs{{1, UpdateInfo{UpdateType::Add, 1}}};
+  UpdatePlanNode update_plan{&scan_plan, table_info->oid_, update_attrs};
+  std::vector<std::vector<Value>> raw_vals{{ValueFactory::GetIntegerValue(-1), ValueFactory::GetIntegerValue(-1)}};
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+
+  // Snapshots only see committed rows, commit the generated tables first.
+  TransactionManager *txn_mgr = GetTxnManager();
+  txn_mgr->Commit(GetTxn());
+
+  Transaction *reader = txn_mgr->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  ExecutorContext reader_ctx{reader, GetCatalog(), GetBPM(), txn_mgr, GetLockManager()};
+  Transaction *writer = txn_mgr->Begin();
+  ExecutorContext writer_ctx{writer, GetCatalog(), GetBPM(), txn_mgr, GetLockManager()};
+  GetExecutionEngine()->Execute(&update_plan, nullptr, writer, &writer_ctx);
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, writer, &writer_ctx);
+  txn_mgr->Commit(writer);
+  ASSERT_GT(txn_mgr->GetVersionStore()->GetVersionCount(), 0);
+
+  // The reader sees neither the update nor the insert, and takes no locks to do so.
+  std::vector<Tuple> result_set{};
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, reader, &reader_ctx);
+  ASSERT_EQ(result_set.size(), TEST3_SIZE);
+  for (auto i = 0UL; i < result_set.size(); ++i) {
+    ASSERT_EQ(result_set[i].GetValue(out_schema, 1).GetAs<int32_t>(), static_cast<int32_t>(i));
+  }
+  ASSERT_TRUE(reader->GetSharedLockSet()->empty());
+  ASSERT_TRUE(reader->GetTableLockSet()->empty());
+
+  // A snapshot taken after the commit sees both.
+  Transaction *late_reader = txn_mgr->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  ExecutorContext late_ctx{late_reader, GetCatalog(), GetBPM(), txn_mgr, GetLockManager()};
+  result_set.clear();
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, late_reader, &late_ctx);
+  ASSERT_EQ(result_set.size(), TEST3_SIZE + 1);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 1).GetAs<int32_t>(), 1);
+  txn_mgr->Commit(late_reader);
+
+  // The first committer wins: the reader may not update the rows the writer committed after its snapshot.
+  EXPECT_THROW(GetExecutionEngine()->Execute(&update_plan, nullptr, reader, &reader_ctx), TransactionAbortException);
+  ASSERT_EQ(reader->GetState(), TransactionState::ABORTED);
+  txn_mgr->Abort(reader);
+
+  // With no snapshot left, none of the old versions are needed.
+  txn_mgr->GarbageCollect();
+  ASSERT_EQ(txn_mgr->GetVersionStore()->GetVersionCount(), 0);
+
+  delete late_reader;
+  delete writer;
+  delete reader;
+}
+
+// SELECT test_1.colA, empty_table2.colB FROM test_1 JOIN empty_table2 ON test_1.colA = empty_table2.colA
+// WHERE test_1.colA = 100; a SERIALIZABLE index lookup keeps out the insert that would add a phantom to it
+TEST_F(ExecutorTest, SerializableKeyLockTest) {
+  auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto key_schema = ParseCreateStatement("a bigint");
+  GetExecutorContext()->GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "index1", "empty_table2", table_info->schema_, *key_schema, {0}, 8, HashFunctionType{});
+  std::vector<Value> row_values{ValueFactory::GetIntegerValue(100), ValueFactory::GetIntegerValue(10)};
+  InsertPlanNode insert_plan{{row_values}, table_info->oid_};
+
+  const Schema *outer_schema;
+  std::unique_ptr<AbstractPlanNode> scan_plan;
+  {
+    auto *outer_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+    auto col_a = MakeColumnValueExpression(outer_info->schema_, 0, "colA");
+    auto const100 = MakeConstantValueExpression(ValueFactory::GetIntegerValue(100));
+    auto predicate = MakeComparisonExpression(col_a, const100, ComparisonType::Equal);
+    outer_schema = MakeOutputSchema({{"colA", col_a}});
+    scan_plan = std::make_unique<SeqScanPlanNode>(outer_schema, predicate, outer_info->oid_);
+  }
+  std::unique_ptr<NestedIndexJoinPlanNode> join_plan;
+  {
+    auto outer_col_a = MakeColumnValueExpression(*outer_schema, 0, "colA");
+    auto inner_col_a = MakeColumnValueExpression(schema, 1, "colA");
+    auto inner_col_b = MakeColumnValueExpression(schema, 1, "colB");
+    auto predicate = MakeComparisonExpression(outer_col_a, inner_col_a, ComparisonType::Equal);
+    auto *out_final = MakeOutputSchema({{"colA", outer_col_a}, {"colB", inner_col_b}});
+    join_plan = std::make_unique<NestedIndexJoinPlanNode>(
+        out_final, std::vector<const AbstractPlanNode *>{scan_plan.get()}, predicate, table_info->oid_, "index1",
+        outer_schema, &schema);
+  }
+
+  TransactionManager *txn_mgr = GetTxnManager();
+  txn_mgr->Commit(GetTxn());
+
+  // The reader finds no row with the key, and the lookup locks the key all the same.
+  Transaction *reader = txn_mgr->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  ExecutorContext reader_ctx{reader, GetCatalog(), GetBPM(), txn_mgr, GetLockManager()};
+  std::vector<Tuple> result_set{};
+  GetExecutionEngine()->Execute(join_plan.get(), &result_set, reader, &reader_ctx);
+  ASSERT_TRUE(result_set.empty());
+
+  std::atomic<bool> inserted{false};
+  std::thread writer_thread([&] {
+    Transaction *writer = txn_mgr->Begin();
+    ExecutorContext writer_ctx{writer, GetCatalog(), GetBPM(), txn_mgr, GetLockManager()};
+    GetExecutionEngine()->Execute(&insert_plan, nullptr, writer, &writer_ctx);
+    inserted = true;
+    txn_mgr->Commit(writer);
+    delete writer;
+  });
+
+  // The insert waits for the key lock, so running the join again still finds nothing.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(inserted);
+  GetExecutionEngine()->Execute(join_plan.get(), &result_set, reader, &reader_ctx);
+  EXPECT_TRUE(result_set.empty());
+  txn_mgr->Commit(reader);
+
+  writer_thread.join();
+  EXPECT_TRUE(inserted);
+  Transaction *late_reader = txn_mgr->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  ExecutorContext late_ctx{late_reader, GetCatalog(), GetBPM(), txn_mgr, GetLockManager()};
+  GetExecutionEngine()->Execute(join_plan.get(), &result_set, late_reader, &late_ctx);
+  ASSERT_EQ(result_set.size(), 1);
+  EXPECT_EQ(result_set[0].GetValue(join_plan->OutputSchema(), 1).GetAs<int32_t>(), 10);
+  txn_mgr->Commit(late_reader);
+  delete late_reader;
+  delete reader;
+}
+
 // SELECT test_1.col_a, test_1.col_b, test_2.col1, test_2.col3 FROM test_1 JOIN test_2 ON test_1.col_a = test_2.col1;
 TEST_F(ExecutorTest, SimpleNestedLoopJoinTest) {
   const Schema *out_schema1;
@@ -486,6 +786,190 @@ TEST_F(ExecutorTest, SimpleHashJoinTest) {
   }
 }
 
+// SELECT COUNT(test_4.colA), SUM(test_6.colB) FROM test_4 JOIN test_6 ON test_4.colA = test_6.colA, on both engines
+TEST_F(ExecutorTest, PushEngineJoinAggregationTest) {
+  const Schema *out_schema1{};
+  std::unique_ptr<AbstractPlanNode> scan_plan1{};
+  {
+    auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_4");
+    auto &schema = table_info->schema_;
+    auto *col_a = MakeColumnValueExpression(schema, 0, "colA");
+    auto *col_b = MakeColumnValueExpression(schema, 0, "colB");
+    out_schema1 = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+    scan_plan1 = std::make_unique<SeqScanPlanNode>(out_schema1, nullptr, table_info->oid_);
+  }
+
+  const Schema *out_schema2{};
+  std::unique_ptr<AbstractPlanNode> scan_plan2{};
+  {
+    auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_6");
+    auto &schema = table_info->schema_;
+    auto *col_a = MakeColumnValueExpression(schema, 0, "colA");
+    auto *col_b = MakeColumnValueExpression(schema, 0, "colB");
+    out_schema2 = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+    scan_plan2 = std::make_unique<SeqScanPlanNode>(out_schema2, nullptr, table_info->oid_);
+  }
+
+  const Schema *join_schema{};
+  std::unique_ptr<HashJoinPlanNode> join_plan{};
+  {
+    auto *table4_col_a = MakeColumnValueExpression(*out_schema1, 0, "colA");
+    auto *table6_col_a = MakeColumnValueExpression(*out_schema2, 1, "colA");
+    auto *table6_col_b = MakeColumnValueExpression(*out_schema2, 1, "colB");
+    join_schema = MakeOutputSchema({{"table4_colA", table4_col_a}, {"table6_colB", table6_col_b}});
+    join_plan = std::make_unique<HashJoinPlanNode>(
+        join_schema, std::vector<const AbstractPlanNode *>{scan_plan1.get(), scan_plan2.get()}, table4_col_a,
+        table6_col_a);
+  }
+
+  const Schema *agg_schema{};
+  std::unique_ptr<AbstractPlanNode> agg_plan{};
+  {
+    const AbstractExpression *col_a = MakeColumnValueExpression(*join_schema, 0, "table4_colA");
+    const AbstractExpression *col_b = MakeColumnValueExpression(*join_schema, 0, "table6_colB");
+    agg_schema = MakeOutputSchema(
+        {{"count_a", MakeAggregateValueExpression(false, 0)}, {"sum_b", MakeAggregateValueExpression(false, 1)}});
+    agg_plan = std::make_unique<AggregationPlanNode>(
+        agg_schema, join_plan.get(), nullptr, std::vector<const AbstractExpression *>{},
+        std::vector<const AbstractExpression *>{col_a, col_b},
+        std::vector<AggregationType>{AggregationType::CountAggregate, AggregationType::SumAggregate});
+  }
+
+  // The push engine splits the plan into three pipelines: build, probe + aggregate, and the aggregate output
+  ThreadPool thread_pool{2};
+  PushExecutionEngine push_engine{GetBPM(), GetTxnManager(), GetCatalog(), &thread_pool};
+
+  std::vector<Tuple> join_result{};
+  push_engine.Execute(join_plan.get(), &join_result, GetTxn(), GetExecutorContext());
+  ASSERT_EQ(join_result.size(), 100);
+
+  std::vector<Tuple> volcano_result{};
+  std::vector<Tuple> push_result{};
+  GetExecutionEngine()->Execute(agg_plan.get(), &volcano_result, GetTxn(), GetExecutorContext());
+  push_engine.Execute(agg_plan.get(), &push_result, GetTxn(), GetExecutorContext());
+  ASSERT_EQ(volcano_result.size(), 1);
+  ASSERT_EQ(push_result.size(), 1);
+  for (uint32_t i = 0; i < agg_schema->GetColumnCount(); i++) {
+    ASSERT_EQ(push_result[0].GetValue(agg_schema, i).GetAs<int32_t>(),
+              volcano_result[0].GetValue(agg_schema, i).GetAs<int32_t>());
+  }
+  ASSERT_EQ(push_result[0].GetValue(agg_schema, agg_schema->GetColIdx("count_a")).GetAs<int32_t>(), 100);
+
+  // A limit stops its pipeline early
+  auto limit_plan = std::make_unique<LimitPlanNode>(out_schema1, scan_plan1.get(), 10);
+  std::vector<Tuple> limit_result{};
+  push_engine.Execute(limit_plan.get(), &limit_result, GetTxn(), GetExecutorContext());
+  ASSERT_EQ(limit_result.size(), 10);
+}
+
+// SELECT test_4.colA, test_4.colB, test_6.colA, test_6.colB FROM test_4 JOIN test_6 ON test_4.colA = test_6.colA
+TEST_F(ExecutorTest, PushEngineLateMaterializationTest) {
+  const Schema *out_schema1{};
+  std::unique_ptr<AbstractPlanNode> scan_plan1{};
+  {
+    auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_4");
+    auto &schema = table_info->schema_;
+    auto *col_a = MakeColumnValueExpression(schema, 0, "colA");
+    auto *col_b = MakeColumnValueExpression(schema, 0, "colB");
+    out_schema1 = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+    scan_plan1 = std::make_unique<SeqScanPlanNode>(out_schema1, nullptr, table_info->oid_);
+  }
+
+  // Only colA is needed to find the join partners, colB is read once a partner is found
+  const Schema *out_schema2{};
+  std::unique_ptr<AbstractPlanNode> scan_plan2{};
+  {
+    auto *table_info = GetExecutorContext()->GetCatalog()->GetTable("test_6");
+    auto &schema = table_info->schema_;
+    auto *col_a = MakeColumnValueExpression(schema, 0, "colA");
+    auto *col_b = MakeColumnValueExpression(schema, 0, "colB");
+    out_schema2 = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+    scan_plan2 = std::make_unique<SeqScanPlanNode>(out_schema2, nullptr, table_info->oid_);
+  }
+
+  const Schema *out_schema{};
+  std::unique_ptr<HashJoinPlanNode> join_plan{};
+  {
+    auto *table4_col_a = MakeColumnValueExpression(*out_schema1, 0, "colA");
+    auto *table4_col_b = MakeColumnValueExpression(*out_schema1, 0, "colB");
+    auto *table6_col_a = MakeColumnValueExpression(*out_schema2, 1, "colA");
+    auto *table6_col_b = MakeColumnValueExpression(*out_schema2, 1, "colB");
+    out_schema = MakeOutputSchema({{"table4_colA", table4_col_a},
+                                   {"table4_colB", table4_col_b},
+                                   {"table6_colA", table6_col_a},
+                                   {"table6_colB", table6_col_b}});
+    join_plan = std::make_unique<HashJoinPlanNode>(
+        out_schema, std::vector<const AbstractPlanNode *>{scan_plan1.get(), scan_plan2.get()}, table4_col_a,
+        table6_col_a);
+  }
+
+  ThreadPool thread_pool{1};
+  PushExecutionEngine push_engine{GetBPM(), GetTxnManager(), GetCatalog(), &thread_pool, true};
+
+  std::vector<Tuple> result_set{};
+  push_engine.Execute(join_plan.get(), &result_set, GetTxn(), GetExecutorContext());
+  ASSERT_EQ(result_set.size(), 100);
+
+  for (const auto &tuple : result_set) {
+    const auto t4_col_a = tuple.GetValue(out_schema, out_schema->GetColIdx("table4_colA")).GetAs<int64_t>();
+    const auto t4_col_b = tuple.GetValue(out_schema, out_schema->GetColIdx("table4_colB")).GetAs<int32_t>();
+    const auto t6_col_a = tuple.GetValue(out_schema, out_schema->GetColIdx("table6_colA")).GetAs<int64_t>();
+    const Value t6_col_b = tuple.GetValue(out_schema, out_schema->GetColIdx("table6_colB"));
+
+    // The deferred column must have been filled in
+    ASSERT_FALSE(t6_col_b.IsNull());
+    ASSERT_EQ(t4_col_a, t6_col_a);
+    ASSERT_EQ(t4_col_b, t6_col_b.GetAs<int32_t>());
+  }
+}
+
+// SELECT COUNT(colA), SUM(colA) FROM test_1 WHERE colA < 500, with pages read ahead on I/O threads
+TEST_F(ExecutorTest, PushEngineAsyncScanTest) {
+  const Schema *scan_schema;
+  std::unique_ptr<AbstractPlanNode> scan_plan;
+  {
+    auto table_info = GetExecutorContext()->GetCatalog()->GetTable("test_1");
+    auto &schema = table_info->schema_;
+    auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+    auto predicate = MakeComparisonExpression(col_a, MakeConstantValueExpression(ValueFactory::GetIntegerValue(500)),
+                                              ComparisonType::LessThan);
+    scan_schema = MakeOutputSchema({{"colA", col_a}});
+    scan_plan = std::make_unique<SeqScanPlanNode>(scan_schema, predicate, table_info->oid_);
+  }
+
+  const Schema *agg_schema;
+  std::unique_ptr<AbstractPlanNode> agg_plan;
+  {
+    const AbstractExpression *col_a = MakeColumnValueExpression(*scan_schema, 0, "colA");
+    agg_schema = MakeOutputSchema(
+        {{"count_a", MakeAggregateValueExpression(false, 0)}, {"sum_a", MakeAggregateValueExpression(false, 1)}});
+    agg_plan = std::make_unique<AggregationPlanNode>(
+        agg_schema, scan_plan.get(), nullptr, std::vector<const AbstractExpression *>{},
+        std::vector<const AbstractExpression *>{col_a, col_a},
+        std::vector<AggregationType>{AggregationType::CountAggregate, AggregationType::SumAggregate});
+  }
+
+  ThreadPool io_pool{4};
+  AsyncPageReader page_reader{GetBPM(), &io_pool};
+  ThreadPool thread_pool{1};
+  PushExecutionEngine push_engine{GetBPM(), GetTxnManager(), GetCatalog(), &thread_pool, false, &page_reader};
+
+  for (int i = 0; i < 3; i++) {
+    // Push the table out of the buffer pool, so that the scan has to wait for its reads
+    for (size_t frame = 0; frame < GetBPM()->GetPoolSize(); frame++) {
+      page_id_t page_id;
+      ASSERT_NE(GetBPM()->NewPage(&page_id), nullptr);
+      GetBPM()->UnpinPage(page_id, false);
+    }
+
+    std::vector<Tuple> result_set{};
+    push_engine.Execute(agg_plan.get(), &result_set, GetTxn(), GetExecutorContext());
+    ASSERT_EQ(result_set.size(), 1);
+    ASSERT_EQ(result_set[0].GetValue(agg_schema, agg_schema->GetColIdx("count_a")).GetAs<int32_t>(), 500);
+    ASSERT_EQ(result_set[0].GetValue(agg_schema, agg_schema->GetColIdx("sum_a")).GetAs<int32_t>(), 500 * 499 / 2);
+  }
+}
+
 // SELECT COUNT(col_a), SUM(col_a), min(col_a), max(col_a) from test_1;
 TEST_F(ExecutorTest, SimpleAggregationTest) {
   const Schema *scan_schema;
@@ -25,6 +25,7 @@
 #include "execution/execution_engine.h"
 #include "execution/executor_context.h"
 #include "execution/expressions/aggregate_value_expression.h"
+#include "execution/expressions/arithmetic_expression.h"
 #include "execution/expressions/column_value_expression.h"
 #include "execution/expressions/comparison_expression.h"
 #include "execution/expressions/constant_value_expression.h"
@@ -68,8 +69,10 @@ class ExecutorTest : public ::testing::Test {
 
   /** Called after every executor test. */
   void TearDown() override {
-    // Commit our transaction
-    txn_mgr_->Commit(txn_);
+    // Commit our transaction, unless the test has committed it to publish the generated tables
+    if (txn_->GetState() != TransactionState::COMMITTED) {
+      txn_mgr_->Commit(txn_);
+    }
 
     // Shut down the disk manager and clean up the transaction
     disk_manager_->ShutDown();
@@ -173,6 +176,19 @@ class ExecutorTest : public ::testing::Test {
     return std::make_unique<ComparisonExpression>(lhs, rhs, comp_type);
   }
 
+  /**
+   * Make an arithmetic expression.
+   * @param lhs The abstract expression for the left-hand side of the operation
+   * @param rhs The abstract expression for the right-hand side of the operation
+   * @param arith_type The type of the arithmetic operation
+   * @return A non-owning pointer to the ArithmeticExpression
+   */
+  const AbstractExpression *MakeArithmeticExpression(const AbstractExpression *lhs, const AbstractExpression *rhs,
+                                                     ArithmeticType arith_type) {
+    allocated_exprs_.emplace_back(std::make_unique<ArithmeticExpression>(lhs, rhs, arith_type));
+    return allocated_exprs_.back().get();
+  }
+
   /**
    * Make an aggregate value expression.
    * @param is_group_by_term `true` if the expression is a group-by term, `false` otherwise
@@ -10,7 +10,14 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "common/bustub_instance.h"
@@ -29,21 +36,28 @@ namespace bustub {
 class RecoveryTest : public ::testing::Test {
  protected:
   // This function is called before every test.
-  void SetUp() override {
-    remove("test.db");
-    remove("test.log");
-  }
+  void SetUp() override { RemoveFiles(); }
 
   // This function is called after every test.
   void TearDown() override {
     LOG_INFO("Tearing down the system..");
-    remove("test.db");
-    remove("test.log");
+    RemoveFiles();
   };
+
+  static void RemoveFiles() {
+    remove("test.db");
+    remove("test.master");
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().rfind("test.log.", 0) == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+    std::filesystem::remove_all("test_archive");
+  }
 };
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -101,7 +115,8 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
   delete txn;
 
   LOG_INFO("Begin recovery");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -132,7 +147,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -163,6 +178,8 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
   LOG_INFO("Table page content is written to disk");
   bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
 
+  // The crash ends the transaction, no checkpoint may find it running anymore.
+  TransactionManager::txn_registry.Remove(txn);
   delete txn;
   delete test_table;
 
@@ -185,7 +202,8 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
   delete txn;
 
   LOG_INFO("Recovery started..");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -207,111 +225,705 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
   delete test_table;
   delete log_recovery;
 
+  LOG_INFO("System crash after recovery, before the undone page is written");
+  delete bustub_instance;
+  bustub_instance = new BustubInstance("test.db");
+
+  // The CLR is redone, and the transaction that already aborted is not undone again.
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                 bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  ASSERT_FALSE(test_table->GetTuple(rid, &old_tuple, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete log_recovery;
   delete bustub_instance;
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+TEST_F(RecoveryTest, ParallelRedoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
 
-  EXPECT_FALSE(enable_logging);
-  LOG_INFO("Skip system recovering...");
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const std::string padding(100, 'x');
+  auto make_tuple = [&](int32_t a) {
+    return Tuple({Value(TypeId::INTEGER, a), Value(TypeId::VARCHAR, padding)}, &schema);
+  };
+
+  // Many more pages than the buffer pool holds, so some reach the disk and some do not.
+  const int tuple_count = 1000;
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(tuple_count);
+  for (int i = 0; i < tuple_count; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i), &rids[i], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < tuple_count; i++) {
+    if (i % 5 == 0) {
+      ASSERT_TRUE(test_table->MarkDelete(rids[i], txn));
+    } else if (i % 3 == 0) {
+      ASSERT_TRUE(test_table->UpdateTuple(make_tuple(i + tuple_count), rids[i], txn));
+    }
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_, 4);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < tuple_count; i++) {
+    Tuple tuple;
+    if (i % 5 == 0) {
+      EXPECT_FALSE(test_table->GetTuple(rids[i], &tuple, txn));
+      continue;
+    }
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn));
+    EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), i % 3 == 0 ? i + tuple_count : i);
+  }
+  int count = 0;
+  for (auto iter = test_table->Begin(txn); iter != test_table->End(); ++iter) {
+    count++;
+  }
+  EXPECT_EQ(count, tuple_count - tuple_count / 5);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
 
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
   bustub_instance->log_manager_->RunFlushThread();
-  EXPECT_TRUE(enable_logging);
-  LOG_INFO("System logging thread running...");
+  ASSERT_TRUE(enable_logging);
 
   LOG_INFO("Create a test table");
   Transaction *txn = bustub_instance->transaction_manager_->Begin();
   auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
                                    bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
   bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
 
   Column col1{"a", TypeId::VARCHAR, 20};
   Column col2{"b", TypeId::SMALLINT};
   std::vector<Column> cols{col1, col2};
   Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
 
-  Tuple tuple = ConstructTuple(&schema);
-  auto val_0 = tuple.GetValue(&schema, 0);
-  auto val_1 = tuple.GetValue(&schema, 1);
-
-  // set log time out very high so that flush doesn't happen before checkpoint is performed
-  log_timeout = std::chrono::seconds(15);
-
-  // insert a ton of tuples
+  // Committed and written to disk before the checkpoint.
   Transaction *txn1 = bustub_instance->transaction_manager_->Begin();
-  for (int i = 0; i < 1000; i++) {
+  for (int i = 0; i < 100; i++) {
     RID rid;
-    EXPECT_TRUE(test_table->InsertTuple(tuple, &rid, txn1));
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn1));
   }
   bustub_instance->transaction_manager_->Commit(txn1);
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
 
-  // Do checkpoint
+  // Running across the checkpoint, never committed.
+  Transaction *txn2 = bustub_instance->transaction_manager_->Begin();
+  std::vector<RID> loser_rids(100);
+  for (int i = 0; i < 50; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &loser_rids[i], txn2));
+  }
   bustub_instance->checkpoint_manager_->BeginCheckpoint();
   bustub_instance->checkpoint_manager_->EndCheckpoint();
+  for (int i = 50; i < 100; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &loser_rids[i], txn2));
+  }
 
-  // Hacky
-  Page *pages = dynamic_cast<BufferPoolManagerInstance *>(bustub_instance->buffer_pool_manager_)->GetPages();
-  size_t pool_size = bustub_instance->buffer_pool_manager_->GetPoolSize();
+  // Committed after the checkpoint, only its log records reach the disk.
+  Transaction *txn3 = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < 100; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn3));
+  }
+  bustub_instance->transaction_manager_->Commit(txn3);
 
-  // make sure that all pages in the buffer pool are marked as non-dirty
-  bool all_pages_clean = true;
-  for (size_t i = 0; i < pool_size; i++) {
-    Page *page = &pages[i];
-    page_id_t page_id = page->GetPageId();
+  TransactionManager::txn_registry.Remove(txn2);
+  delete txn1;
+  delete txn2;
+  delete txn3;
+  delete test_table;
+  LOG_INFO("System crash");
+  delete bustub_instance;
 
-    if (page_id != INVALID_PAGE_ID && page->IsDirty()) {
-      all_pages_clean = false;
-      break;
-    }
+  // Recovery starts from the checkpoint, so it does not even read the start of the log.
+  {
+    std::fstream log_file("test.log.0", std::ios::binary | std::ios::in | std::ios::out);
+    std::vector<char> garbage(32, '\xff');
+    log_file.write(garbage.data(), garbage.size());
   }
-  EXPECT_TRUE(all_pages_clean);
-
-  // compare each page in the buffer pool to that page's
-  // data on disk. ensure they match after the checkpoint
-  bool all_pages_match = true;
-  auto *disk_data = new char[PAGE_SIZE];
-  for (size_t i = 0; i < pool_size; i++) {
-    Page *page = &pages[i];
-    page_id_t page_id = page->GetPageId();
-
-    if (page_id != INVALID_PAGE_ID) {
-      bustub_instance->disk_manager_->ReadPage(page_id, disk_data);
-      if (std::memcmp(disk_data, page->GetData(), PAGE_SIZE) != 0) {
-        all_pages_match = false;
-        break;
+
+  LOG_INFO("System restart...");
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  // The ABORT record of the loser is durable, and the log goes on after it.
+  EXPECT_EQ(bustub_instance->log_manager_->GetPersistentLSN(), bustub_instance->log_manager_->GetNextLSN() - 1);
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  int count = 0;
+  for (auto iter = test_table->Begin(txn); iter != test_table->End(); ++iter) {
+    EXPECT_EQ(iter->GetValue(&schema, 0).CompareEquals(tuple.GetValue(&schema, 0)), CmpBool::CmpTrue);
+    count++;
+  }
+  EXPECT_EQ(count, 200);
+  for (const auto &rid : loser_rids) {
+    Tuple loser_tuple;
+    EXPECT_FALSE(test_table->GetTuple(rid, &loser_tuple, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CommitAcrossCheckpointTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
+  auto *log_manager = bustub_instance->log_manager_;
+
+  Column col1{"a", TypeId::INTEGER};
+  std::vector<Column> cols{col1};
+  Schema schema{cols};
+  auto make_tuple = [&](int32_t a) { return Tuple({Value(TypeId::INTEGER, a)}, &schema); };
+
+  Transaction *txn0 = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   log_manager, txn0);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(3);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i), &rids[i], txn0));
+  }
+  bustub_instance->transaction_manager_->Commit(txn0);
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+
+  // txn1 logs its COMMIT before the checkpoint and applies its delete after it, as a commit racing a
+  // checkpoint does.
+  Transaction *txn1 = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->MarkDelete(rids[0], txn1));
+  ASSERT_TRUE(test_table->UpdateTuple(make_tuple(10), rids[1], txn1));
+  LogRecord commit_record(txn1->GetTransactionId(), txn1->GetPrevLSN(), LogRecordType::COMMIT);
+  txn1->SetPrevLSN(log_manager->AppendLogRecord(&commit_record));
+  TransactionManager::txn_registry.Remove(txn1);
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  std::vector<const TableWriteRecord *> writes;
+  for (auto write = txn1->GetWriteSet()->rbegin(); write != txn1->GetWriteSet()->rend(); ++write) {
+    writes.push_back(&*write);
+  }
+  test_table->FinishWrites(writes, true, txn1);
+  log_manager->Flush(txn1->GetPrevLSN());
+
+  delete txn0;
+  delete txn1;
+  delete test_table;
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  LOG_INFO("System restart...");
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  // The APPLYDELETE record shows that txn1 committed, it is not rolled back.
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  std::vector<int32_t> values;
+  for (auto iter = test_table->Begin(txn); iter != test_table->End(); ++iter) {
+    values.push_back(iter->GetValue(&schema, 0).GetAs<int32_t>());
+  }
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(std::vector<int32_t>({2, 10}), values);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, FlushOnStopTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  // A timeout far longer than the test, so that only the stop writes the log out.
+  log_timeout = std::chrono::seconds(15);
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *log_manager = bustub_instance->log_manager_;
+
+  LogRecord begin_record(0, INVALID_LSN, LogRecordType::BEGIN);
+  lsn_t lsn = log_manager->AppendLogRecord(&begin_record);
+  // A commit waiting for its record while the flush thread stops returns once the record is durable.
+  std::thread committer([&] {
+    log_manager->Flush(lsn);
+    EXPECT_GE(log_manager->GetPersistentLSN(), lsn);
+  });
+  log_manager->StopFlushThread();
+  committer.join();
+  EXPECT_GE(log_manager->GetPersistentLSN(), lsn);
+  log_timeout = std::chrono::seconds(1);
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, UnloggedPageFlushTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *bpm = bustub_instance->buffer_pool_manager_;
+  auto *log_manager = bustub_instance->log_manager_;
+
+  // An index page keeps other data where a table page keeps its LSN, writing it out waits for no log record.
+  page_id_t page_id;
+  Page *page = bpm->NewPage(&page_id);
+  ASSERT_NE(page, nullptr);
+  const lsn_t not_an_lsn = 1000000;
+  memcpy(page->GetData() + sizeof(page_id_t), &not_an_lsn, sizeof(lsn_t));
+  bpm->UnpinPage(page_id, true);
+  lsn_t persistent_lsn = log_manager->GetPersistentLSN();
+  ASSERT_TRUE(bpm->FlushPage(page_id));
+  EXPECT_EQ(log_manager->GetPersistentLSN(), persistent_lsn);
+
+  // A logged change to a table page is durable before the page is written.
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bpm, bustub_instance->lock_manager_, log_manager, txn);
+  page_id_t table_page_id = test_table->GetFirstPageId();
+  lsn_t page_lsn = bpm->FetchPage(table_page_id)->GetLSN();
+  bpm->UnpinPage(table_page_id, false);
+  ASSERT_TRUE(bpm->FlushPage(table_page_id));
+  EXPECT_GE(log_manager->GetPersistentLSN(), page_lsn);
+  bustub_instance->transaction_manager_->Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, AppendWhileStoppingTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *log_manager = bustub_instance->log_manager_;
+
+  // Appenders fill the buffers while the flush thread stops, then write the log out on their own.
+  // Each write must wait for the last one of the flush thread, and none of the records may get lost.
+  std::atomic<lsn_t> last_lsn{INVALID_LSN};
+  std::vector<std::thread> appenders;
+  for (int i = 0; i < 4; i++) {
+    appenders.emplace_back([&, i] {
+      for (int j = 0; j < 5000; j++) {
+        LogRecord record(i, INVALID_LSN, LogRecordType::BEGIN);
+        lsn_t lsn = log_manager->AppendLogRecord(&record);
+        lsn_t last = last_lsn.load();
+        while (last < lsn && !last_lsn.compare_exchange_weak(last, lsn)) {
+        }
+        if (j % 100 == 0) {
+          log_manager->Flush(lsn);
+          EXPECT_GE(log_manager->GetPersistentLSN(), lsn);
+        }
       }
-    }
+    });
+  }
+  log_manager->StopFlushThread();
+  for (auto &appender : appenders) {
+    appender.join();
   }
+  log_manager->Flush(last_lsn);
+  EXPECT_EQ(log_manager->GetPersistentLSN(), last_lsn);
+  EXPECT_EQ(log_manager->GetNextLSN(), last_lsn + 1);
+  delete bustub_instance;
+}
 
-  EXPECT_TRUE(all_pages_match);
-  delete[] disk_data;
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LogSegmentTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->disk_manager_->SetLogArchiveDirectory("test_archive");
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
 
-  // Verify all committed transactions flushed to disk
-  lsn_t persistent_lsn = bustub_instance->log_manager_->GetPersistentLSN();
-  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
-  EXPECT_EQ(persistent_lsn, (next_lsn - 1));
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const std::string padding(100, 'x');
+  auto make_tuple = [&](int32_t a) {
+    return Tuple({Value(TypeId::INTEGER, a), Value(TypeId::VARCHAR, padding)}, &schema);
+  };
 
-  // verify log was flushed and each page's LSN <= persistent lsn
-  bool all_pages_lte = true;
-  for (size_t i = 0; i < pool_size; i++) {
-    Page *page = &pages[i];
-    page_id_t page_id = page->GetPageId();
+  // Enough inserts to fill a few log segments.
+  const int tuple_count = 3000;
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(tuple_count);
+  for (int i = 0; i < tuple_count; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i), &rids[i], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  int64_t log_size = bustub_instance->disk_manager_->GetLogSize();
+  ASSERT_GT(log_size, 2 * LOG_SEGMENT_SIZE);
 
-    if (page_id != INVALID_PAGE_ID && page->GetLSN() > persistent_lsn) {
-      all_pages_lte = false;
-      break;
-    }
+  // Nothing before the checkpoint is needed once every page is on disk, the old segments go to the archive.
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  int64_t last_segment = log_size / LOG_SEGMENT_SIZE;
+  EXPECT_EQ(bustub_instance->disk_manager_->GetLogStart(), last_segment * LOG_SEGMENT_SIZE);
+  for (int64_t segment = 0; segment < last_segment; segment++) {
+    std::string segment_name = "test.log." + std::to_string(segment);
+    EXPECT_FALSE(std::filesystem::exists(segment_name));
+    EXPECT_TRUE(std::filesystem::exists("test_archive/" + segment_name));
   }
 
-  EXPECT_TRUE(all_pages_lte);
+  // A loser updates tuples, a winner inserts more, then the system crashes.
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < tuple_count; i += 10) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(-i), rids[i], loser));
+  }
+  Transaction *winner = bustub_instance->transaction_manager_->Begin();
+  for (int i = tuple_count; i < tuple_count + 500; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i), &rid, winner));
+  }
+  bustub_instance->transaction_manager_->Commit(winner);
+  TransactionManager::txn_registry.Remove(loser);
+  delete loser;
+  delete winner;
+  delete test_table;
+  LOG_INFO("System crash");
+  delete bustub_instance;
 
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  int count = 0;
+  for (auto iter = test_table->Begin(txn); iter != test_table->End(); ++iter) {
+    EXPECT_EQ(iter->GetValue(&schema, 0).GetAs<int32_t>(), count);
+    count++;
+  }
+  EXPECT_EQ(count, tuple_count + 500);
+  bustub_instance->transaction_manager_->Commit(txn);
   delete txn;
-  delete txn1;
   delete test_table;
+  delete bustub_instance;
+}
 
-  LOG_INFO("Shutdown System");
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, GroupCommitTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  // A timeout far longer than the test, so that only commits make the log reach the disk.
+  log_timeout = std::chrono::seconds(15);
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
+
+  const int num_threads = 8;
+  const int commits_per_thread = 50;
+  std::atomic<int> durable_commits{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < commits_per_thread; j++) {
+        Transaction *txn = bustub_instance->transaction_manager_->Begin();
+        bustub_instance->transaction_manager_->Commit(txn);
+        // The commit record is durable once Commit returns.
+        if (txn->GetPrevLSN() != INVALID_LSN &&
+            txn->GetPrevLSN() <= bustub_instance->log_manager_->GetPersistentLSN()) {
+          durable_commits++;
+        }
+        delete txn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(durable_commits, num_threads * commits_per_thread);
+  // A BEGIN and a COMMIT record per transaction.
+  EXPECT_EQ(bustub_instance->log_manager_->GetNextLSN(), 2 * num_threads * commits_per_thread);
+  EXPECT_EQ(bustub_instance->log_manager_->GetPersistentLSN(), 2 * num_threads * commits_per_thread - 1);
+
+  bustub_instance->log_manager_->StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+  // Concurrent commits share log writes.
+  EXPECT_LE(bustub_instance->disk_manager_->GetNumFlushes(), num_threads * commits_per_thread);
+  log_timeout = std::chrono::seconds(1);
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ActiveTransactionTableTest) {
+  LockManager lock_manager;
+  TransactionManager txn_manager(&lock_manager);
+  auto is_active = [&](Transaction *txn) {
+    std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+    txn_manager.GetActiveTransactions(&active_txns);
+    return std::any_of(active_txns.begin(), active_txns.end(),
+                       [txn](const auto &entry) { return entry.first == txn->GetTransactionId(); });
+  };
+
+  // A transaction stays in the table after it is marked committed or aborted, until it logs its end.
+  for (auto state : {TransactionState::COMMITTED, TransactionState::ABORTED}) {
+    Transaction *txn = txn_manager.Begin();
+    EXPECT_TRUE(is_active(txn));
+    txn->SetState(state);
+    EXPECT_TRUE(is_active(txn));
+    if (state == TransactionState::COMMITTED) {
+      txn_manager.Commit(txn);
+    } else {
+      txn_manager.Abort(txn);
+    }
+    EXPECT_FALSE(is_active(txn));
+    delete txn;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, TableLockTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
+  auto *lock_manager = bustub_instance->lock_manager_;
+  auto *txn_manager = bustub_instance->transaction_manager_;
+
+  Column col1{"a", TypeId::INTEGER};
+  std::vector<Column> cols{col1};
+  Schema schema{cols};
+  auto make_tuple = [&](int32_t a) { return Tuple({Value(TypeId::INTEGER, a)}, &schema); };
+
+  const table_oid_t oid = 0;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, lock_manager,
+                                   bustub_instance->log_manager_, txn, oid);
+  std::vector<RID> rids(4);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i), &rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // An EXCLUSIVE table lock covers the rows: writing them takes no row lock, and both commit and abort
+  // finish the writes without one.
+  for (bool commit : {false, true}) {
+    txn = txn_manager->Begin();
+    ASSERT_TRUE(lock_manager->LockTable(txn, oid, TableLockMode::EXCLUSIVE));
+    ASSERT_TRUE(test_table->MarkDelete(rids[0], txn));
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(10), rids[1], txn));
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(4), &rid, txn));
+    EXPECT_TRUE(txn->GetSharedLockSet()->empty());
+    EXPECT_TRUE(txn->GetExclusiveLockSet()->empty());
+    if (commit) {
+      txn_manager->Commit(txn);
+    } else {
+      txn_manager->Abort(txn);
+    }
+    delete txn;
+  }
+
+  // Only the committed writes are left: 10, 2, 3 and 4.
+  txn = txn_manager->Begin();
+  std::vector<int32_t> values;
+  for (auto iter = test_table->Begin(txn); iter != test_table->End(); ++iter) {
+    values.push_back(iter->GetValue(&schema, 0).GetAs<int32_t>());
+  }
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(std::vector<int32_t>({2, 3, 4, 10}), values);
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
   delete bustub_instance;
 }
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ConcurrentAppendTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+
+  // Far more records than a log buffer holds, appended from many threads at once.
+  const int num_threads = 8;
+  const int records_per_thread = 5000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([log_manager, i] {
+      for (int j = 0; j < records_per_thread; j++) {
+        if (j % 2 == 0) {
+          LogRecord log_record(i, INVALID_LSN, LogRecordType::BEGIN);
+          log_manager->AppendLogRecord(&log_record);
+        } else {
+          LogRecord log_record(i, INVALID_LSN, LogRecordType::NEWPAGE, j - 1, j);
+          log_manager->AppendLogRecord(&log_record);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  log_manager->StopFlushThread();
+  EXPECT_EQ(log_manager->GetPersistentLSN(), num_threads * records_per_thread - 1);
+  delete log_manager;
+  delete disk_manager;
+
+  // Every record reached the log whole, in LSN order, across segments.
+  disk_manager = new DiskManager("test.db");
+  EXPECT_GT(disk_manager->GetLogSize(), LOG_SEGMENT_SIZE);
+  std::vector<char> log(disk_manager->GetLogSize());
+  ASSERT_TRUE(disk_manager->ReadLog(log.data(), log.size(), 0));
+  delete disk_manager;
+  LogRecovery log_recovery(nullptr, nullptr, nullptr);
+  size_t offset = 0;
+  lsn_t expected_lsn = 0;
+  while (offset < log.size()) {
+    LogRecord log_record;
+    ASSERT_TRUE(log_recovery.DeserializeLogRecord(log.data() + offset, &log_record));
+    ASSERT_EQ(log_record.GetLSN(), expected_lsn);
+    offset += log_record.GetSize();
+    expected_lsn++;
+  }
+  EXPECT_EQ(offset, log.size());
+  EXPECT_EQ(expected_lsn, num_threads * records_per_thread);
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LogRecordFormatTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 200};
+  Column col3{"c", TypeId::INTEGER};
+  std::vector<Column> cols{col1, col2, col3};
+  Schema schema{cols};
+  const std::string padding(200, 'x');
+  Tuple old_tuple({Value(TypeId::INTEGER, 1), Value(TypeId::VARCHAR, padding), Value(TypeId::INTEGER, 2)}, &schema);
+  Tuple new_tuple({Value(TypeId::INTEGER, 1), Value(TypeId::VARCHAR, padding), Value(TypeId::INTEGER, 3)}, &schema);
+  Tuple longer_tuple({Value(TypeId::INTEGER, 1), Value(TypeId::VARCHAR, padding + "yy"), Value(TypeId::INTEGER, 2)},
+                     &schema);
+  RID rid(5, 7);
+
+  // Every kind of record goes through the log and is read back.
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  std::vector<LogRecord> log_records;
+  log_records.emplace_back(3, INVALID_LSN, LogRecordType::BEGIN);
+  log_records.emplace_back(3, 0, LogRecordType::INSERT, rid, old_tuple);
+  log_records.emplace_back(3, 1, LogRecordType::NEWPAGE, INVALID_PAGE_ID, 0);
+  log_records.emplace_back(2, std::vector<std::pair<txn_id_t, lsn_t>>{{3, 1}},
+                           std::vector<std::pair<page_id_t, lsn_t>>{{5, 0}});
+  log_records.emplace_back(1, LogRecord(3, 2, LogRecordType::APPLYDELETE, rid, old_tuple));
+  log_records.emplace_back(3, 4, LogRecordType::UPDATE, rid, old_tuple, new_tuple);
+  log_records.emplace_back(3, 5, LogRecordType::UPDATE, rid, old_tuple, longer_tuple);
+  for (auto &log_record : log_records) {
+    log_manager->AppendLogRecord(&log_record);
+  }
+  log_manager->StopFlushThread();
+  delete log_manager;
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  std::vector<char> log(disk_manager->GetLogSize());
+  ASSERT_TRUE(disk_manager->ReadLog(log.data(), log.size(), 0));
+  delete disk_manager;
+  LogRecovery log_recovery(nullptr, nullptr, nullptr);
+  std::vector<LogRecord> read_records(log_records.size());
+  size_t offset = 0;
+  for (size_t i = 0; i < log_records.size(); i++) {
+    ASSERT_TRUE(log_recovery.DeserializeLogRecord(log.data() + offset, &read_records[i]));
+    EXPECT_EQ(read_records[i].GetSize(), log_records[i].GetSize());
+    EXPECT_EQ(read_records[i].GetLSN(), static_cast<lsn_t>(i));
+    EXPECT_EQ(read_records[i].GetTxnId(), log_records[i].GetTxnId());
+    EXPECT_EQ(read_records[i].GetPrevLSN(), log_records[i].GetPrevLSN());
+    EXPECT_EQ(read_records[i].GetLogRecordType(), log_records[i].GetLogRecordType());
+    offset += read_records[i].GetSize();
+  }
+  EXPECT_EQ(offset, log.size());
+
+  // The header of a record of a small transaction takes a few bytes.
+  EXPECT_LE(log_records[0].GetSize(), 8);
+  EXPECT_EQ(read_records[1].GetInsertRID(), rid);
+  EXPECT_EQ(read_records[1].GetInsertTuple().GetLength(), old_tuple.GetLength());
+  EXPECT_EQ(memcmp(read_records[1].GetInsertTuple().GetData(), old_tuple.GetData(), old_tuple.GetLength()), 0);
+  EXPECT_EQ(read_records[2].GetNewPageRecord(), INVALID_PAGE_ID);
+  EXPECT_EQ(read_records[2].GetNewPageId(), 0);
+  EXPECT_EQ(read_records[3].GetActiveTxns(), log_records[3].GetActiveTxns());
+  EXPECT_EQ(read_records[3].GetDirtyPages(), log_records[3].GetDirtyPages());
+  EXPECT_EQ(read_records[4].GetUndoLSN(), 1);
+  EXPECT_EQ(read_records[4].GetActionType(), LogRecordType::APPLYDELETE);
+  EXPECT_EQ(read_records[4].GetDeleteRID(), rid);
+
+  // An update of one column of a wide row logs the bytes of that column, not both rows.
+  LogRecord &update = read_records[5];
+  EXPECT_EQ(update.GetUpdateRID(), rid);
+  EXPECT_LT(update.GetSize(), 32);
+  Tuple redone;
+  Tuple undone;
+  ASSERT_TRUE(update.ApplyUpdate(old_tuple, false, &redone));
+  EXPECT_EQ(redone.GetValue(&schema, 2).GetAs<int32_t>(), 3);
+  EXPECT_EQ(memcmp(redone.GetData(), new_tuple.GetData(), new_tuple.GetLength()), 0);
+  ASSERT_TRUE(update.ApplyUpdate(new_tuple, true, &undone));
+  EXPECT_EQ(memcmp(undone.GetData(), old_tuple.GetData(), old_tuple.GetLength()), 0);
+  // The update does not apply to a tuple it did not start from.
+  EXPECT_FALSE(update.ApplyUpdate(new_tuple, false, &redone));
+
+  // An update changing the length of the row.
+  LogRecord &grow = read_records[6];
+  ASSERT_TRUE(grow.ApplyUpdate(old_tuple, false, &redone));
+  EXPECT_EQ(redone.GetValue(&schema, 1).ToString(), padding + "yy");
+  EXPECT_EQ(redone.GetValue(&schema, 2).GetAs<int32_t>(), 2);
+  ASSERT_TRUE(grow.ApplyUpdate(longer_tuple, true, &undone));
+  EXPECT_EQ(undone.GetLength(), old_tuple.GetLength());
+  EXPECT_EQ(memcmp(undone.GetData(), old_tuple.GetData(), old_tuple.GetLength()), 0);
+
+  // A record cut short does not deserialize.
+  offset -= grow.GetSize() + update.GetSize();
+  log[offset] = static_cast<char>(update.GetSize() - 1);
+  LogRecord cut;
+  EXPECT_FALSE(log_recovery.DeserializeLogRecord(log.data() + offset, &cut));
+}
 }  // namespace bustub
@@ -11,6 +11,8 @@
 //===----------------------------------------------------------------------===//
 
 #include <cstring>
+#include <filesystem>
+#include <string>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -21,16 +23,20 @@ namespace bustub {
 class DiskManagerTest : public ::testing::Test {
  protected:
   // This function is called before every test.
-  void SetUp() override {
-    remove("test.db");
-    remove("test.log");
-  }
+  void SetUp() override { RemoveFiles(); }
 
   // This function is called after every test.
-  void TearDown() override {
+  void TearDown() override { RemoveFiles(); };
+
+  static void RemoveFiles() {
     remove("test.db");
-    remove("test.log");
-  };
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().rfind("test.log.", 0) == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+    std::filesystem::remove_all("test_archive");
+  }
 };
 
 // NOLINTNEXTLINE
@@ -72,6 +78,53 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentTest) {
+  const int segment_size = 64;
+  char data[200];
+  char buf[200];
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = static_cast<char>(i);
+  }
+  auto dm = DiskManager("test.db", segment_size);
+  EXPECT_FALSE(std::filesystem::exists("test.log.0"));
+
+  // A write that fills a segment goes on in the next one, reads span segments.
+  dm.WriteLog(data, 100);
+  dm.WriteLog(data + 100, 100);
+  EXPECT_EQ(dm.GetLogSize(), 200);
+  EXPECT_EQ(std::filesystem::file_size("test.log.2"), segment_size);
+  EXPECT_EQ(std::filesystem::file_size("test.log.3"), 200 - 3 * segment_size);
+  ASSERT_TRUE(dm.ReadLog(buf, 150, 30));
+  EXPECT_EQ(std::memcmp(buf, data + 30, 150), 0);
+
+  // Only whole segments before the offset are released, into the archive.
+  dm.SetLogArchiveDirectory("test_archive");
+  dm.ReleaseLogBefore(2 * segment_size + 10);
+  EXPECT_EQ(dm.GetLogStart(), 2 * segment_size);
+  EXPECT_FALSE(std::filesystem::exists("test.log.1"));
+  EXPECT_TRUE(std::filesystem::exists("test_archive/test.log.0"));
+  EXPECT_TRUE(std::filesystem::exists("test_archive/test.log.1"));
+  EXPECT_FALSE(dm.ReadLog(buf, 10, 0));
+  ASSERT_TRUE(dm.ReadLog(buf, 50, 2 * segment_size));
+  EXPECT_EQ(std::memcmp(buf, data + 2 * segment_size, 50), 0);
+
+  // Truncation deletes the segments after the cut, and the log goes on from there.
+  dm.TruncateLog(2 * segment_size + 20);
+  EXPECT_FALSE(std::filesystem::exists("test.log.3"));
+  EXPECT_EQ(dm.GetLogSize(), 2 * segment_size + 20);
+  dm.WriteLog(data, 100);
+  dm.ShutDown();
+
+  // A new disk manager finds the segments on disk.
+  auto dm2 = DiskManager("test.db", segment_size);
+  EXPECT_EQ(dm2.GetLogStart(), 2 * segment_size);
+  EXPECT_EQ(dm2.GetLogSize(), 2 * segment_size + 120);
+  ASSERT_TRUE(dm2.ReadLog(buf, 100, 2 * segment_size + 20));
+  EXPECT_EQ(std::memcmp(buf, data, 100), 0);
+  dm2.ShutDown();
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 